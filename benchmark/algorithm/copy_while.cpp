@@ -0,0 +1,62 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/algorithm/copy_while.hpp>
+#include "../harness.hpp"
+
+#include <boost/algorithm/cxx11/copy_if.hpp>
+
+#include <cstddef>
+#include <vector>
+
+
+// Compares `amz::copy_while` with `boost::algorithm::copy_while`. Keys are
+// sorted, so the selectivity is the length of the copied prefix relative to
+// the length of the container.
+int main(int argc, char** argv) {
+  bench::runner runner{argc, argv};
+
+  bench::for_each_container([&](auto tag, char const* container, std::size_t size) {
+    using Container = typename decltype(tag)::type;
+    using Element = typename Container::value_type;
+    std::size_t const n = bench::element_count(size);
+    Container const input = bench::make_input<Container>(n, 1, true);
+    std::vector<Element> output(n);
+
+    for (unsigned selectivity : bench::selectivities) {
+      auto pred = [=](Element const& e) { return e.key < selectivity; };
+
+      auto benchmark = [&](char const* impl, auto const& algorithm) {
+        runner.measure(bench::case_name("copy_while", impl, container, size, selectivity), n,
+          [] { },
+          [&] {
+            auto r = algorithm(input.begin(), input.end(), output.begin(), pred);
+            bench::do_not_optimize(r.second);
+          },
+          [&] {
+            return bench::count_operations(input.begin(), input.end(),
+              [&](auto first, auto last, bench::op_counts& counts) {
+                algorithm(first, last, output.begin(), bench::counted(pred, counts));
+              });
+          });
+      };
+
+      benchmark("amz", [](auto first, auto last, auto out, auto const& p) {
+        return amz::copy_while(first, last, out, p);
+      });
+      benchmark("boost", [](auto first, auto last, auto out, auto const& p) {
+        return boost::algorithm::copy_while(first, last, out, p);
+      });
+    }
+  });
+}
@@ -0,0 +1,65 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/algorithm/remove_and_copy_if.hpp>
+#include "../harness.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+
+// Compares `amz::remove_and_copy_if` with the two-pass equivalent made of
+// `std::remove_copy_if` (with the negated predicate) followed by
+// `std::remove_if`. Keys are random, so the selectivity is the probability
+// that any given element is removed.
+int main(int argc, char** argv) {
+  bench::runner runner{argc, argv};
+
+  bench::for_each_container([&](auto tag, char const* container, std::size_t size) {
+    using Container = typename decltype(tag)::type;
+    using Element = typename Container::value_type;
+    std::size_t const n = bench::element_count(size);
+    Container const input = bench::make_input<Container>(n);
+    Container c = input;
+    std::vector<Element> output(n);
+
+    for (unsigned selectivity : bench::selectivities) {
+      auto pred = [=](Element const& e) { return e.key < selectivity; };
+
+      auto benchmark = [&](char const* impl, auto const& algorithm) {
+        runner.measure(bench::case_name("remove_and_copy_if", impl, container, size, selectivity), n,
+          [&] { c = input; },
+          [&] {
+            auto r = algorithm(c.begin(), c.end(), output.begin(), pred);
+            bench::do_not_optimize(r.first);
+            bench::do_not_optimize(r.second);
+          },
+          [&] {
+            return bench::count_operations(c.begin(), c.end(),
+              [&](auto first, auto last, bench::op_counts& counts) {
+                algorithm(first, last, output.begin(), bench::counted(pred, counts));
+              });
+          });
+      };
+
+      benchmark("amz", [](auto first, auto last, auto out, auto const& p) {
+        return amz::remove_and_copy_if(first, last, out, p);
+      });
+      benchmark("std", [](auto first, auto last, auto out, auto const& p) {
+        auto const out_last = std::remove_copy_if(first, last, out, [&](auto const& e) { return !p(e); });
+        return std::make_pair(std::remove_if(first, last, p), out_last);
+      });
+    }
+  });
+}
@@ -0,0 +1,71 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/algorithm/remove_range_if.hpp>
+#include "../harness.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+
+// Compares `amz::remove_range_if` with `std::remove_if`. Consecutive elements
+// are grouped by key, and whole groups are removed based on their key. Since
+// all the elements of a group share the same key, `std::remove_if` on the key
+// yields the same result without knowing about groups, which makes it a lower
+// bound for the cost of removing groups. The selectivity is the probability
+// that any given group is removed.
+//
+// The predicate counts reported for `amz` are the calls to the equivalence
+// relation and to the range predicate.
+static constexpr std::size_t group_size = 8;
+
+int main(int argc, char** argv) {
+  bench::runner runner{argc, argv};
+
+  bench::for_each_container([&](auto tag, char const* container, std::size_t size) {
+    using Container = typename decltype(tag)::type;
+    using Element = typename Container::value_type;
+    std::size_t const n = bench::element_count(size);
+    Container const input = bench::make_input<Container>(n, group_size);
+    Container c = input;
+
+    for (unsigned selectivity : bench::selectivities) {
+      auto equivalent = [](Element const& a, Element const& b) { return a.key == b.key; };
+      auto remove_group = [=](auto first, auto) { return first->key < selectivity; };
+      auto remove_element = [=](Element const& e) { return e.key < selectivity; };
+
+      auto benchmark = [&](char const* impl, auto const& algorithm) {
+        runner.measure(bench::case_name("remove_range_if", impl, container, size, selectivity), n,
+          [&] { c = input; },
+          [&] {
+            auto r = algorithm(c.begin(), c.end(), [](auto const& f) { return f; });
+            bench::do_not_optimize(r);
+          },
+          [&] {
+            return bench::count_operations(c.begin(), c.end(),
+              [&](auto first, auto last, bench::op_counts& counts) {
+                algorithm(first, last, [&](auto const& f) { return bench::counted(f, counts); });
+              });
+          });
+      };
+
+      // `wrap` is applied to every predicate, so they can be counted.
+      benchmark("amz", [&](auto first, auto last, auto const& wrap) {
+        return amz::remove_range_if(first, last, wrap(equivalent), wrap(remove_group));
+      });
+      benchmark("std", [&](auto first, auto last, auto const& wrap) {
+        return std::remove_if(first, last, wrap(remove_element));
+      });
+    }
+  });
+}
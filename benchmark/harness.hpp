@@ -0,0 +1,333 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_BENCHMARK_HARNESS_HPP
+#define AMZ_BENCHMARK_HARNESS_HPP
+
+#include <boost/iterator/iterator_adaptor.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <list>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+// Minimal harness shared by the benchmarks of this directory.
+//
+// Each benchmark executable runs a set of named cases, and prints one line per
+// case with the throughput of the best of a few repetitions, along with the
+// branch misses and cache misses per element as reported by the hardware
+// performance counters (when they are available, which requires Linux and a
+// permissive `perf_event_paranoid` setting).
+//
+// Command-line arguments are used as substring filters on the name of the
+// cases: only cases whose name contains at least one of the arguments are run.
+namespace bench {
+
+// Element of the benchmarked containers, with a total size of `Size` bytes.
+// Algorithms only ever look at the key, so larger elements only add to the
+// memory traffic.
+template <std::size_t Size>
+struct element {
+  static_assert(Size > sizeof(std::uint32_t), "");
+  std::uint32_t key;
+  std::array<char, Size - sizeof(std::uint32_t)> payload;
+};
+
+template <>
+struct element<sizeof(std::uint32_t)> {
+  std::uint32_t key;
+};
+
+template <typename T>
+struct type_tag { using type = T; };
+
+// Calls `f(type_tag<Container>{}, container_name, element_size)` for each
+// combination of the benchmarked containers and element sizes.
+template <typename F>
+void for_each_container(F const& f) {
+  auto for_size = [&](auto size) {
+    constexpr std::size_t Size = decltype(size)::value;
+    f(type_tag<std::vector<element<Size>>>{}, "vector", Size);
+    f(type_tag<std::deque<element<Size>>>{}, "deque", Size);
+    f(type_tag<std::list<element<Size>>>{}, "list", Size);
+  };
+  for_size(std::integral_constant<std::size_t, 4>{});
+  for_size(std::integral_constant<std::size_t, 16>{});
+  for_size(std::integral_constant<std::size_t, 64>{});
+  for_size(std::integral_constant<std::size_t, 256>{});
+  for_size(std::integral_constant<std::size_t, 1024>{});
+}
+
+// Percentages of elements satisfying the predicate used by the benchmarks.
+constexpr std::array<unsigned, 6> selectivities = {{0, 1, 10, 50, 90, 100}};
+
+// Number of elements to use for a given element size, so that every container
+// holds roughly the same number of bytes (more than typical caches hold).
+inline std::size_t element_count(std::size_t element_size) {
+  return std::max<std::size_t>((std::size_t{16} << 20) / element_size, 1024);
+}
+
+// Fills a container with `n` elements whose keys are uniformly distributed in
+// `[0, 100)`, in groups of `group_size` consecutive elements sharing the same
+// key. When `sorted` is true, keys are increasing instead, so that the prefix
+// of elements whose key is below `k` has a length of `k%` of the container.
+template <typename Container>
+Container make_input(std::size_t n, std::size_t group_size = 1, bool sorted = false) {
+  std::mt19937 gen{12345};
+  std::uniform_int_distribution<std::uint32_t> dist{0, 99};
+  Container c;
+  typename Container::value_type e;
+  std::memset(&e, 0, sizeof e);
+  for (std::size_t i = 0; i != n; ++i) {
+    if (i % group_size == 0)
+      e.key = sorted ? static_cast<std::uint32_t>(i * 100 / n) : dist(gen);
+    c.push_back(e);
+  }
+  return c;
+}
+
+// Counts of the basic operations performed by an algorithm.
+struct op_counts {
+  std::size_t increments = 0;
+  std::size_t dereferences = 0;
+  std::size_t predicate_calls = 0;
+};
+
+// Iterator adaptor counting increments and dereferences. Used in an untimed
+// pass to report the number of operations performed by each algorithm.
+// Note that wrapping an iterator hides whether it is segmented, so the counts
+// are those of the generic code path.
+template <typename Iterator>
+class counting_iterator
+  : public boost::iterator_adaptor<counting_iterator<Iterator>, Iterator>
+{
+  using Base = boost::iterator_adaptor<counting_iterator<Iterator>, Iterator>;
+  friend class boost::iterator_core_access;
+
+public:
+  counting_iterator() = default;
+  counting_iterator(Iterator it, op_counts& counts) : Base{it}, counts_{&counts} { }
+
+private:
+  typename Base::reference dereference() const {
+    ++counts_->dereferences;
+    return *this->base_reference();
+  }
+
+  void increment() {
+    ++counts_->increments;
+    ++this->base_reference();
+  }
+
+  op_counts* counts_ = nullptr;
+};
+
+// Returns a function object calling `f` and counting the calls in `counts`.
+template <typename F>
+auto counted(F const& f, op_counts& counts) {
+  return [&f, &counts](auto const&... args) {
+    ++counts.predicate_calls;
+    return f(args...);
+  };
+}
+
+// Runs `algorithm(first, last, counts)` over counting iterators and returns
+// the number of operations it performed. The algorithm is expected to wrap
+// its predicates with `counted`.
+template <typename Iterator, typename Algorithm>
+op_counts count_operations(Iterator first, Iterator last, Algorithm const& algorithm) {
+  op_counts counts;
+  algorithm(counting_iterator<Iterator>{first, counts},
+            counting_iterator<Iterator>{last, counts}, counts);
+  return counts;
+}
+
+// Measures the number of hardware branch misses and cache misses in a region
+// of code. When the counters can't be opened, `stop` returns values that are
+// not `available`.
+class perf_counters {
+public:
+  struct values {
+    bool available = false;
+    std::uint64_t branch_misses = 0;
+    std::uint64_t cache_misses = 0;
+  };
+
+  perf_counters() {
+#if defined(__linux__)
+    leader_ = open(PERF_COUNT_HW_BRANCH_MISSES, -1);
+    if (leader_ != -1)
+      member_ = open(PERF_COUNT_HW_CACHE_MISSES, leader_);
+#endif
+  }
+
+  perf_counters(perf_counters const&) = delete;
+  perf_counters& operator=(perf_counters const&) = delete;
+
+  ~perf_counters() {
+#if defined(__linux__)
+    if (member_ != -1) ::close(member_);
+    if (leader_ != -1) ::close(leader_);
+#endif
+  }
+
+  void start() {
+#if defined(__linux__)
+    if (leader_ != -1) {
+      ::ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ::ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+  }
+
+  values stop() {
+    values result;
+#if defined(__linux__)
+    if (leader_ != -1) {
+      ::ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+      // With PERF_FORMAT_GROUP, the layout is { nr, values[nr] }.
+      std::uint64_t buffer[3] = {0, 0, 0};
+      if (::read(leader_, buffer, sizeof buffer) == sizeof buffer && buffer[0] == 2) {
+        result.available = true;
+        result.branch_misses = buffer[1];
+        result.cache_misses = buffer[2];
+      }
+    }
+#endif
+    return result;
+  }
+
+private:
+#if defined(__linux__)
+  static int open(std::uint64_t config, int group) {
+    ::perf_event_attr attr;
+    std::memset(&attr, 0, sizeof attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof attr;
+    attr.config = config;
+    attr.disabled = group == -1 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+  }
+
+  int leader_ = -1;
+  int member_ = -1;
+#endif
+};
+
+class runner {
+public:
+  runner(int argc, char** argv) : filters_(argv + 1, argv + argc) {
+    std::printf("%-48s %12s %10s %12s %12s %10s %10s\n",
+                "case", "Melem/s", "ns/elem", "br-miss/el", "cache-miss/el",
+                "deref/el", "pred/el");
+  }
+
+  bool enabled(std::string const& name) const {
+    return filters_.empty() || std::any_of(filters_.begin(), filters_.end(),
+      [&](std::string const& f) { return name.find(f) != std::string::npos; });
+  }
+
+  // Runs a benchmark case. `setup()` is called (untimed) before each
+  // repetition to restore the input, `run()` is the timed region, and
+  // `count()` is called once (untimed) and must return the operation counts
+  // of the algorithm for one run over `elements` elements.
+  template <typename Setup, typename Run, typename Count>
+  void measure(std::string const& name, std::size_t elements,
+               Setup const& setup, Run const& run, Count const& count)
+  {
+    if (!enabled(name))
+      return;
+
+    double best = std::numeric_limits<double>::infinity();
+    perf_counters::values best_counters;
+    for (int i = 0; i != repetitions; ++i) {
+      setup();
+      counters_.start();
+      auto const start = std::chrono::steady_clock::now();
+      run();
+      auto const stop = std::chrono::steady_clock::now();
+      auto const hw = counters_.stop();
+      double const ns = std::chrono::duration<double, std::nano>(stop - start).count();
+      if (ns < best) {
+        best = ns;
+        best_counters = hw;
+      }
+    }
+
+    setup();
+    op_counts const ops = count();
+
+    double const n = static_cast<double>(elements);
+    std::printf("%-48s %12.1f %10.3f %12s %12s %10.3f %10.3f\n",
+                name.c_str(), n / best * 1e3, best / n,
+                per_element(best_counters, best_counters.branch_misses, n).c_str(),
+                per_element(best_counters, best_counters.cache_misses, n).c_str(),
+                static_cast<double>(ops.dereferences) / n,
+                static_cast<double>(ops.predicate_calls) / n);
+    std::fflush(stdout);
+  }
+
+  static constexpr int repetitions = 5;
+
+private:
+  static std::string per_element(perf_counters::values const& v, std::uint64_t count, double n) {
+    if (!v.available)
+      return "n/a";
+    char buffer[32];
+    std::snprintf(buffer, sizeof buffer, "%.4f", static_cast<double>(count) / n);
+    return buffer;
+  }
+
+  std::vector<std::string> filters_;
+  perf_counters counters_;
+};
+
+// Returns a name of the form `algorithm/impl/container/sizeB/selectivity%`.
+inline std::string case_name(char const* algorithm, char const* impl,
+                             char const* container, std::size_t size,
+                             unsigned selectivity)
+{
+  return std::string{algorithm} + "/" + impl + "/" + container + "/" +
+         std::to_string(size) + "B/" + std::to_string(selectivity) + "%";
+}
+
+// Prevents the compiler from optimizing away the computation of `value`.
+template <typename T>
+void do_not_optimize(T const& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // end namespace bench
+
+#endif // include guard
@@ -0,0 +1,186 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_ALGORITHM_COMPACT_FILE_IF_HPP
+#define AMZ_ALGORITHM_COMPACT_FILE_IF_HPP
+
+#include <amz/detail/file.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace amz {
+
+// Result of a call to `compact_file_if`.
+struct file_compaction_result {
+  // The number of records that were kept in the compacted file.
+  std::size_t kept;
+
+  // The number of records that were removed from the file (and appended to
+  // the archive file, if any).
+  std::size_t removed;
+};
+
+// Given a file made of contiguous fixed-size records of type `Record`,
+// `compact_file_if` removes the records for which `pred` is satisfied from
+// the file, appends them to an archive file, and truncates the file to its
+// new size.
+//
+// This is the file-level equivalent of `remove_and_copy_if` followed by a
+// call to `erase`: surviving records are shifted towards the beginning of the
+// file (preserving their relative order) and removed records are appended to
+// the archive file in the order in which they appeared in the input file.
+// However, instead of operating on an in-memory range, the file is mapped in
+// memory and processed in windows of `window_size` bytes, which makes it
+// possible to compact files much larger than the available memory without
+// ever copying them to the heap:
+// - Each window is advised as being accessed sequentially (`MADV_SEQUENTIAL`)
+//   before it is processed.
+// - Removed records are streamed to the archive file through a buffer of at
+//   most one window.
+// - After each window, the pages of the compacted prefix of the file that will
+//   not be written to anymore are scheduled for write-back and released from
+//   the address space.
+//
+// If `archive_path` is a null pointer, the removed records are simply dropped.
+// Otherwise, the archive file is created if it does not exist, and removed
+// records are appended to it.
+//
+// This algorithm assumes:
+// (1) `Record` is TriviallyCopyable
+// (2) The size of the file at `path` is a multiple of `sizeof(Record)`
+// (3) The file is not concurrently modified by another process or thread
+// (4) `path` and `archive_path` do not refer to the same file
+//
+// Error handling:
+// System call failures are reported by throwing a `std::system_error`. If an
+// exception is thrown (either because of a system call failure or because
+// `pred` threw), the records in the file have valid but unspecified contents,
+// just like the elements of a range would after `remove_and_copy_if` exits
+// with an exception. The size of the file is left unchanged in that case.
+//
+// Performance guarantees:
+// Given a file of `n` records, this algorithm does exactly `n` applications of
+// the predicate, at most `n` copies of records within the file and it reads
+// each page of the file exactly once.
+template <typename Record, typename Predicate>
+file_compaction_result compact_file_if(char const* path, char const* archive_path,
+                                       Predicate const& pred,
+                                       std::size_t window_size = std::size_t{64} << 20)
+{
+  static_assert(std::is_trivially_copyable<Record>::value,
+    "compact_file_if can only be used with TriviallyCopyable records, since "
+    "records are copied to and from a file as raw bytes.");
+
+  detail::unique_fd file{::open(path, O_RDWR | O_CLOEXEC)};
+  if (!file)
+    detail::throw_errno("open");
+
+  detail::unique_fd archive{};
+  if (archive_path != nullptr) {
+    archive = detail::unique_fd{::open(archive_path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)};
+    if (!archive)
+      detail::throw_errno("open");
+  }
+
+  struct ::stat st;
+  if (::fstat(file.get(), &st) != 0)
+    detail::throw_errno("fstat");
+  std::size_t const file_size = static_cast<std::size_t>(st.st_size);
+  if (file_size % sizeof(Record) != 0) {
+    throw std::system_error{std::make_error_code(std::errc::invalid_argument),
+                            "compact_file_if: file size is not a multiple of the record size"};
+  }
+
+  std::size_t const page = detail::page_size();
+  std::size_t const window_records = std::max<std::size_t>(window_size / sizeof(Record), 1);
+  std::size_t const n_records = file_size / sizeof(Record);
+
+  detail::unique_mapping mapping{file.get(), file_size, PROT_READ | PROT_WRITE};
+  Record* const records = reinterpret_cast<Record*>(mapping.data());
+
+  std::unique_ptr<char[]> archive_buffer{};
+  std::size_t archive_buffered = 0;
+  std::size_t const archive_capacity = window_records * sizeof(Record);
+  if (archive)
+    archive_buffer.reset(new char[archive_capacity]);
+
+  std::size_t write = 0;   // index of the next slot for a surviving record
+  std::size_t released = 0; // bytes at the beginning of the file that were released
+  for (std::size_t window = 0; window < n_records; window += window_records) {
+    std::size_t const window_end = std::min(window + window_records, n_records);
+
+    // Advise the kernel that the window will be read sequentially. The start
+    // of the window is rounded down to a page boundary, as required by madvise.
+    std::size_t const advise_begin = (window * sizeof(Record)) / page * page;
+    ::madvise(mapping.data() + advise_begin,
+              window_end * sizeof(Record) - advise_begin, MADV_SEQUENTIAL);
+
+    for (std::size_t read = window; read != window_end; ++read) {
+      Record const& r = records[read];
+      if (pred(r)) {
+        if (archive) {
+          std::memcpy(archive_buffer.get() + archive_buffered, &r, sizeof(Record));
+          archive_buffered += sizeof(Record);
+        }
+      } else {
+        if (write != read)
+          std::memcpy(&records[write], &r, sizeof(Record));
+        ++write;
+      }
+    }
+
+    if (archive_buffered > 0) {
+      detail::write_all(archive.get(), archive_buffer.get(), archive_buffered);
+      archive_buffered = 0;
+    }
+
+    // Pages that lie entirely before the write position are final: flush them
+    // incrementally and drop them from our address space.
+    std::size_t const final_bytes = (write * sizeof(Record)) / page * page;
+    if (final_bytes > released) {
+      if (::msync(mapping.data() + released, final_bytes - released, MS_ASYNC) != 0)
+        detail::throw_errno("msync");
+      ::madvise(mapping.data() + released, final_bytes - released, MADV_DONTNEED);
+      released = final_bytes;
+    }
+  }
+
+  std::size_t const new_size = write * sizeof(Record);
+  if (new_size > released) {
+    if (::msync(mapping.data() + released, new_size - released, MS_SYNC) != 0)
+      detail::throw_errno("msync");
+  }
+  mapping = detail::unique_mapping{};
+
+  if (::ftruncate(file.get(), static_cast<::off_t>(new_size)) != 0)
+    detail::throw_errno("ftruncate");
+
+  return file_compaction_result{write, n_records - write};
+}
+
+} // end namespace amz
+
+#endif // include guard
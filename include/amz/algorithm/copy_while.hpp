@@ -14,12 +14,42 @@
 #ifndef AMZ_ALGORITHM_COPY_WHILE_HPP
 #define AMZ_ALGORITHM_COPY_WHILE_HPP
 
+#include <amz/segmented_iterator.hpp>
+
 #include <iterator>
 #include <utility>
 
 
 namespace amz {
 
+namespace detail {
+  template <typename InputIterator, typename OutputIterator, typename Predicate>
+  std::pair<InputIterator, OutputIterator>
+  copy_while(InputIterator first, InputIterator last, OutputIterator result, Predicate const& pred, std::false_type) {
+    using value_type = typename std::iterator_traits<InputIterator>::value_type;
+    for (; first != last; ++first) {
+      // Cache *first to meet the requirements on the number of dereferences
+      value_type const& v = *first;
+      if (!pred(v)) break;
+      *result++ = v;
+    }
+    return std::make_pair(first, result);
+  }
+
+  template <typename InputIterator, typename OutputIterator, typename Predicate>
+  std::pair<InputIterator, OutputIterator>
+  copy_while(InputIterator first, InputIterator last, OutputIterator result, Predicate const& pred, std::true_type) {
+    InputIterator const stop = detail::for_each_segment(first, last, [&](auto local_first, auto local_last) {
+      using LocalIterator = decltype(local_first);
+      auto const r = detail::copy_while(local_first, local_last, result, pred,
+                                        detail::is_segmented_iterator_t<LocalIterator>{});
+      result = r.second;
+      return r.first;
+    });
+    return std::make_pair(stop, result);
+  }
+} // end namespace detail
+
 // Given a range of elements delimited by two InputIterators `[first, last)`,
 // `copy_while` copies the prefix of that range that satisfies the given
 // predicate into an OutputIterator. In other words, it copies elements of
@@ -47,18 +77,16 @@ namespace amz {
 // replaced by `boost::algorithm::copy_while` in recent Boost versions, because
 // these guarantees are not met (iterator dereferences are not cached).
 //
+// When `InputIterator` is a segmented iterator (see `segmented_iterator.hpp`),
+// like the iterators of `std::deque`, each segment is traversed with its local
+// iterator instead, and the guarantees above apply to local iterators.
+//
 // Author: Louis Dionne
 template <typename InputIterator, typename OutputIterator, typename Predicate>
 std::pair<InputIterator, OutputIterator>
 copy_while(InputIterator first, InputIterator last, OutputIterator result, Predicate const& pred) {
-  using value_type = typename std::iterator_traits<InputIterator>::value_type;
-  for (; first != last; ++first) {
-    // Cache *first to meet the requirements on the number of dereferences
-    value_type const& v = *first;
-    if (!pred(v)) break;
-    *result++ = v;
-  }
-  return std::make_pair(first, result);
+  return detail::copy_while(first, last, result, pred,
+                            detail::is_segmented_iterator_t<InputIterator>{});
 }
 
 } // end namespace amz
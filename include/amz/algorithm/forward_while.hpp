@@ -0,0 +1,100 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_ALGORITHM_FORWARD_WHILE_HPP
+#define AMZ_ALGORITHM_FORWARD_WHILE_HPP
+
+#include <amz/bounded_channel.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+
+namespace amz {
+
+// Given an input channel, an output channel and a predicate `pred`,
+// `forward_while` moves elements from the input channel to the output channel
+// as long as they satisfy the predicate.
+//
+// This is the channel equivalent of `copy_while`: elements are transferred
+// in batches of up to `batch_size` elements, so the lock of each channel is
+// acquired once per batch instead of once per element.
+//
+// The algorithm returns a pair made of a status and a number of dropped
+// elements:
+// - `success` and 0 when it stops at an element that does not satisfy
+//   `pred`; that element is left at the front of the input channel.
+// - `closed` and 0 once the input channel has been closed and fully drained.
+//   If `close_downstream` is true, the output channel is closed too (closing
+//   is propagated downstream). This is opt-in, since it is only correct when
+//   this call is the only producer of the output channel: when several stages
+//   feed the same channel, the first stage to finish would otherwise make the
+//   others drop their batches.
+// - `closed` and the number of elements that were dropped as soon as it
+//   notices that the output channel was closed underneath it. The elements
+//   of the current batch that were not yet pushed are dropped, and the input
+//   channel is left untouched. The number of dropped elements is always
+//   positive in that case, so it can be told apart from the end of the input.
+//
+// Like for `copy_while`, this algorithm blocks until an element that does not
+// satisfy the predicate is found, or until the input channel is closed.
+//
+// This algorithm assumes:
+// (1) `pred(v)` is valid for any `T const& v`, and `pred` can be called while
+//     the lock of the input channel is held
+// (2) `batch_size` is greater than 0
+// (3) The input and output channels are different channels
+//
+// Performance guarantees:
+// Given a sequence of elements whose prefix satisfying the predicate has a
+// length of `n`, this algorithm does at most `n+1` applications of the
+// predicate, and elements are moved (never copied).
+template <typename T, typename InContainer, typename OutContainer, typename Predicate>
+std::pair<channel_op_status, std::size_t>
+forward_while(bounded_channel<T, InContainer>& in,
+              bounded_channel<T, OutContainer>& out,
+              Predicate const& pred,
+              std::size_t batch_size = 64,
+              bool close_downstream = false)
+{
+  assert(batch_size > 0);
+  std::vector<T> batch;
+  batch.reserve(batch_size);
+
+  while (true) {
+    batch.clear();
+    if (in.pop_some_while(std::back_inserter(batch), batch_size, pred).first == channel_op_status::closed) {
+      if (close_downstream)
+        out.close();
+      return std::make_pair(channel_op_status::closed, std::size_t{0});
+    }
+
+    // `pop_some_while` waits until at least one element is available, so
+    // popping nothing means that the front of the channel fails the predicate.
+    if (batch.empty())
+      return std::make_pair(channel_op_status::success, std::size_t{0});
+
+    auto const pushed = out.push_range(std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+    if (pushed.first == channel_op_status::closed) {
+      std::size_t const dropped = static_cast<std::size_t>(std::distance(pushed.second.base(), batch.end()));
+      return std::make_pair(channel_op_status::closed, dropped);
+    }
+  }
+}
+
+} // end namespace amz
+
+#endif // include guard
@@ -14,24 +14,59 @@
 #ifndef AMZ_ALGORITHM_REMOVE_AND_COPY_IF_HPP
 #define AMZ_ALGORITHM_REMOVE_AND_COPY_IF_HPP
 
+#include <amz/segmented_iterator.hpp>
+
 #include <algorithm>
 #include <iterator>
+#include <type_traits>
 #include <utility>
 
 
 namespace amz {
 
+namespace detail {
+  template <typename ForwardIt, typename OutputIt, typename Predicate>
+  void remove_and_copy_if(ForwardIt& compress, ForwardIt last, OutputIt& result, Predicate const& pred, std::false_type) {
+    using value_type = typename std::iterator_traits<ForwardIt>::value_type;
+    for (ForwardIt first = compress; first != last; ++first) {
+      value_type const& v = *first;
+      if (pred(v))
+        *result++ = std::move(*first);
+      else
+        *compress++ = std::move(*first);
+    }
+  }
+
+  // Reads the range one segment at a time. Writes to `compress` still go
+  // through the segmented iterator, since they lag behind the reads and may
+  // cross segment boundaries at different points.
+  template <typename ForwardIt, typename OutputIt, typename Predicate>
+  void remove_and_copy_if(ForwardIt& compress, ForwardIt last, OutputIt& result, Predicate const& pred, std::true_type) {
+    using value_type = typename std::iterator_traits<ForwardIt>::value_type;
+    detail::for_each_segment(compress, last, [&](auto local_first, auto local_last) {
+      for (; local_first != local_last; ++local_first) {
+        value_type const& v = *local_first;
+        if (pred(v))
+          *result++ = std::move(*local_first);
+        else
+          *compress++ = std::move(*local_first);
+      }
+      return local_last;
+    });
+  }
+} // end namespace detail
+
 // Given a range of elements delimited by two ForwardIterators `[first, last)`
-// and a predicate `pred`, `remove_and_copy_if` copies the elements for which
+// and a predicate `pred`, `remove_and_copy_if` moves the elements for which
 // `pred` is satisfied to the specified output range and removes them from the
 // input range.
 //
 // This is very similar to `std::remove_if`, except the elements that are
-// removed are also copied to a specified output range. This is also similar
+// removed are also moved to a specified output range. This is also similar
 // to `std::remove_copy_if`, except the input range is filtered in place.
 //
 // Like for `std::remove_if`, removing is done by shifting (by means of
-// assignment) the elements in the input range in such a way that the
+// move assignment) the elements in the input range in such a way that the
 // elements that are not removed all appear contiguously as the subrange
 // `[first, ret)`, where `ret` is the new end of the input range. Relative
 // order of the elements that remain is preserved. Iterators in the range
@@ -46,37 +81,36 @@ namespace amz {
 // This algorithm returns a pair containing:
 // (1) the iterator `ret` defined above, as would be returned by an equivalent
 //     call to `std::remove_if`
-// (2) an OutputIterator to one-past-the-last element that was copied in
+// (2) an OutputIterator to one-past-the-last element that was moved to
 //     the output range, as would be returned by an equivalent call to
 //     `std::remove_copy_if`
 //
 // This algorithm assumes:
 // (1) `[first, last)` is a valid range
 // (2) The input and output ranges do not overlap
-// (3) The input range's `reference` type is MoveAssignable
+// (3) The input range's `reference` type is MoveAssignable, and the output
+//     range accepts rvalues of the input range's `value_type`
 // (4) `pred(*it)` is valid for all `it` in the range `[first, last)`
 // (5) The output range has at least `std::count_if(first, last, pred)` elements
 //
 // Performance guarantees:
 // Given a range of length `n`, this algorithm does exactly `n` applications
-// of the predicate and at most `n` copies.
+// of the predicate and at most `n` moves. The predicate is always applied to
+// an element before it is moved, while the element is still at its original
+// position in the input range.
 //
-// TODO: Consider using move assignment to move elements around instead of
-//       copying them.
+// When `ForwardIt` is a segmented iterator (see `segmented_iterator.hpp`),
+// like the iterators of `std::deque`, the input range is read one segment at
+// a time using local iterators, so the inner loop does not pay for segment
+// boundary checks on every increment.
 //
 // Author: Louis Dionne
 template <typename ForwardIt, typename OutputIt, typename Predicate>
 std::pair<ForwardIt, OutputIt>
 remove_and_copy_if(ForwardIt first, ForwardIt last, OutputIt result, Predicate const& pred) {
-  using value_type = typename std::iterator_traits<ForwardIt>::value_type;
-  ForwardIt compress = std::find_if(first, last, pred);
-  for (first = compress; first != last; ++first) {
-    value_type const& v = *first;
-    if (pred(v))
-      *result++ = v;
-    else
-      *compress++ = v;
-  }
+  ForwardIt compress = detail::segmented_find_if(first, last, pred);
+  detail::remove_and_copy_if(compress, last, result, pred,
+                             detail::is_segmented_iterator_t<ForwardIt>{});
   return std::make_pair(compress, result);
 }
 
@@ -14,6 +14,8 @@
 #ifndef AMZ_ALGORITHM_REMOVE_RANGE_IF_HPP
 #define AMZ_ALGORITHM_REMOVE_RANGE_IF_HPP
 
+#include <amz/segmented_iterator.hpp>
+
 #include <algorithm>
 #include <iterator>
 
@@ -58,14 +60,19 @@ namespace amz {
 // * No more than `std::distance(first, last)-1` applications of `std::move`
 // * Exactly `N` applications of `pred` where `N` is the number of sub-ranges
 //
+// When `ForwardIterator` is a segmented iterator (see `segmented_iterator.hpp`),
+// like the iterators of `std::deque`, the boundaries of sub-ranges are found
+// by scanning one segment at a time.
+//
 // Author: John McFarlane
 template<typename ForwardIterator, typename EquivalenceRelation, typename RangePredicate>
 ForwardIterator remove_range_if(ForwardIterator first, ForwardIterator last, EquivalenceRelation equivalent, RangePredicate pred) {
     auto write_pos = first;
     while (first != last) {
         // Establish sub-range of equivalent elements, `[first, sub_last)`.
-        auto sub_last = std::find_if(std::next(first), last, [equivalent, first](auto const& element) {
-            return !equivalent(*first, element);
+        auto const& head = *first;
+        auto sub_last = detail::segmented_find_if(std::next(first), last, [&equivalent, &head](auto const& element) {
+            return !equivalent(head, element);
         });
 
         // If the sub-range is *not* to be removed,
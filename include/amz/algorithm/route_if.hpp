@@ -0,0 +1,109 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_ALGORITHM_ROUTE_IF_HPP
+#define AMZ_ALGORITHM_ROUTE_IF_HPP
+
+#include <amz/algorithm/remove_and_copy_if.hpp>
+#include <amz/bounded_channel.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+
+namespace amz {
+
+// Given an input channel, an output channel, a reject channel and a predicate
+// `pred`, `route_if` consumes every element of the input channel, pushing the
+// elements for which `pred` is satisfied to the reject channel, and the other
+// elements to the output channel.
+//
+// This is the channel equivalent of `remove_and_copy_if`: instead of having
+// a consumer pop elements one at a time and push them one at a time to the
+// right channel, `route_if` transfers elements in batches of up to
+// `batch_size` elements, so the lock of each channel is acquired once per
+// batch instead of once per element. Within a batch, elements are filtered
+// with `remove_and_copy_if`. The relative order of the elements sent to each
+// channel is preserved.
+//
+// The algorithm returns a pair made of a status and a number of dropped
+// elements:
+// - `closed` and 0 once the input channel has been closed and fully drained.
+//   If `close_downstream` is true, the output and reject channels are closed
+//   too (closing is propagated downstream). This is opt-in, since it is only
+//   correct when this call is the only producer of those channels: when
+//   several stages feed the same channels, the first stage to finish would
+//   otherwise make the others drop their batches.
+// - `closed` and the number of elements that were dropped as soon as it
+//   notices that the output or the reject channel was closed underneath it.
+//   The elements of the current batch that were not yet pushed are dropped,
+//   and the input channel is left untouched. The number of dropped elements
+//   is always positive in that case, so it can be told apart from the end of
+//   the input.
+//
+// This algorithm assumes:
+// (1) `T` is MoveAssignable
+// (2) `pred(v)` is valid for any `T const& v`
+// (3) `batch_size` is greater than 0
+// (4) The input channel is not also the output or reject channel
+//
+// Performance guarantees:
+// Given `n` elements going through the input channel, this algorithm does
+// exactly `n` applications of the predicate, and acquires the lock of each
+// channel `O(n / batch_size)` times when channels are never full or empty.
+template <typename T, typename InContainer, typename OutContainer, typename RejectContainer, typename Predicate>
+std::pair<channel_op_status, std::size_t>
+route_if(bounded_channel<T, InContainer>& in,
+         bounded_channel<T, OutContainer>& out,
+         bounded_channel<T, RejectContainer>& reject,
+         Predicate const& pred,
+         std::size_t batch_size = 64,
+         bool close_downstream = false)
+{
+  assert(batch_size > 0);
+  std::vector<T> batch;
+  std::vector<T> rejected;
+  batch.reserve(batch_size);
+  rejected.reserve(batch_size);
+
+  while (true) {
+    batch.clear();
+    rejected.clear();
+    if (in.pop_some(std::back_inserter(batch), batch_size).first == channel_op_status::closed) {
+      if (close_downstream) {
+        out.close();
+        reject.close();
+      }
+      return std::make_pair(channel_op_status::closed, std::size_t{0});
+    }
+
+    auto const kept = amz::remove_and_copy_if(batch.begin(), batch.end(), std::back_inserter(rejected), pred).first;
+    auto const kept_pushed = out.push_range(std::make_move_iterator(batch.begin()), std::make_move_iterator(kept));
+    if (kept_pushed.first == channel_op_status::closed) {
+      std::size_t const dropped = static_cast<std::size_t>(std::distance(kept_pushed.second.base(), kept));
+      return std::make_pair(channel_op_status::closed, dropped + rejected.size());
+    }
+    auto const rejected_pushed = reject.push_range(std::make_move_iterator(rejected.begin()), std::make_move_iterator(rejected.end()));
+    if (rejected_pushed.first == channel_op_status::closed) {
+      std::size_t const dropped = static_cast<std::size_t>(std::distance(rejected_pushed.second.base(), rejected.end()));
+      return std::make_pair(channel_op_status::closed, dropped);
+    }
+  }
+}
+
+} // end namespace amz
+
+#endif // include guard
@@ -0,0 +1,258 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_ARENA_HPP
+#define AMZ_ARENA_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace amz {
+
+//! Monotonic memory arena.
+//!
+//! An arena hands out memory by bumping a pointer into large chunks, and
+//! never frees individual allocations. Instead, all the memory allocated
+//! since a given point can be released at once with `reset()`, which costs
+//! O(chunks) regardless of the number of allocations. This is well suited to
+//! processing a request, where many short-lived objects are created and then
+//! all destroyed together.
+//!
+//! - Chunks of `chunk_size` bytes are chained together as needed. Chunks that
+//!   are released by `reset()` are kept around and reused by later
+//!   allocations, so a steady-state workload does not allocate chunks at all.
+//! - Allocations larger than a quarter of `chunk_size` get a dedicated chunk,
+//!   so that they do not waste the remainder of the current chunk. Dedicated
+//!   chunks are freed by `reset()`.
+//! - `mark()` returns a checkpoint, and `reset(checkpoint)` releases all the
+//!   memory allocated since that checkpoint was taken.
+//!
+//! An arena does not run destructors: objects allocated in an arena must be
+//! destroyed before the memory is released, or be trivially destructible.
+//! An arena is not thread-safe.
+class arena {
+  struct chunk {
+    chunk* next;
+    std::size_t size; // usable bytes following the header
+  };
+  static constexpr std::size_t header_size =
+    (sizeof(chunk) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+public:
+  //! A point in the history of allocations of an arena, to which the arena
+  //! can be reset.
+  class checkpoint {
+    friend class arena;
+    chunk* chunk_;
+    char* ptr_;
+    chunk* large_;
+    checkpoint(chunk* c, char* p, chunk* large) : chunk_{c}, ptr_{p}, large_{large} { }
+  };
+
+  static constexpr std::size_t default_chunk_size = 64 * 1024;
+
+  //! Creates an empty arena that allocates chunks of `chunk_size` bytes.
+  //! No memory is allocated until the first call to `allocate()`.
+  explicit arena(std::size_t chunk_size = default_chunk_size) noexcept
+    : chunk_size_{chunk_size}
+    , chunks_{nullptr}
+    , ptr_{nullptr}
+    , end_{nullptr}
+    , large_{nullptr}
+    , spare_{nullptr}
+  {
+    assert(chunk_size > 0);
+  }
+
+  arena(arena const&) = delete;
+  arena(arena&&) = delete;
+  arena& operator=(arena const&) = delete;
+  arena& operator=(arena&&) = delete;
+
+  //! Frees all the memory owned by the arena.
+  ~arena() {
+    free_chunks(chunks_, nullptr);
+    free_chunks(large_, nullptr);
+    free_chunks(spare_, nullptr);
+  }
+
+  //! Allocates `bytes` bytes aligned on `alignment`, which must be a power
+  //! of two.
+  void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) {
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0 && "alignment must be a power of two");
+    if (char* p = bump(bytes, alignment))
+      return p;
+    return allocate_slow(bytes, alignment);
+  }
+
+  //! Does nothing; memory is only released by `reset()`.
+  void deallocate(void*, std::size_t) noexcept { }
+
+  //! Returns a checkpoint representing the current state of the arena.
+  checkpoint mark() const noexcept {
+    return checkpoint{chunks_, ptr_, large_};
+  }
+
+  //! Releases all the memory allocated since `cp` was obtained from `mark()`.
+  //!
+  //! Checkpoints taken after `cp` are invalidated; `cp` itself and the ones
+  //! taken before it remain valid. Regular chunks are kept for reuse, and
+  //! dedicated chunks are freed.
+  void reset(checkpoint const& cp) noexcept {
+    while (chunks_ != cp.chunk_) {
+      assert(chunks_ != nullptr && "the checkpoint does not belong to this arena, or was invalidated");
+      chunk* c = chunks_;
+      chunks_ = c->next;
+      c->next = spare_;
+      spare_ = c;
+    }
+    free_chunks(large_, cp.large_);
+    large_ = cp.large_;
+    ptr_ = cp.ptr_;
+    end_ = chunks_ == nullptr ? nullptr : data(chunks_) + chunks_->size;
+  }
+
+  //! Releases all the memory allocated in the arena.
+  //!
+  //! Regular chunks are kept for reuse, and dedicated chunks are freed.
+  void reset() noexcept {
+    reset(checkpoint{nullptr, nullptr, nullptr});
+  }
+
+  //! Returns the size of the regular chunks allocated by the arena.
+  std::size_t chunk_size() const noexcept { return chunk_size_; }
+
+private:
+  std::size_t const chunk_size_;
+  chunk* chunks_; // chunks in use, most recent first
+  char* ptr_;     // next free byte in `chunks_`
+  char* end_;     // end of `chunks_`
+  chunk* large_;  // dedicated chunks, most recent first
+  chunk* spare_;  // regular chunks released by `reset()`
+
+  static char* data(chunk* c) noexcept {
+    return reinterpret_cast<char*>(c) + header_size;
+  }
+
+  static char* align_up(char* p, std::size_t alignment) noexcept {
+    auto const address = reinterpret_cast<std::uintptr_t>(p);
+    return p + ((alignment - address % alignment) % alignment);
+  }
+
+  char* bump(std::size_t bytes, std::size_t alignment) noexcept {
+    if (ptr_ == nullptr)
+      return nullptr;
+    char* p = align_up(ptr_, alignment);
+    if (p > end_ || static_cast<std::size_t>(end_ - p) < bytes)
+      return nullptr;
+    ptr_ = p + bytes;
+    return p;
+  }
+
+  static chunk* new_chunk(std::size_t size) {
+    void* memory = ::operator new(header_size + size);
+    return ::new (memory) chunk{nullptr, size};
+  }
+
+  // Frees the chunks in `[first, last)`.
+  static void free_chunks(chunk* first, chunk* last) noexcept {
+    while (first != last) {
+      chunk* next = first->next;
+      ::operator delete(first);
+      first = next;
+    }
+  }
+
+  void* allocate_slow(std::size_t bytes, std::size_t alignment) {
+    std::size_t const worst_case = bytes + (alignment > alignof(std::max_align_t) ? alignment : 0);
+    if (worst_case > chunk_size_ / 4) {
+      chunk* c = new_chunk(worst_case);
+      c->next = large_;
+      large_ = c;
+      return align_up(data(c), alignment);
+    }
+
+    chunk* c;
+    if (spare_ != nullptr) {
+      c = spare_;
+      spare_ = c->next;
+    } else {
+      c = new_chunk(chunk_size_);
+    }
+    c->next = chunks_;
+    chunks_ = c;
+    ptr_ = data(c);
+    end_ = ptr_ + c->size;
+
+    char* p = bump(bytes, alignment);
+    assert(p != nullptr && "a fresh chunk must be able to hold a small allocation");
+    return p;
+  }
+};
+
+//! Allocator allocating memory from an `arena`.
+//!
+//! Deallocation is a no-op: the memory is only released when the arena is
+//! reset. This allocator can be used with standard containers, as the
+//! `Container` of a `bounded_channel` (see its constructor taking a
+//! container), or as the underlying allocator of a
+//! `deferred_reclamation_allocator`. Since it has no default constructor,
+//! containers using it must be constructed with an allocator instance.
+//!
+//! Two `arena_allocator`s compare equal if and only if they allocate from
+//! the same arena. The arena must outlive all the allocators referring to it.
+template <typename T>
+class arena_allocator {
+public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  //! Creates an allocator allocating from the given arena.
+  explicit arena_allocator(amz::arena& arena) noexcept : arena_{&arena} { }
+
+  template <typename U>
+  arena_allocator(arena_allocator<U> const& other) noexcept : arena_{other.arena_} { }
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept {
+    arena_->deallocate(p, n * sizeof(T));
+  }
+
+  //! Returns the arena this allocator allocates from.
+  amz::arena& arena() const noexcept { return *arena_; }
+
+  friend bool operator==(arena_allocator const& a, arena_allocator const& b) noexcept
+  { return a.arena_ == b.arena_; }
+
+  friend bool operator!=(arena_allocator const& a, arena_allocator const& b) noexcept
+  { return !(a == b); }
+
+private:
+  template <typename>
+  friend class arena_allocator;
+  amz::arena* arena_;
+};
+
+} // end namespace amz
+
+#endif // include guard
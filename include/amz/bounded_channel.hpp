@@ -14,18 +14,21 @@
 #ifndef AMZ_BOUNDED_CHANNEL_HPP
 #define AMZ_BOUNDED_CHANNEL_HPP
 
+#include <atomic>
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <condition_variable>
 #include <cstddef>
 #include <deque>
+#include <functional>
 #include <iterator>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <boost/optional.hpp>
 
@@ -52,6 +55,75 @@ enum class channel_op_status {
   timeout
 };
 
+//! Element carrying a deadline after which it is not worth processing.
+//!
+//! When the `value_type` of a `bounded_channel` is an `expiring<T, Clock>`,
+//! the channel discards elements whose deadline has passed instead of
+//! returning them from popping operations. See the note on expiring elements
+//! in the documentation of `bounded_channel`.
+template <typename T, typename Clock = std::chrono::steady_clock>
+struct expiring {
+  using clock = Clock;
+  using time_point = typename Clock::time_point;
+
+  T value;
+  time_point deadline;
+};
+
+//! Returns an `expiring` element whose deadline is `ttl` from now.
+template <typename Clock = std::chrono::steady_clock, typename T, typename Rep, typename Period>
+expiring<std::decay_t<T>, Clock> expire_after(std::chrono::duration<Rep, Period> ttl, T&& value) {
+  using Deadline = typename expiring<std::decay_t<T>, Clock>::time_point;
+  return {std::forward<T>(value), std::chrono::time_point_cast<typename Deadline::duration>(Clock::now() + ttl)};
+}
+
+namespace detail {
+  template <typename T>
+  struct is_expiring : std::false_type { };
+
+  template <typename T, typename Clock>
+  struct is_expiring<expiring<T, Clock>> : std::true_type { };
+
+  // Token bucket holding up to `burst` tokens, and refilled with `rate`
+  // tokens per second.
+  // WARNING -- not thread safe
+  class token_bucket {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    token_bucket(double rate, double burst, clock::time_point now)
+      : rate_{rate}, burst_{burst}, tokens_{burst}, last_{now}
+    { }
+
+    // Takes a token if one is available at time `now`.
+    bool try_take(clock::time_point now) {
+      tokens_ = std::min(burst_, tokens_ + std::chrono::duration<double>(now - last_).count() * rate_);
+      last_ = now;
+      if (tokens_ < 1)
+        return false;
+      tokens_ -= 1;
+      return true;
+    }
+
+    // Gives back a token that was taken but not used.
+    void refund() { tokens_ = std::min(burst_, tokens_ + 1); }
+
+    // Returns the time at which the next token will be available, assuming
+    // that `try_take(now)` just failed.
+    clock::time_point next_token(clock::time_point now) const {
+      auto const wait = std::chrono::duration<double>((1 - tokens_) / rate_);
+      // Round up, so that we don't wake up right before the token is there.
+      return now + std::chrono::duration_cast<clock::duration>(wait) + clock::duration{1};
+    }
+
+  private:
+    double rate_;
+    double burst_;
+    double tokens_;
+    clock::time_point last_;
+  };
+} // end namespace detail
+
 //! Multi-producer multi-consumer thread-safe channel.
 //!
 //! This class represents a queue that can be concurrently pushed to and popped
@@ -66,7 +138,8 @@ enum class channel_op_status {
 //!
 //! The underlying container used by the channel can be customized with a
 //! template argument. The only requirement is that the container can be
-//! used as the underlying container for a `std::queue`.
+//! used as the underlying container for a `std::queue`, i.e. that it provides
+//! `front()`, `push_back()`, `pop_front()`, `size()` and `empty()`.
 //!
 //! The design of this channel is heavily based on Boost.Fiber's channels.
 //!
@@ -83,6 +156,35 @@ enum class channel_op_status {
 //! implementation. As always, benchmarking is key.
 //!
 //!
+//! Note on expiring elements
+//! ==========================
+//! When the channel holds `expiring<U, Clock>` elements, popping operations
+//! (including iteration, `pop_some()` and `pop_some_while()`) discard the
+//! elements at the front of the channel whose deadline has passed, and only
+//! return live elements. Hence, under overload, consumers don't spend time
+//! on work that is already useless. Discarded elements are counted (see
+//! `expired_count()`), and they are passed to the handler set with
+//! `set_expiry_handler()`, if any, after the lock on the channel has been
+//! released. Since only the front of the channel is inspected, an expired
+//! element is discarded when it reaches the front of the channel, and not
+//! earlier. `drain()` does not discard anything.
+//!
+//!
+//! Note on pacing
+//! ==============
+//! The rate at which elements leave the channel can be limited with
+//! `set_rate_limit()`, for consumers feeding a downstream service that must
+//! not receive more than a given number of requests per second. Popping
+//! operations then take a token from a token bucket for each element they
+//! return, and wait for tokens within the channel's own waits: blocking
+//! operations sleep until the next token is available, timed operations
+//! don't wait past their deadline (returning `timeout`), and `try_pop()`
+//! returns `timeout` when an element is available but no token is. Since the
+//! elements stay in the channel while consumers wait for tokens, producers
+//! naturally see backpressure when elements arrive faster than the pace.
+//! `drain()` is not paced.
+//!
+//!
 //! Note on lifetime
 //! ================
 //! As usual in C++, a `bounded_channel` must outlive any reference to it.
@@ -119,8 +221,22 @@ public:
   bounded_channel() = delete;
 
   //! Creates a `bounded_channel` with the given capacity.
+  //!
+  //! The capacity must be at least 1: a channel with a capacity of 0 is
+  //! always full, so pushing to it would block forever. Use a
+  //! `rendezvous_channel` to hand elements directly from producers to
+  //! consumers instead.
   explicit bounded_channel(std::size_t capacity);
 
+  //! Creates a `bounded_channel` with the given capacity, using the given
+  //! container to hold its elements.
+  //!
+  //! This makes it possible to use containers that can't be default
+  //! constructed, e.g. containers using a stateful allocator such as
+  //! `arena_allocator`. The elements of `container`, if any, are the initial
+  //! contents of the channel.
+  bounded_channel(std::size_t capacity, Container container);
+
   bounded_channel(bounded_channel const&) = delete;
   bounded_channel(bounded_channel&&) = delete;
   bounded_channel& operator=(bounded_channel const&) = delete;
@@ -235,6 +351,8 @@ public:
   //!   waiting on a pushing operation, and returns `success`.
   //! - If the channel is empty and has been closed, returns `closed`.
   //! - If the channel is empty and has not been closed, returns `empty`.
+  //! - If the channel is paced and no token is available, returns `timeout`
+  //!   (see the note on pacing).
   //!
   //! Note
   //! ====
@@ -279,6 +397,153 @@ public:
   >
   channel_op_status try_pop_until(std::chrono::time_point<Clock, Duration> timeout_time, Value& va);
 
+  //! Pushes the elements of the range `[first, last)` into the channel, in
+  //! order, possibly blocking whenever the channel is full.
+  //!
+  //! Elements are pushed in chunks: the lock is acquired once for as many
+  //! elements as there is room for in the channel, and waiting consumers are
+  //! notified once per chunk. Hence, consumers may observe a prefix of the
+  //! range before the whole range has been pushed.
+  //!
+  //! - If the whole range was pushed, returns `success` and `last`.
+  //! - If the channel is closed before the whole range could be pushed,
+  //!   returns `closed` and an iterator to the first element that was not
+  //!   pushed.
+  //!
+  //! Note
+  //! ====
+  //! Elements are copied out of the range, unless the range is made of
+  //! `std::move_iterator`s, in which case they are moved.
+  template <typename InputIterator>
+  std::pair<channel_op_status, InputIterator> push_range(InputIterator first, InputIterator last);
+
+  //! Dequeues up to `max_n` elements from the channel into an output iterator,
+  //! possibly blocking if the channel is empty.
+  //!
+  //! This is the batch equivalent of `pop()`: the lock is acquired only once
+  //! for all the dequeued elements.
+  //!
+  //! - If the channel is not empty, immediately dequeues up to `max_n` values
+  //!   from the channel into `out`, notifies threads waiting on a pushing
+  //!   operation, and returns `success` along with the output iterator
+  //!   past the last dequeued value.
+  //! - If the channel is empty, waits until either new items are pushed to
+  //!   the channel (dequeues them as above), or the channel is closed
+  //!   (returns `closed` and `out` unchanged).
+  //!
+  //! Note
+  //! ====
+  //! Elements are written to `out` while the lock on the channel is held, so
+  //! writing to `out` should be cheap. `max_n` must be greater than 0.
+  template <typename OutputIterator>
+  std::pair<channel_op_status, OutputIterator> pop_some(OutputIterator out, std::size_t max_n);
+
+  //! Equivalent to `pop_some()`, but only dequeues elements as long as they
+  //! satisfy the given predicate.
+  //!
+  //! The first element that does not satisfy the predicate is left at the
+  //! front of the channel. Hence, if `success` is returned but no element was
+  //! dequeued, the element at the front of the channel does not satisfy the
+  //! predicate. The predicate is called with the lock on the channel held.
+  template <typename OutputIterator, typename Predicate>
+  std::pair<channel_op_status, OutputIterator> pop_some_while(OutputIterator out, std::size_t max_n, Predicate const& pred);
+
+  //! Dequeues a batch of up to `max_n` elements from the channel into an
+  //! output iterator, waiting for the batch to fill up for a bounded time.
+  //!
+  //! This blocks until either `max_n` elements are available, or `max_wait`
+  //! has elapsed since the oldest element in the channel arrived, and then
+  //! dequeues up to `max_n` elements under a single lock. This makes it
+  //! possible to batch downstream work while bounding the latency added by
+  //! batching, without having to use timers.
+  //!
+  //! - If the channel is not empty when the batch is complete or the wait
+  //!   expires, dequeues up to `max_n` values into `out`, notifies threads
+  //!   waiting on a pushing operation, and returns `success` along with the
+  //!   output iterator past the last dequeued value.
+  //! - If the channel is full, the batch is considered complete, since it
+  //!   can't grow any further (this happens when `max_n` is larger than the
+  //!   capacity of the channel).
+  //! - If the channel is closed, the batch is considered complete: remaining
+  //!   elements are dequeued as above, and `closed` is returned (with `out`
+  //!   unchanged) once the channel is empty.
+  //!
+  //! Note
+  //! ====
+  //! The time of arrival of the oldest element is approximated by the last
+  //! time the channel went from empty to non-empty. Hence, elements left in
+  //! the channel by a previous batch do not delay the next batch. `max_n`
+  //! must be greater than 0.
+  template <typename OutputIterator, typename Rep, typename Period>
+  std::pair<channel_op_status, OutputIterator>
+  pop_batch(OutputIterator out, std::size_t max_n, std::chrono::duration<Rep, Period> max_wait);
+
+  //! Dequeues all the elements currently in the channel into `out`, in order,
+  //! without blocking.
+  //!
+  //! If `out` is empty, this swaps the contents of the channel with `out`
+  //! under a single lock, which is O(1) regardless of the number of elements
+  //! in the channel. Otherwise, the elements are moved to the back of `out`
+  //! one by one. In both cases, all threads waiting on a pushing operation
+  //! are notified once.
+  //!
+  //! - If the channel is not empty, dequeues everything into `out` and
+  //!   returns `success`.
+  //! - If the channel is empty and has been closed, returns `closed`.
+  //! - If the channel is empty and has not been closed, returns `empty`.
+  //!
+  //! Note
+  //! ====
+  //! Since the containers are swapped, `out` must be swappable with the
+  //! channel's container; in particular, their allocators must compare
+  //! equal unless they propagate on swap.
+  channel_op_status drain(Container& out);
+
+  //! Sets a function called with each element discarded because it expired.
+  //!
+  //! The handler is called by the thread performing the popping operation
+  //! that discarded the element, after the lock on the channel has been
+  //! released. It must not throw. Setting the handler is not thread safe: it
+  //! must be done before the channel is used concurrently.
+  //!
+  //! This is only available for channels of `expiring` elements.
+  template <typename F, typename U = T, typename = std::enable_if_t<detail::is_expiring<U>::value>>
+  void set_expiry_handler(F handler) {
+    expiry_handler_ = std::move(handler);
+  }
+
+  //! Returns the approximate number of elements in the channel.
+  //!
+  //! This does not take the lock on the channel: it returns the size of the
+  //! channel as of some recent operation, which may already be stale by the
+  //! time it is returned. It is meant for heuristics such as load balancing
+  //! (see `channel_dispatcher`), not for synchronization.
+  std::size_t size() const noexcept {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+  //! Returns the capacity of the channel.
+  std::size_t capacity() const noexcept { return capacity_; }
+
+  //! Limits the rate at which elements are popped from the channel to
+  //! `per_second` elements per second on average, allowing bursts of up to
+  //! `burst` elements. See the note on pacing.
+  //!
+  //! The bucket starts full. This may be called at any time, and replaces
+  //! any previous limit. `per_second` must be positive and `burst` must be
+  //! at least 1.
+  void set_rate_limit(double per_second, std::size_t burst = 1);
+
+  //! Removes the limit set with `set_rate_limit()`, if any.
+  void clear_rate_limit();
+
+  //! Returns the number of elements discarded so far because they expired.
+  //! This is always zero for channels of elements that are not `expiring`.
+  std::size_t expired_count() {
+    std::unique_lock<mutex_type> lock{mutex_};
+    return expired_count_;
+  }
+
 
   //! InputIterator associated to a channel.
   //!
@@ -308,7 +573,7 @@ public:
 
 private:
   std::size_t const capacity_;
-  std::queue<T, Container> queue_;
+  Container queue_;
   // Note: timed_mutex is necessary because we use try_lock_for, and
   //       condition_variable_any is necessary because we use timed_mutex.
   using mutex_type = std::timed_mutex;
@@ -316,6 +581,105 @@ private:
   std::condition_variable_any consumers_; // notified when we push something new; waited on by popping (consumer) threads
   std::condition_variable_any producers_; // notified when we pop something; waited on by pushing (producer) threads
   bool closed_;
+  std::function<void(value_type&&)> expiry_handler_;
+  std::size_t expired_count_;
+  std::chrono::steady_clock::time_point first_arrival_; // last time the queue went from empty to non-empty
+  std::size_t batch_waiters_; // number of threads waiting for a batch to fill up in `pop_batch()`
+  std::atomic<std::size_t> size_; // copy of `queue_.size()` that can be read without the lock
+  boost::optional<detail::token_bucket> pacing_; // set when the channel is paced
+
+  // Pushes an element at the back of the queue, keeping track of its arrival
+  // time if the queue was empty.
+  // WARNING -- not thread safe
+  template <typename Value>
+  void enqueue(Value&& va) {
+    if (queue_.empty())
+      first_arrival_ = std::chrono::steady_clock::now();
+    queue_.push_back(std::forward<Value>(va));
+    size_.store(queue_.size(), std::memory_order_relaxed);
+  }
+
+  // Pops the element at the front of the queue.
+  // WARNING -- not thread safe
+  void dequeue() {
+    queue_.pop_front();
+    size_.store(queue_.size(), std::memory_order_relaxed);
+  }
+
+  // Releases the lock and notifies waiting consumers after `n` elements were
+  // pushed. Threads waiting in `pop_batch()` only wake up when their batch is
+  // complete, so they could swallow a notification meant for another
+  // consumer; when there are such threads, everybody is notified.
+  void notify_consumers(std::unique_lock<mutex_type>& lock, std::size_t n) {
+    bool const batch_waiters = batch_waiters_ != 0;
+    lock.unlock();
+    if (batch_waiters && n != 0)
+      consumers_.notify_all();
+    else
+      notify(consumers_, n);
+  }
+
+  // Elements discarded by a popping operation because they expired. They are
+  // handed to the expiry handler when this object is destroyed, which happens
+  // after the lock on the channel has been released as long as this object is
+  // declared before the lock.
+  class expired_elements {
+  public:
+    explicit expired_elements(bounded_channel& channel) : channel_{channel}, count_{0} { }
+    ~expired_elements() {
+      for (value_type& element : elements_)
+        channel_.expiry_handler_(std::move(element));
+    }
+
+    // WARNING -- must be called with the lock held
+    void discard(value_type&& element) {
+      ++count_;
+      ++channel_.expired_count_;
+      if (channel_.expiry_handler_)
+        elements_.push_back(std::move(element));
+    }
+
+    std::size_t count() const { return count_; }
+
+  private:
+    bounded_channel& channel_;
+    std::vector<value_type> elements_;
+    std::size_t count_;
+  };
+
+  // Discards the expired elements at the front of the queue, if the elements
+  // of the channel are `expiring`.
+  // WARNING -- not thread safe
+  void discard_expired(expired_elements& expired) {
+    this->discard_expired(expired, detail::is_expiring<value_type>{});
+  }
+  void discard_expired(expired_elements&, std::false_type) { }
+  void discard_expired(expired_elements& expired, std::true_type) {
+    if (is_empty())
+      return;
+    auto const now = value_type::clock::now();
+    while (!is_empty() && queue_.front().deadline <= now) {
+      expired.discard(std::move(queue_.front()));
+      dequeue();
+    }
+  }
+
+  // Waits until an element can be popped, i.e. until the channel is not
+  // empty and, if it is paced, a token could be taken. Also returns when the
+  // channel is closed and empty. Returns false if `timeout_time` (when
+  // given) was reached first.
+  // WARNING -- must be called with the lock held
+  template <typename TimePoint>
+  bool wait_poppable(std::unique_lock<mutex_type>& lock, expired_elements& expired, TimePoint const* timeout_time);
+  bool wait_poppable(std::unique_lock<mutex_type>& lock, expired_elements& expired) {
+    return this->wait_poppable(lock, expired, static_cast<std::chrono::steady_clock::time_point const*>(nullptr));
+  }
+
+  // Takes a token for popping an element, if the channel is paced.
+  // WARNING -- not thread safe
+  bool take_token() {
+    return !pacing_ || pacing_->try_take(std::chrono::steady_clock::now());
+  }
 
   template <typename Value>
   channel_op_status push_impl(Value&& va);
@@ -324,6 +688,14 @@ private:
   template <typename Value, typename TimePoint>
   channel_op_status try_push_until_impl(TimePoint timeout_time, Value&& va);
 
+  // Notifies waiters on `cv` after `n` elements were pushed or popped.
+  static void notify(std::condition_variable_any& cv, std::size_t n) {
+    if (n > 1)
+      cv.notify_all();
+    else if (n == 1)
+      cv.notify_one();
+  }
+
   // WARNING -- not thread safe
   bool is_full() const { return queue_.size() >= capacity_; }
 
@@ -345,6 +717,28 @@ bounded_channel<T, Container>::bounded_channel(std::size_t capacity)
   , consumers_{}
   , producers_{}
   , closed_{false}
+  , expiry_handler_{}
+  , expired_count_{0}
+  , first_arrival_{std::chrono::steady_clock::now()}
+  , batch_waiters_{0}
+  , size_{queue_.size()}
+  , pacing_{}
+{ }
+
+template <typename T, typename Container>
+bounded_channel<T, Container>::bounded_channel(std::size_t capacity, Container container)
+  : capacity_{capacity}
+  , queue_{std::move(container)}
+  , mutex_{}
+  , consumers_{}
+  , producers_{}
+  , closed_{false}
+  , expiry_handler_{}
+  , expired_count_{0}
+  , first_arrival_{std::chrono::steady_clock::now()}
+  , batch_waiters_{0}
+  , size_{queue_.size()}
+  , pacing_{}
 { }
 
 template <typename T, typename Container>
@@ -369,9 +763,8 @@ channel_op_status bounded_channel<T, Container>::push_impl(Value&& va) {
     return channel_op_status::closed;
   } else {
     assert(!is_full());
-    queue_.push(std::forward<Value>(va));
-    lock.unlock();
-    consumers_.notify_one();
+    enqueue(std::forward<Value>(va));
+    notify_consumers(lock, 1);
     return channel_op_status::success;
   }
 }
@@ -383,9 +776,8 @@ channel_op_status bounded_channel<T, Container>::try_push_impl(Value&& va) {
   if (is_closed()) {
     return channel_op_status::closed;
   } else if (!is_full()) {
-    queue_.push(std::forward<Value>(va));
-    lock.unlock();
-    consumers_.notify_one();
+    enqueue(std::forward<Value>(va));
+    notify_consumers(lock, 1);
     return channel_op_status::success;
   } else {
     assert(is_full());
@@ -410,29 +802,92 @@ channel_op_status bounded_channel<T, Container>::try_push_until_impl(TimePoint t
     return channel_op_status::closed;
   } else {
     assert(!is_full() && "we have not timed out and the channel is not closed; the channel should not be full");
-    queue_.push(std::forward<Value>(va));
-    lock.unlock();
-    consumers_.notify_one();
+    enqueue(std::forward<Value>(va));
+    notify_consumers(lock, 1);
     return channel_op_status::success;
   }
 }
 
+//
+// set_rate_limit(), clear_rate_limit()
+//
+template <typename T, typename Container>
+void bounded_channel<T, Container>::set_rate_limit(double per_second, std::size_t burst) {
+  assert(per_second > 0 && burst >= 1);
+  {
+    std::unique_lock<mutex_type> lock{mutex_};
+    pacing_.emplace(per_second, static_cast<double>(burst), std::chrono::steady_clock::now());
+  }
+  // Consumers waiting for a token may be able to pop right away.
+  consumers_.notify_all();
+}
+
+template <typename T, typename Container>
+void bounded_channel<T, Container>::clear_rate_limit() {
+  {
+    std::unique_lock<mutex_type> lock{mutex_};
+    pacing_ = boost::none;
+  }
+  consumers_.notify_all();
+}
+
+template <typename T, typename Container>
+template <typename TimePoint>
+bool bounded_channel<T, Container>::wait_poppable(std::unique_lock<mutex_type>& lock, expired_elements& expired,
+                                                  TimePoint const* timeout_time) {
+  using steady_clock = std::chrono::steady_clock;
+  auto ready = [&] {
+    this->discard_expired(expired);
+    return !this->is_empty() || this->is_closed();
+  };
+
+  while (true) {
+    if (timeout_time == nullptr)
+      consumers_.wait(lock, ready);
+    else if (!consumers_.wait_until(lock, *timeout_time, ready))
+      return false;
+
+    steady_clock::time_point const now = steady_clock::now();
+    if (is_empty() || !pacing_ || pacing_->try_take(now))
+      return true;
+
+    // Wait for the next token, but not past the timeout. Another consumer
+    // may have been notified while we hold on to the element at the front
+    // of the channel, so pass the notification along if we give up.
+    steady_clock::time_point wake_up = pacing_->next_token(now);
+    if (timeout_time != nullptr) {
+      using clock = typename TimePoint::clock;
+      auto const left = *timeout_time - clock::now();
+      if (left <= left.zero()) {
+        consumers_.notify_one();
+        return false;
+      }
+      if (left < wake_up - now)
+        wake_up = now + std::chrono::duration_cast<steady_clock::duration>(left);
+    }
+    consumers_.wait_until(lock, wake_up);
+  }
+}
+
 //
 // pop(), try_pop(), try_pop_until()
 //
 template <typename T, typename Container>
 template <typename Value, typename>
 channel_op_status bounded_channel<T, Container>::pop(Value& va) {
+  expired_elements expired{*this};
   std::unique_lock<mutex_type> lock{mutex_};
-  consumers_.wait(lock, [this] { return !this->is_empty() || this->is_closed(); });
+  wait_poppable(lock, expired);
   if (!is_empty()) {
     va = std::move(queue_.front());
-    queue_.pop();
+    dequeue();
     lock.unlock();
-    producers_.notify_one();
+    notify(producers_, 1 + expired.count());
     return channel_op_status::success;
   } else {
     assert(is_closed());
+    lock.unlock();
+    notify(producers_, expired.count());
     return channel_op_status::closed;
   }
 }
@@ -440,44 +895,200 @@ channel_op_status bounded_channel<T, Container>::pop(Value& va) {
 template <typename T, typename Container>
 template <typename Value, typename>
 channel_op_status bounded_channel<T, Container>::try_pop(Value& va) {
+  expired_elements expired{*this};
   std::unique_lock<mutex_type> lock{mutex_};
+  discard_expired(expired);
   if (!is_empty()) {
+    if (!take_token()) {
+      lock.unlock();
+      notify(producers_, expired.count());
+      return channel_op_status::timeout;
+    }
     va = std::move(queue_.front());
-    queue_.pop();
+    dequeue();
     lock.unlock();
-    producers_.notify_one();
+    notify(producers_, 1 + expired.count());
     return channel_op_status::success;
-  } else if (is_closed()) {
-    return channel_op_status::closed;
-  } else {
-    assert(is_empty());
-    return channel_op_status::empty;
   }
+
+  channel_op_status const status = is_closed() ? channel_op_status::closed : channel_op_status::empty;
+  lock.unlock();
+  notify(producers_, expired.count());
+  return status;
 }
 
 template <typename T, typename Container>
 template <typename Clock, typename Duration, typename Value, typename>
 channel_op_status bounded_channel<T, Container>::try_pop_until(std::chrono::time_point<Clock, Duration> timeout_time, Value& va) {
+  expired_elements expired{*this};
   std::unique_lock<mutex_type> lock{mutex_, timeout_time}; // try to lock for no longer than the timeout
   if (!lock.owns_lock()) {
     return channel_op_status::timeout;
   }
 
-  bool const timed_out = !consumers_.wait_until(lock, timeout_time, [this] {
-    return !this->is_empty() || this->is_closed();
-  });
-  if (timed_out) {
-    return channel_op_status::timeout;
-  } else if (!is_empty()) {
+  bool const timed_out = !wait_poppable(lock, expired, &timeout_time);
+  if (!timed_out && !is_empty()) {
     va = std::move(queue_.front());
-    queue_.pop();
+    dequeue();
     lock.unlock();
-    producers_.notify_one();
+    notify(producers_, 1 + expired.count());
     return channel_op_status::success;
-  } else {
+  }
+
+  assert(timed_out || is_closed());
+  lock.unlock();
+  notify(producers_, expired.count());
+  return timed_out ? channel_op_status::timeout : channel_op_status::closed;
+}
+
+//
+// push_range(), pop_some(), pop_some_while()
+//
+template <typename T, typename Container>
+template <typename InputIterator>
+std::pair<channel_op_status, InputIterator>
+bounded_channel<T, Container>::push_range(InputIterator first, InputIterator last) {
+  while (first != last) {
+    std::unique_lock<mutex_type> lock{mutex_};
+    producers_.wait(lock, [this] { return this->is_closed() || !this->is_full(); });
+    if (is_closed()) {
+      return std::make_pair(channel_op_status::closed, first);
+    }
+
+    std::size_t pushed = 0;
+    for (; first != last && !is_full(); ++first, ++pushed) {
+      enqueue(*first);
+    }
+    notify_consumers(lock, pushed);
+  }
+  return std::make_pair(channel_op_status::success, first);
+}
+
+template <typename T, typename Container>
+template <typename OutputIterator>
+std::pair<channel_op_status, OutputIterator>
+bounded_channel<T, Container>::pop_some(OutputIterator out, std::size_t max_n) {
+  return this->pop_some_while(out, max_n, [](value_type const&) { return true; });
+}
+
+template <typename T, typename Container>
+template <typename OutputIterator, typename Predicate>
+std::pair<channel_op_status, OutputIterator>
+bounded_channel<T, Container>::pop_some_while(OutputIterator out, std::size_t max_n, Predicate const& pred) {
+  assert(max_n > 0 && "pop_some() and pop_some_while() require a positive number of elements");
+  expired_elements expired{*this};
+  std::unique_lock<mutex_type> lock{mutex_};
+  wait_poppable(lock, expired);
+  if (is_empty()) {
     assert(is_closed());
-    return channel_op_status::closed;
+    lock.unlock();
+    notify(producers_, expired.count());
+    return std::make_pair(channel_op_status::closed, out);
+  }
+
+  // A token was taken for the first element by `wait_poppable()`.
+  std::size_t popped = 0;
+  for (; popped != max_n && !is_empty() && (popped == 0 || take_token()); ++popped) {
+    value_type& front = queue_.front();
+    if (!pred(static_cast<value_type const&>(front))) {
+      if (pacing_)
+        pacing_->refund();
+      break;
+    }
+    *out++ = std::move(front);
+    dequeue();
+    discard_expired(expired);
   }
+  lock.unlock();
+  notify(producers_, popped + expired.count());
+  return std::make_pair(channel_op_status::success, out);
+}
+
+template <typename T, typename Container>
+template <typename OutputIterator, typename Rep, typename Period>
+std::pair<channel_op_status, OutputIterator>
+bounded_channel<T, Container>::pop_batch(OutputIterator out, std::size_t max_n, std::chrono::duration<Rep, Period> max_wait) {
+  assert(max_n > 0 && "pop_batch() requires a positive number of elements");
+  expired_elements expired{*this};
+  std::unique_lock<mutex_type> lock{mutex_};
+  while (true) {
+    consumers_.wait(lock, [&] {
+      this->discard_expired(expired);
+      return !this->is_empty() || this->is_closed();
+    });
+    if (is_empty()) {
+      assert(is_closed());
+      lock.unlock();
+      notify(producers_, expired.count());
+      return std::make_pair(channel_op_status::closed, out);
+    }
+
+    // Wait for the batch to fill up, or for the oldest element to have
+    // waited long enough.
+    using time_point = std::chrono::steady_clock::time_point;
+    bool const unbounded = std::chrono::duration<double>(max_wait) >=
+                           std::chrono::duration<double>(time_point::max() - first_arrival_);
+    time_point const deadline = unbounded
+      ? time_point::max()
+      : first_arrival_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(max_wait);
+    ++batch_waiters_;
+    consumers_.wait_until(lock, deadline, [&] {
+      this->discard_expired(expired);
+      // A full channel can't grow any further, so the batch is complete
+      // even if `max_n` is larger than the capacity.
+      return queue_.size() >= max_n || this->is_full() || this->is_closed();
+    });
+    --batch_waiters_;
+
+    // Other consumers may have emptied the channel in the meantime.
+    if (!is_empty())
+      break;
+  }
+
+  // Wait for a token for the first element, if the channel is paced.
+  // Other consumers may empty the channel in the meantime.
+  if (pacing_) {
+    wait_poppable(lock, expired);
+    if (is_empty()) {
+      lock.unlock();
+      notify(producers_, expired.count());
+      return std::make_pair(channel_op_status::closed, out);
+    }
+  }
+
+  std::size_t popped = 0;
+  for (; popped != max_n && !is_empty() && (popped == 0 || take_token()); ++popped) {
+    *out++ = std::move(queue_.front());
+    dequeue();
+    discard_expired(expired);
+  }
+  lock.unlock();
+  notify(producers_, popped + expired.count());
+  return std::make_pair(channel_op_status::success, out);
+}
+
+//
+// drain()
+//
+template <typename T, typename Container>
+channel_op_status bounded_channel<T, Container>::drain(Container& out) {
+  std::unique_lock<mutex_type> lock{mutex_};
+  if (is_empty()) {
+    return is_closed() ? channel_op_status::closed : channel_op_status::empty;
+  }
+
+  if (out.empty()) {
+    using std::swap;
+    swap(queue_, out);
+  } else {
+    for (; !is_empty(); queue_.pop_front()) {
+      out.push_back(std::move(queue_.front()));
+    }
+  }
+  size_.store(0, std::memory_order_relaxed);
+  lock.unlock();
+  producers_.notify_all();
+  return channel_op_status::success;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,175 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_CHANNEL_DISPATCHER_HPP
+#define AMZ_CHANNEL_DISPATCHER_HPP
+
+#include <amz/bounded_channel.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+
+namespace amz {
+
+namespace detail {
+  // Returns a random number generator local to the calling thread, so that
+  // dispatchers can be used from several threads without synchronization.
+  inline std::minstd_rand& dispatcher_random() {
+    thread_local std::minstd_rand random{std::random_device{}()};
+    return random;
+  }
+} // end namespace detail
+
+//! Pushes elements to the least loaded of several channels.
+//!
+//! A dispatcher refers to a fixed set of channels, typically the input
+//! channels of a pool of workers, and pushes each element to one of them.
+//! Instead of distributing elements round-robin, which piles up work on slow
+//! workers, the dispatcher samples two channels at random and picks the one
+//! holding the fewest elements ("power of two choices"). This is almost as
+//! good as picking the least loaded channel overall, without having to look
+//! at all of them.
+//!
+//! If the chosen channel is full, the other channels are tried in turn with
+//! `try_push()`, starting with the other sampled channel, so a push only
+//! blocks when all the channels are full.
+//!
+//! `Channel` must provide `size()`, `try_push()` and `push()` with the same
+//! semantics as `bounded_channel`, whose `size()` is approximate and doesn't
+//! take any lock. A dispatcher can be used concurrently from several threads.
+//!
+//! Note on lifetime
+//! ================
+//! The dispatcher does not own the channels, which must outlive it.
+template <typename Channel>
+class channel_dispatcher {
+public:
+  using channel_type = Channel;
+  using value_type = typename Channel::value_type;
+
+  //! Creates a dispatcher over the given channels, of which there must be at
+  //! least one.
+  explicit channel_dispatcher(std::vector<Channel*> channels)
+    : channels_{std::move(channels)}
+  {
+    assert(!channels_.empty() && "a channel_dispatcher requires at least one channel");
+  }
+
+  //! Pushes a value to one of the channels, preferring the least loaded one.
+  //!
+  //! - If a channel accepts the value without blocking, returns `success`.
+  //! - If all the channels are closed, returns `closed`.
+  //! - Otherwise, blocks pushing to the least loaded of the sampled channels,
+  //!   and returns the result of that push.
+  channel_op_status push(value_type const& va) { return this->push_impl(va); }
+  channel_op_status push(value_type&& va)      { return this->push_impl(std::move(va)); }
+
+  //! Pushes a value to one of the channels, preferring the least loaded one,
+  //! without blocking.
+  //!
+  //! Returns `success` if a channel accepted the value, `closed` if all the
+  //! channels are closed, and `full` otherwise. The value is only moved from
+  //! on success.
+  channel_op_status try_push(value_type const& va) { return this->try_push_impl(va).first; }
+  channel_op_status try_push(value_type&& va)      { return this->try_push_impl(std::move(va)).first; }
+
+  //! Returns the number of channels of the dispatcher.
+  std::size_t channel_count() const noexcept { return channels_.size(); }
+
+private:
+  std::vector<Channel*> channels_;
+
+  // Returns the index of the least loaded of two randomly sampled channels,
+  // followed by the index of the other one.
+  std::pair<std::size_t, std::size_t> sample() const;
+
+  // Tries to push to every channel, starting with the sampled ones. Returns
+  // the status of the operation, along with the index of the channel the
+  // value was pushed to on success, or of a full channel on failure.
+  template <typename Value>
+  std::pair<channel_op_status, std::size_t> try_push_impl(Value&& va);
+
+  template <typename Value>
+  channel_op_status push_impl(Value&& va);
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Dispatcher implementation
+//////////////////////////////////////////////////////////////////////////////
+template <typename Channel>
+std::pair<std::size_t, std::size_t> channel_dispatcher<Channel>::sample() const {
+  std::size_t const n = channels_.size();
+  if (n == 1)
+    return std::make_pair(0, 0);
+
+  // Sample two distinct channels.
+  std::minstd_rand& random = detail::dispatcher_random();
+  std::size_t const first = std::uniform_int_distribution<std::size_t>{0, n - 1}(random);
+  std::size_t const offset = std::uniform_int_distribution<std::size_t>{1, n - 1}(random);
+  std::size_t const second = (first + offset) % n;
+
+  if (channels_[second]->size() < channels_[first]->size())
+    return std::make_pair(second, first);
+  return std::make_pair(first, second);
+}
+
+template <typename Channel>
+template <typename Value>
+std::pair<channel_op_status, std::size_t> channel_dispatcher<Channel>::try_push_impl(Value&& va) {
+  std::size_t const n = channels_.size();
+  std::pair<std::size_t, std::size_t> const sampled = sample();
+
+  // Try the sampled channels first, and then all the other ones, keeping
+  // track of the first channel that was full (as opposed to closed).
+  std::size_t full = n;
+  auto attempt = [&](std::size_t i) {
+    channel_op_status const status = channels_[i]->try_push(std::forward<Value>(va));
+    if (status == channel_op_status::full && full == n)
+      full = i;
+    return status == channel_op_status::success;
+  };
+
+  if (attempt(sampled.first))
+    return std::make_pair(channel_op_status::success, sampled.first);
+  if (sampled.second != sampled.first && attempt(sampled.second))
+    return std::make_pair(channel_op_status::success, sampled.second);
+  for (std::size_t k = 1; k < n; ++k) {
+    std::size_t const i = (sampled.second + k) % n;
+    if (i != sampled.first && attempt(i))
+      return std::make_pair(channel_op_status::success, i);
+  }
+
+  if (full == n)
+    return std::make_pair(channel_op_status::closed, sampled.first);
+  return std::make_pair(channel_op_status::full, full);
+}
+
+template <typename Channel>
+template <typename Value>
+channel_op_status channel_dispatcher<Channel>::push_impl(Value&& va) {
+  std::pair<channel_op_status, std::size_t> const result = try_push_impl(std::forward<Value>(va));
+  if (result.first != channel_op_status::full)
+    return result.first;
+  // All the channels that are still open are full: wait on the least loaded
+  // of them, which is the sampled one unless it was closed.
+  return channels_[result.second]->push(std::forward<Value>(va));
+}
+
+} // end namespace amz
+
+#endif // include guard
@@ -0,0 +1,479 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_CONCURRENT_SKIPLIST_MAP_HPP
+#define AMZ_CONCURRENT_SKIPLIST_MAP_HPP
+
+#include <amz/deferred_reclamation_allocator.hpp>
+#include <amz/small_spin_mutex.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <utility>
+
+
+namespace amz {
+
+namespace detail {
+  // Returns a random number generator local to the calling thread, used to
+  // pick the height of new skiplist nodes.
+  inline std::minstd_rand& skiplist_random() {
+    thread_local std::minstd_rand random{std::random_device{}()};
+    return random;
+  }
+} // end namespace detail
+
+//! Ordered concurrent map with lock-free reads, implemented as a skiplist.
+//!
+//! Readers (`find()`, `contains()`, `lower_bound()` and iteration) never
+//! take a lock and never write to shared memory, so they scale with the
+//! number of cores and never wait for writers. Writers (`insert()` and
+//! `erase()`) only lock the few nodes whose links they modify, using a
+//! `small_spin_mutex` per node, so writers working on different parts of the
+//! map don't contend. This is the "lazy skiplist" of Herlihy, Lev, Luchangco
+//! and Shavit: a node is first logically removed by marking it, and then
+//! unlinked from each level of the skiplist.
+//!
+//! Mapped values can't be modified once inserted, since readers may be
+//! reading them concurrently. To update a value, erase it and insert it again
+//! (readers then see either the old or the new value), or store a type that
+//! is itself safe to modify concurrently.
+//!
+//! Note on memory reclamation
+//! ==========================
+//! Readers may still be looking at a node after it was erased. Hence, erased
+//! nodes are not destroyed right away: they are retired through a
+//! `deferred_reclamation_allocator`, and only destroyed once the _grace
+//! period_ given at construction has elapsed. Readers must not hold on to
+//! references or iterators into the map (including during a scan) for longer
+//! than the grace period; within it, they are safe against concurrent erasure.
+//! An iterator pointing to an erased node can still be incremented, and it
+//! skips the nodes that were erased.
+//!
+//! Retired nodes are reclaimed in batches as writers erase other nodes, or by
+//! calling `purge()`. Destroying the map may block for up to the grace period, while
+//! the nodes erased most recently become reclaimable.
+//!
+//! Note on node size
+//! =================
+//! Each node holds `MaxHeight` links, regardless of its actual height. With
+//! the default maximum height of 16 and a branching factor of 4, the map
+//! stays efficient up to billions of elements.
+template <typename Key, typename T, typename Compare = std::less<Key>,
+          typename Allocator = std::allocator<std::pair<Key const, T>>,
+          std::size_t MaxHeight = 16>
+class concurrent_skiplist_map {
+  static_assert(MaxHeight >= 1, "a skiplist needs at least one level");
+
+  struct node;
+
+  // The links of a node, and of the head of the skiplist.
+  struct tower {
+    explicit tower(std::size_t h) : height{h}, marked{false}, fully_linked{false} {
+      for (auto& link : next)
+        link.store(nullptr, std::memory_order_relaxed);
+    }
+
+    std::size_t const height;
+    small_spin_mutex mutex;
+    std::atomic<bool> marked;       // whether the node has been erased
+    std::atomic<bool> fully_linked; // whether the node is linked at all its levels
+    std::atomic<node*> next[MaxHeight];
+  };
+
+  using value_type_ = std::pair<Key const, T>;
+
+  struct node : tower {
+    template <typename K, typename V>
+    node(std::size_t height, K&& k, V&& v)
+      : tower{height}, value{std::forward<K>(k), std::forward<V>(v)}
+    { }
+    value_type_ value;
+  };
+
+  using NodeAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<node>;
+
+public:
+  using key_type = Key;
+  using mapped_type = T;
+  using value_type = value_type_;
+  using key_compare = Compare;
+  using size_type = std::size_t;
+
+  //! Forward iterator over the elements of the map, in key order.
+  //!
+  //! Iterators never block and skip the elements that have been erased, but
+  //! they must not be used for longer than the grace period of the map (see
+  //! the note on memory reclamation).
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename concurrent_skiplist_map::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = value_type const*;
+    using reference = value_type const&;
+
+    const_iterator() : node_{nullptr} { }
+
+    reference operator*() const { return node_->value; }
+    pointer operator->() const { return &node_->value; }
+
+    const_iterator& operator++() {
+      node_ = concurrent_skiplist_map::first_live(node_->next[0].load(std::memory_order_acquire));
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator copy{*this};
+      ++*this;
+      return copy;
+    }
+
+    friend bool operator==(const_iterator const& a, const_iterator const& b) { return a.node_ == b.node_; }
+    friend bool operator!=(const_iterator const& a, const_iterator const& b) { return a.node_ != b.node_; }
+
+  private:
+    friend class concurrent_skiplist_map;
+    explicit const_iterator(node* n) : node_{n} { }
+    node* node_;
+  };
+  using iterator = const_iterator;
+
+  //! Creates an empty map whose erased nodes are reclaimed after the given
+  //! grace period.
+  template <typename Rep, typename Period>
+  explicit concurrent_skiplist_map(std::chrono::duration<Rep, Period> grace_period,
+                                   Compare compare = Compare{},
+                                   Allocator const& allocator = Allocator{})
+    : compare_{std::move(compare)}
+    , head_{MaxHeight}
+    , size_{0}
+    , node_allocator_{allocator}
+    , retire_mutex_{}
+    , retired_{NodeAllocator{allocator}, grace_period}
+  { }
+
+  concurrent_skiplist_map(concurrent_skiplist_map const&) = delete;
+  concurrent_skiplist_map& operator=(concurrent_skiplist_map const&) = delete;
+
+  //! Destroys the map. There must not be any concurrent use of the map.
+  ~concurrent_skiplist_map();
+
+  //! Inserts an element with the given key and value if the map does not
+  //! already contain an element with an equivalent key. Returns whether the
+  //! element was inserted. Thread safe.
+  template <typename K, typename V>
+  bool insert(K&& key, V&& value);
+
+  //! Erases the element with the given key, if any. Returns whether an
+  //! element was erased. Thread safe.
+  //!
+  //! The element is destroyed once the grace period of the map has elapsed.
+  bool erase(Key const& key);
+
+  //! Returns an iterator to the element with the given key, or `end()` if
+  //! there is none. Lock-free and thread safe.
+  const_iterator find(Key const& key) const;
+
+  //! Returns whether the map contains an element with the given key.
+  //! Lock-free and thread safe.
+  bool contains(Key const& key) const { return find(key) != end(); }
+
+  //! Returns an iterator to the first element whose key is not less than
+  //! `key`, or `end()` if there is none. Lock-free and thread safe.
+  //!
+  //! Together with iteration, this provides range scans:
+  //! ```c++
+  //! for (auto it = map.lower_bound(low); it != map.end() && it->first < high; ++it)
+  //!   ...
+  //! ```
+  const_iterator lower_bound(Key const& key) const;
+
+  //! Returns an iterator to the first element of the map.
+  const_iterator begin() const { return const_iterator{first_live(head_.next[0].load(std::memory_order_acquire))}; }
+  const_iterator cbegin() const { return begin(); }
+
+  //! Returns the past-the-end iterator of the map.
+  const_iterator end() const { return const_iterator{}; }
+  const_iterator cend() const { return end(); }
+
+  //! Returns the number of elements in the map. This is exact when there are
+  //! no concurrent modifications, and approximate otherwise.
+  size_type size() const noexcept { return size_.load(std::memory_order_relaxed); }
+
+  //! Returns whether the map is empty, with the same caveat as `size()`.
+  bool empty() const noexcept { return size() == 0; }
+
+  //! Reclaims the erased nodes whose grace period has elapsed. Thread safe.
+  //!
+  //! Nodes erased since the previous call are timestamped, so that they
+  //! can be reclaimed by a later call once the grace period has elapsed.
+  void purge() {
+    std::lock_guard<std::mutex> lock{retire_mutex_};
+    retired_.flush();
+    retired_.purge(purge_mode::opportunistic);
+  }
+
+private:
+  Compare compare_;
+  tower head_;
+  std::atomic<size_type> size_;
+  NodeAllocator node_allocator_;
+  // Nodes are allocated directly through `node_allocator_`, but retired
+  // through `retired_`. The deferred allocator is not thread safe, so
+  // writers serialize retirements, after unlocking the nodes.
+  std::mutex retire_mutex_;
+  deferred_reclamation_allocator<NodeAllocator> retired_;
+
+  // Returns whether the key of `n` is less than `key`.
+  bool before(node const* n, Key const& key) const { return compare_(n->value.first, key); }
+
+  // Returns whether `n` holds a key equivalent to `key`, assuming that it is
+  // not less than `key`.
+  bool matches(node const* n, Key const& key) const { return n != nullptr && !compare_(key, n->value.first); }
+
+  // Returns the first node, starting at `n`, that is fully linked and not
+  // erased, or null.
+  static node* first_live(node* n) {
+    while (n != nullptr && (n->marked.load(std::memory_order_acquire) ||
+                            !n->fully_linked.load(std::memory_order_acquire)))
+      n = n->next[0].load(std::memory_order_acquire);
+    return n;
+  }
+
+  // Finds the predecessors and successors of `key` at each level, and
+  // returns the highest level at which a node with key `key` was found, or
+  // -1 if there is none.
+  int find_path(Key const& key, tower* preds[], node* succs[]) const;
+
+  // Locks the distinct predecessors at levels `[0, levels)`, and validates
+  // that each of them is live and still links to the corresponding
+  // successor, which must be live too unless we are erasing it. On failure,
+  // everything is unlocked and false is returned.
+  static bool lock_and_validate(tower* preds[], node* succs[], std::size_t levels, bool erasing);
+
+  // Unlocks the distinct predecessors at levels `[0, levels)`.
+  static void unlock(tower* preds[], std::size_t levels);
+
+  static std::size_t random_height() {
+    std::size_t height = 1;
+    std::minstd_rand& random = detail::skiplist_random();
+    while (height < MaxHeight && (random() & 3) == 0)
+      ++height;
+    return height;
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Map implementation
+//////////////////////////////////////////////////////////////////////////////
+template <typename Key, typename T, typename Compare, typename Allocator, std::size_t MaxHeight>
+concurrent_skiplist_map<Key, T, Compare, Allocator, MaxHeight>::~concurrent_skiplist_map() {
+  // Nodes still in the map are destroyed right away, since nobody can be
+  // reading them anymore. Erased nodes are reclaimed by `retired_`.
+  using Traits = std::allocator_traits<NodeAllocator>;
+  node* n = head_.next[0].load(std::memory_order_relaxed);
+  while (n != nullptr) {
+    node* next = n->next[0].load(std::memory_order_relaxed);
+    Traits::destroy(node_allocator_, n);
+    Traits::deallocate(node_allocator_, n, 1);
+    n = next;
+  }
+}
+
+template <typename Key, typename T, typename Compare, typename Allocator, std::size_t MaxHeight>
+int concurrent_skiplist_map<Key, T, Compare, Allocator, MaxHeight>::find_path(Key const& key, tower* preds[], node* succs[]) const {
+  int found = -1;
+  tower* pred = const_cast<tower*>(&head_);
+  for (std::size_t level = MaxHeight; level-- != 0; ) {
+    node* curr = pred->next[level].load(std::memory_order_acquire);
+    while (curr != nullptr && before(curr, key)) {
+      pred = curr;
+      curr = curr->next[level].load(std::memory_order_acquire);
+    }
+    if (found == -1 && matches(curr, key))
+      found = static_cast<int>(level);
+    preds[level] = pred;
+    succs[level] = curr;
+  }
+  return found;
+}
+
+template <typename Key, typename T, typename Compare, typename Allocator, std::size_t MaxHeight>
+bool concurrent_skiplist_map<Key, T, Compare, Allocator, MaxHeight>::lock_and_validate(tower* preds[], node* succs[], std::size_t levels, bool erasing) {
+  tower* previous = nullptr;
+  for (std::size_t level = 0; level != levels; ++level) {
+    tower* pred = preds[level];
+    node* succ = succs[level];
+    if (pred != previous) {
+      pred->mutex.lock();
+      previous = pred;
+    }
+    bool const valid = !pred->marked.load(std::memory_order_relaxed) &&
+                       (erasing || succ == nullptr || !succ->marked.load(std::memory_order_acquire)) &&
+                       pred->next[level].load(std::memory_order_relaxed) == succ;
+    if (!valid) {
+      unlock(preds, level + 1);
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Key, typename T, typename Compare, typename Allocator, std::size_t MaxHeight>
+void concurrent_skiplist_map<Key, T, Compare, Allocator, MaxHeight>::unlock(tower* preds[], std::size_t levels) {
+  tower* previous = nullptr;
+  for (std::size_t level = 0; level != levels; ++level) {
+    if (preds[level] != previous) {
+      preds[level]->mutex.unlock();
+      previous = preds[level];
+    }
+  }
+}
+
+template <typename Key, typename T, typename Compare, typename Allocator, std::size_t MaxHeight>
+template <typename K, typename V>
+bool concurrent_skiplist_map<Key, T, Compare, Allocator, MaxHeight>::insert(K&& key, V&& value) {
+  using Traits = std::allocator_traits<NodeAllocator>;
+  // The node is created upfront, so that no allocation happens while nodes
+  // are locked. It is only published once it is linked at level 0.
+  node* const n = Traits::allocate(node_allocator_, 1);
+  try {
+    Traits::construct(node_allocator_, n, random_height(), std::forward<K>(key), std::forward<V>(value));
+  } catch (...) {
+    Traits::deallocate(node_allocator_, n, 1);
+    throw;
+  }
+  auto discard = [&] {
+    Traits::destroy(node_allocator_, n);
+    Traits::deallocate(node_allocator_, n, 1);
+  };
+
+  Key const& k = n->value.first;
+  std::size_t const height = n->height;
+  tower* preds[MaxHeight];
+  node* succs[MaxHeight];
+  while (true) {
+    int const found = find_path(k, preds, succs);
+    if (found != -1) {
+      node* existing = succs[found];
+      if (!existing->marked.load(std::memory_order_acquire)) {
+        // Wait for a concurrent insertion of the same key to complete, so
+        // that the element is visible when we return.
+        while (!existing->fully_linked.load(std::memory_order_acquire))
+          /* spin */;
+        discard();
+        return false;
+      }
+      // The existing node is being erased; wait for it to be unlinked.
+      continue;
+    }
+
+    if (!lock_and_validate(preds, succs, height, false))
+      continue;
+
+    for (std::size_t level = 0; level != height; ++level)
+      n->next[level].store(succs[level], std::memory_order_relaxed);
+    // Readers may see the node as soon as it is linked at level 0, but they
+    // ignore it until it is fully linked.
+    for (std::size_t level = 0; level != height; ++level)
+      preds[level]->next[level].store(n, std::memory_order_release);
+    n->fully_linked.store(true, std::memory_order_release);
+    unlock(preds, height);
+    size_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+}
+
+template <typename Key, typename T, typename Compare, typename Allocator, std::size_t MaxHeight>
+bool concurrent_skiplist_map<Key, T, Compare, Allocator, MaxHeight>::erase(Key const& key) {
+  tower* preds[MaxHeight];
+  node* succs[MaxHeight];
+  node* victim = nullptr;
+  while (true) {
+    int const found = find_path(key, preds, succs);
+    if (victim == nullptr) {
+      if (found == -1)
+        return false;
+      node* candidate = succs[found];
+      // Only erase nodes that are fully linked, and found at their top level
+      // (otherwise, we found a node that is still being inserted or erased).
+      if (!candidate->fully_linked.load(std::memory_order_acquire) ||
+          candidate->height != static_cast<std::size_t>(found) + 1 ||
+          candidate->marked.load(std::memory_order_acquire))
+        return false;
+
+      candidate->mutex.lock();
+      if (candidate->marked.load(std::memory_order_relaxed)) {
+        candidate->mutex.unlock();
+        return false;
+      }
+      candidate->marked.store(true, std::memory_order_release);
+      victim = candidate;
+    }
+
+    // Nodes can't be inserted right after the victim anymore, since it is
+    // marked, but its predecessors may have changed since we marked it.
+    std::size_t const height = victim->height;
+    bool valid = true;
+    for (std::size_t level = 0; level != height && valid; ++level)
+      valid = succs[level] == victim;
+    if (!valid || !lock_and_validate(preds, succs, height, true))
+      continue;
+
+    for (std::size_t level = height; level-- != 0; ) {
+      preds[level]->next[level].store(victim->next[level].load(std::memory_order_relaxed),
+                                      std::memory_order_release);
+    }
+    victim->mutex.unlock();
+    unlock(preds, height);
+    size_.fetch_sub(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock{retire_mutex_};
+    retired_.destroy(victim);
+    retired_.deallocate(victim, 1);
+    return true;
+  }
+}
+
+template <typename Key, typename T, typename Compare, typename Allocator, std::size_t MaxHeight>
+auto concurrent_skiplist_map<Key, T, Compare, Allocator, MaxHeight>::lower_bound(Key const& key) const -> const_iterator {
+  tower const* pred = &head_;
+  node* curr = nullptr;
+  for (std::size_t level = MaxHeight; level-- != 0; ) {
+    curr = pred->next[level].load(std::memory_order_acquire);
+    while (curr != nullptr && before(curr, key)) {
+      pred = curr;
+      curr = curr->next[level].load(std::memory_order_acquire);
+    }
+  }
+  return const_iterator{first_live(curr)};
+}
+
+template <typename Key, typename T, typename Compare, typename Allocator, std::size_t MaxHeight>
+auto concurrent_skiplist_map<Key, T, Compare, Allocator, MaxHeight>::find(Key const& key) const -> const_iterator {
+  const_iterator it = lower_bound(key);
+  if (it != end() && matches(it.node_, key))
+    return it;
+  return end();
+}
+
+} // end namespace amz
+
+#endif // include guard
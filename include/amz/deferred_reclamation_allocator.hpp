@@ -17,6 +17,7 @@
 #include <boost/intrusive/link_mode.hpp>
 #include <boost/intrusive/options.hpp>
 #include <boost/intrusive/slist.hpp>
+#include <boost/optional.hpp>
 
 #include <cassert>
 #include <chrono>
@@ -151,7 +152,7 @@ class deferred_reclamation_allocator {
   template <typename T>
   using alloc_rebind_t = typename AllocatorTraits::template rebind_alloc<T>;
   template <typename T>
-  using alloc_pointer_t = typename alloc_rebind_t<T>::pointer;
+  using alloc_pointer_t = typename std::allocator_traits<alloc_rebind_t<T>>::pointer;
 
 public:
   using pointer = typename AllocatorTraits::pointer;
@@ -161,6 +162,7 @@ public:
   using size_type = typename AllocatorTraits::size_type;
   using difference_type = typename AllocatorTraits::difference_type;
   using value_type = typename AllocatorTraits::value_type;
+  using time_point = std::chrono::steady_clock::time_point;
 
   template <typename T>
   struct rebind {
@@ -300,11 +302,12 @@ public:
   //! Constructs an object using the underlying allocator.
   //!
   //! All the arguments are simply forwarded to the underlying allocator's
-  //! `construct()` method.
+  //! `construct()` method (through `std::allocator_traits`, so allocators
+  //! that do not provide one are supported).
   template <typename ...Args>
   void construct(pointer p, Args&& ...args) {
     assert(!was_moved_from());
-    allocator_.construct(std::move(p), std::forward<Args>(args)...);
+    AllocatorTraits::construct(allocator_, std::addressof(*p), std::forward<Args>(args)...);
   }
 
   //! Does not do anything, since destruction is delayed until deallocation.
@@ -398,6 +401,7 @@ public:
     if (current_buffer_full()) {
       // 1. Timestamp and offload the current buffer.
       now_ = current_buffer_->timestamp = TimeoutClock::now();
+      current_buffer_->size = buffer_capacity_;
       delay_list_.push_back(*std::exchange(current_buffer_, nullptr)); // intrusive list; does not throw
 
       // 2. Try to reuse an existing buffer by purging the delay list.
@@ -532,7 +536,8 @@ public:
   //! This is because the _delay buffer_ is not timestamped until it is full,
   //! which means we would have no way to ensure that elements in the _delay
   //! buffer_ can be reclaimed other than waiting the full _timeout time_.
-  //! We don't do that.
+  //! We don't do that. Use `flush()` to timestamp a _delay buffer_ that is
+  //! not full, so that a later `purge()` can reclaim it.
   //!
   //! This method is `noexcept` exactly when destroying the `value_type` of
   //! this allocator is `noexcept`.
@@ -543,9 +548,9 @@ public:
       "'deferred_reclamation_allocator::purge' has two flavor: opportunistic and exhaustive. pick one.");
     assert(!was_moved_from());
 
-    auto const reclaim_full_buffer = [this](alloc_pointer_t<DelayBuffer> buffer) {
+    auto const reclaim_buffer = [this](alloc_pointer_t<DelayBuffer> buffer) {
       reclaim_buffer_elements(buffer->elements,
-                              buffer->elements + buffer_capacity_);
+                              buffer->elements + buffer->size);
       buffer_delete(buffer);
     };
 
@@ -555,12 +560,9 @@ public:
       auto& oldest = delay_list_.front();
 
       // If the oldest buffer can be purged, just do it and keep going.
-      // Note that a buffer must be full in order to make it to the delay list.
-      // Hence, we know that the buffers we manipulate below are always full,
-      // which means their size == their capacity.
       auto const ready_to_delete = oldest.timestamp + timeout_;
       if (now_ > ready_to_delete) {
-        delay_list_.pop_front_and_dispose(reclaim_full_buffer);
+        delay_list_.pop_front_and_dispose(reclaim_buffer);
       }
 
       // Otherwise, if the oldest buffer is still too young to be purged,
@@ -573,7 +575,7 @@ public:
       // (2) we're being exhaustive: wait for enough time to pass and try again
       else if (std::is_same<Flavor, detail::exhaustive_t>{}) {
         std::this_thread::sleep_until(ready_to_delete);
-        delay_list_.pop_front_and_dispose(reclaim_full_buffer);
+        delay_list_.pop_front_and_dispose(reclaim_buffer);
         // We know we slept until at least that time point, so we can use
         // this as our `now` to avoid calling `TimeoutClock::now()`.
         now_ = ready_to_delete;
@@ -585,6 +587,72 @@ public:
     }
   }
 
+  //! Timestamps the current _delay buffer_ and moves it to the _delay list_,
+  //! even if it is not full.
+  //!
+  //! Elements only make it to the _delay list_ when the _delay buffer_ fills
+  //! up, so after a burst of deallocations followed by a quiet period, the
+  //! last few elements would otherwise never be reclaimed. Once flushed, they
+  //! are reclaimed by the first `purge()` after their _timeout time_ has
+  //! elapsed, like any other element on the _delay list_.
+  //!
+  //! A new _delay buffer_ is needed to replace the flushed one. The allocator
+  //! first tries to purge the _delay list_ and reuse a buffer that is not
+  //! needed anymore, and otherwise allocates a new buffer with the underlying
+  //! allocator. If that allocation fails with `std::bad_alloc`, nothing is
+  //! flushed and `false` is returned. Flushing an empty _delay buffer_ does
+  //! nothing.
+  //!
+  //! @returns
+  //!        Whether the _delay buffer_ is now empty.
+  bool flush() {
+    assert(!was_moved_from());
+    if (current_buffer_empty()) {
+      return true;
+    }
+
+    now_ = TimeoutClock::now();
+    alloc_pointer_t<DelayBuffer> next = purge_delay_list_and_reuse_existing_buffer();
+    if (next == nullptr) {
+      try {
+        next = buffer_new();
+      } catch (std::bad_alloc const&) {
+        return false;
+      }
+    }
+
+    // All the elements of the buffer were deallocated before `now_`, so it
+    // is a conservative timestamp for all of them.
+    current_buffer_->timestamp = now_;
+    current_buffer_->size = current_buffer_size_;
+    delay_list_.push_back(*std::exchange(current_buffer_, next)); // intrusive list; does not throw
+    current_buffer_size_ = 0;
+    return true;
+  }
+
+  //! Returns the earliest time at which `purge()` will reclaim something, or
+  //! nothing if the _delay list_ is empty.
+  //!
+  //! This makes it possible to schedule purges exactly when they will make
+  //! progress (e.g. with a timer in an event loop, see `purge_timer`),
+  //! instead of polling. Elements in the current _delay buffer_ are not taken
+  //! into account until the buffer is full or flushed with `flush()`.
+  boost::optional<time_point> next_purge_deadline() const noexcept {
+    assert(!was_moved_from());
+    if (delay_list_.empty()) {
+      return boost::none;
+    }
+    // `purge()` only reclaims buffers strictly older than the timeout.
+    return delay_list_.front().timestamp + timeout_ + Duration{1};
+  }
+
+  //! Returns whether the current _delay buffer_ holds elements, which will
+  //! only be reclaimed once it is full or flushed with `flush()`.
+  bool has_unflushed_elements() const noexcept {
+    assert(!was_moved_from());
+    return !current_buffer_empty();
+  }
+
 private:
   template <typename>
   friend class deferred_reclamation_allocator;
@@ -627,6 +695,7 @@ private:
   {
     DelayBuffer() = default;
     TimePoint timestamp;
+    std::size_t size; // only meaningful once the buffer is on the delay list
     DelayBufferElement elements[];
   };
 
@@ -670,8 +739,7 @@ private:
   // allocator. The timestamp of the buffer is just default constructed (i.e.
   // not representing a meaningful value).
   alloc_pointer_t<DelayBuffer> buffer_new() {
-    std::size_t const buffer_element_bytes = buffer_capacity_ * sizeof(DelayBufferElement);
-    alloc_pointer_t<char> bytes = buffer_allocator_.allocate(sizeof(DelayBuffer) + buffer_element_bytes);
+    alloc_pointer_t<char> bytes = buffer_allocator_.allocate(buffer_bytes());
     assert(bytes != nullptr);
     return new (std::addressof(*bytes)) DelayBuffer{};
   }
@@ -683,7 +751,13 @@ private:
     assert(buffer != nullptr);
     buffer->~DelayBuffer();
     alloc_pointer_t<char> bytes = reinterpret_cast<char*>(std::addressof(*buffer));
-    buffer_allocator_.deallocate(bytes, buffer_capacity_);
+    buffer_allocator_.deallocate(bytes, buffer_bytes());
+  }
+
+  // Returns the number of bytes allocated for each buffer. The same size must
+  // be passed when deallocating a buffer, since some allocators rely on it.
+  std::size_t buffer_bytes() const noexcept {
+    return sizeof(DelayBuffer) + buffer_capacity_ * sizeof(DelayBufferElement);
   }
 
   alloc_pointer_t<DelayBuffer> purge_delay_list_and_reuse_existing_buffer() {
@@ -695,7 +769,7 @@ private:
         return reuse;
 
       // Otherwise, reclaim everything in the buffer and unlink it from the delay list.
-      reclaim_buffer_elements(oldest.elements, oldest.elements + buffer_capacity_);
+      reclaim_buffer_elements(oldest.elements, oldest.elements + oldest.size);
       delay_list_.pop_front(); // does not throw or invalidate references
 
       // If we haven't found a buffer to reuse yet, we keep this one for reuse.
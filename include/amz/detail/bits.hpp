@@ -0,0 +1,53 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_DETAIL_BITS_HPP
+#define AMZ_DETAIL_BITS_HPP
+
+#include <cassert>
+#include <cstdint>
+
+
+namespace amz {
+
+namespace detail {
+  // Returns the index of the least significant bit set in `word`, which must
+  // not be zero.
+  inline unsigned count_trailing_zeros(std::uint64_t word) noexcept {
+    assert(word != 0);
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(word));
+#else
+    unsigned n = 0;
+    for (; (word & 1) == 0; word >>= 1)
+      ++n;
+    return n;
+#endif
+  }
+
+  // Returns the number of bits set in `word`.
+  inline unsigned popcount(std::uint64_t word) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_popcountll(word));
+#else
+    unsigned n = 0;
+    for (; word != 0; word &= word - 1)
+      ++n;
+    return n;
+#endif
+  }
+} // end namespace detail
+
+} // end namespace amz
+
+#endif // include guard
@@ -0,0 +1,110 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_DETAIL_FILE_HPP
+#define AMZ_DETAIL_FILE_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <system_error>
+#include <utility>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+namespace amz {
+
+namespace detail {
+  [[noreturn]] inline void throw_errno(char const* what) {
+    throw std::system_error{errno, std::generic_category(), what};
+  }
+
+  // Owning wrapper around a POSIX file descriptor.
+  class unique_fd {
+  public:
+    unique_fd() noexcept : fd_{-1} { }
+    explicit unique_fd(int fd) noexcept : fd_{fd} { }
+    unique_fd(unique_fd&& other) noexcept : fd_{std::exchange(other.fd_, -1)} { }
+    unique_fd& operator=(unique_fd&& other) noexcept {
+      unique_fd{std::move(other)}.swap(*this);
+      return *this;
+    }
+    ~unique_fd() { if (fd_ != -1) ::close(fd_); }
+
+    void swap(unique_fd& other) noexcept { std::swap(fd_, other.fd_); }
+    int get() const noexcept { return fd_; }
+    explicit operator bool() const noexcept { return fd_ != -1; }
+
+  private:
+    int fd_;
+  };
+
+  // Owning wrapper around a shared memory mapping of a file.
+  class unique_mapping {
+  public:
+    unique_mapping() noexcept : data_{nullptr}, size_{0} { }
+    unique_mapping(int fd, std::size_t size, int prot) : unique_mapping{} {
+      if (size == 0)
+        return;
+      void* p = ::mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+      if (p == MAP_FAILED)
+        detail::throw_errno("mmap");
+      data_ = static_cast<char*>(p);
+      size_ = size;
+    }
+    unique_mapping(unique_mapping&& other) noexcept
+      : data_{std::exchange(other.data_, nullptr)}
+      , size_{std::exchange(other.size_, 0)}
+    { }
+    unique_mapping& operator=(unique_mapping&& other) noexcept {
+      unique_mapping{std::move(other)}.swap(*this);
+      return *this;
+    }
+    ~unique_mapping() { if (data_ != nullptr) ::munmap(data_, size_); }
+
+    void swap(unique_mapping& other) noexcept {
+      std::swap(data_, other.data_);
+      std::swap(size_, other.size_);
+    }
+    char* data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return size_; }
+
+  private:
+    char* data_;
+    std::size_t size_;
+  };
+
+  inline std::size_t page_size() noexcept {
+    return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  }
+
+  // Writes the whole buffer to the given file descriptor, retrying on
+  // partial writes and interruptions.
+  inline void write_all(int fd, char const* data, std::size_t size) {
+    while (size > 0) {
+      ::ssize_t const written = ::write(fd, data, size);
+      if (written < 0) {
+        if (errno == EINTR)
+          continue;
+        detail::throw_errno("write");
+      }
+      data += written;
+      size -= static_cast<std::size_t>(written);
+    }
+  }
+} // end namespace detail
+
+} // end namespace amz
+
+#endif // include guard
@@ -0,0 +1,208 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_MERGING_CONSUMER_HPP
+#define AMZ_MERGING_CONSUMER_HPP
+
+#include <amz/bounded_channel.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+
+namespace amz {
+
+//! Consumer merging several ordered channels into a single ordered stream.
+//!
+//! Each input channel is expected to receive its elements in increasing
+//! order according to `Compare` (e.g. events in timestamp order from a
+//! single producer). The merging consumer pops from all the inputs and
+//! returns their elements in increasing order overall, like the merge step
+//! of a merge sort.
+//!
+//! The next element can only be returned once the head of every input is
+//! known, since any input without a head could later receive a smaller
+//! element. Hence, popping blocks exactly when an input that is not closed
+//! is empty, and an input that is closed and drained no longer takes part
+//! in the merge. This bounds the latency of the merge by the slowest input,
+//! without buffering anything beyond the head of each input.
+//!
+//! The heads of the inputs are kept in a loser tree, so returning an element
+//! takes about `log2(N)` comparisons for `N` inputs, and only requires
+//! popping from the input the element came from.
+//!
+//! `Channel` must provide `pop()` and `try_pop()` into a
+//! `boost::optional<value_type>` with the same semantics as
+//! `bounded_channel`. The merging consumer is a single consumer: it is not
+//! thread safe, and the input channels must not be consumed by anyone else.
+//! The channels must outlive the merging consumer.
+template <typename Channel, typename Compare = std::less<typename Channel::value_type>>
+class merging_consumer {
+public:
+  using channel_type = Channel;
+  using value_type = typename Channel::value_type;
+
+  //! Creates a merging consumer over the given input channels, of which
+  //! there must be at least one.
+  explicit merging_consumer(std::vector<Channel*> inputs, Compare compare = Compare{});
+
+  merging_consumer(merging_consumer const&) = delete;
+  merging_consumer& operator=(merging_consumer const&) = delete;
+
+  //! Pops the smallest element among the heads of all the inputs.
+  //!
+  //! Blocks as long as an input that is not closed is empty. Returns
+  //! `success`, or `closed` once all the inputs are closed and drained.
+  template <typename Value>
+  channel_op_status pop(Value& va) { return this->pop_impl(va, true); }
+
+  //! Pops the smallest element among the heads of all the inputs, without
+  //! blocking.
+  //!
+  //! Returns `success`, `empty` if an input that is not closed can't provide
+  //! its head without blocking (because it is empty, or because it is paced
+  //! and out of tokens, see `bounded_channel::set_rate_limit()`), or `closed`
+  //! once all the inputs are closed and drained.
+  template <typename Value>
+  channel_op_status try_pop(Value& va) { return this->pop_impl(va, false); }
+
+  //! Returns the number of inputs of the merging consumer.
+  std::size_t input_count() const noexcept { return inputs_.size(); }
+
+private:
+  std::vector<Channel*> inputs_;
+  Compare compare_;
+  std::vector<boost::optional<value_type>> heads_;
+  std::vector<bool> closed_;   // whether each input is closed and drained
+  // `tree_[0]` is the input holding the smallest head, and `tree_[n]` for
+  // `n` in `[1, N)` is the input that lost the match at internal node `n`.
+  // The leaf of input `i` is the implicit node `N + i`.
+  std::vector<std::size_t> tree_;
+  bool built_;                 // whether the tree has been built
+  std::size_t consumed_;       // the input whose head was returned last, or N
+
+  template <typename Value>
+  channel_op_status pop_impl(Value& va, bool blocking);
+
+  // Makes sure that the head of input `i` is known, i.e. that it holds an
+  // element or is closed and drained. Returns whether that is the case.
+  bool fill(std::size_t i, bool blocking);
+
+  // Returns whether input `a` wins against input `b`, i.e. whether its head
+  // is smaller. Closed inputs lose against all the others.
+  bool wins(std::size_t a, std::size_t b) const {
+    if (closed_[a])
+      return false;
+    return closed_[b] || compare_(*heads_[a], *heads_[b]);
+  }
+
+  // Builds the tree from the heads of all the inputs.
+  void build();
+
+  // Replays the matches on the path from the leaf of input `i` to the root,
+  // after the head of that input has changed.
+  void replay(std::size_t i);
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Merging consumer implementation
+//////////////////////////////////////////////////////////////////////////////
+template <typename Channel, typename Compare>
+merging_consumer<Channel, Compare>::merging_consumer(std::vector<Channel*> inputs, Compare compare)
+  : inputs_{std::move(inputs)}
+  , compare_{std::move(compare)}
+  , heads_(inputs_.size())
+  , closed_(inputs_.size(), false)
+  , tree_(inputs_.size(), 0)
+  , built_{false}
+  , consumed_{inputs_.size()}
+{
+  assert(!inputs_.empty() && "a merging_consumer requires at least one input");
+}
+
+template <typename Channel, typename Compare>
+bool merging_consumer<Channel, Compare>::fill(std::size_t i, bool blocking) {
+  if (heads_[i] || closed_[i])
+    return true;
+  channel_op_status const status = blocking ? inputs_[i]->pop(heads_[i])
+                                            : inputs_[i]->try_pop(heads_[i]);
+  // Any status other than `success` and `closed` (e.g. `empty`, or `timeout`
+  // for a paced input) means that the head is not known yet.
+  if (status == channel_op_status::closed)
+    closed_[i] = true;
+  return status == channel_op_status::success || status == channel_op_status::closed;
+}
+
+template <typename Channel, typename Compare>
+void merging_consumer<Channel, Compare>::build() {
+  std::size_t const n = inputs_.size();
+  // `winners[node]` is the winner of the matches below `node`.
+  std::vector<std::size_t> winners(2 * n);
+  for (std::size_t i = 0; i != n; ++i)
+    winners[n + i] = i;
+  for (std::size_t node = n - 1; node >= 1; --node) {
+    std::size_t const left = winners[2 * node];
+    std::size_t const right = winners[2 * node + 1];
+    bool const left_wins = !wins(right, left);
+    winners[node] = left_wins ? left : right;
+    tree_[node] = left_wins ? right : left;
+  }
+  tree_[0] = winners[1];
+}
+
+template <typename Channel, typename Compare>
+void merging_consumer<Channel, Compare>::replay(std::size_t i) {
+  std::size_t winner = i;
+  for (std::size_t node = (inputs_.size() + i) / 2; node >= 1; node /= 2) {
+    if (wins(tree_[node], winner))
+      std::swap(tree_[node], winner);
+  }
+  tree_[0] = winner;
+}
+
+template <typename Channel, typename Compare>
+template <typename Value>
+channel_op_status merging_consumer<Channel, Compare>::pop_impl(Value& va, bool blocking) {
+  std::size_t const n = inputs_.size();
+  if (!built_) {
+    bool complete = true;
+    for (std::size_t i = 0; i != n; ++i)
+      complete = fill(i, blocking) && complete;
+    if (!complete)
+      return channel_op_status::empty;
+    build();
+    built_ = true;
+  } else if (consumed_ != n) {
+    if (!fill(consumed_, blocking))
+      return channel_op_status::empty;
+    replay(consumed_);
+    consumed_ = n;
+  }
+
+  std::size_t const winner = tree_[0];
+  if (closed_[winner])
+    return channel_op_status::closed;
+  va = std::move(*heads_[winner]);
+  heads_[winner] = boost::none;
+  consumed_ = winner;
+  return channel_op_status::success;
+}
+
+} // end namespace amz
+
+#endif // include guard
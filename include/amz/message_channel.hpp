@@ -0,0 +1,406 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_MESSAGE_CHANNEL_HPP
+#define AMZ_MESSAGE_CHANNEL_HPP
+
+#include <amz/bounded_channel.hpp>
+
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace amz {
+
+namespace detail {
+  template <typename T, typename ...Ts>
+  struct type_index;
+
+  template <typename T, typename ...Ts>
+  struct type_index<T, T, Ts...> : std::integral_constant<std::uint32_t, 0> { };
+
+  template <typename T, typename U, typename ...Ts>
+  struct type_index<T, U, Ts...>
+    : std::integral_constant<std::uint32_t, 1 + type_index<T, Ts...>::value>
+  { };
+
+  template <typename T>
+  struct type_index<T> {
+    static_assert(sizeof(T) == 0, "This type is not one of the message types of the channel.");
+  };
+
+  template <bool ...>
+  struct bool_pack;
+
+  template <bool ...Bs>
+  using all_of = std::is_same<bool_pack<true, Bs...>, bool_pack<Bs..., true>>;
+} // end namespace detail
+
+//! Multi-producer multi-consumer channel for messages of heterogeneous types.
+//!
+//! Messages of any of the types `Ts...` are constructed directly in a ring of
+//! bytes, each preceded by a small header holding its size and the index of
+//! its type in `Ts...`. Hence, pushing and popping messages never allocates,
+//! and messages of different sizes are packed densely, unlike with a channel
+//! of `std::unique_ptr`s or of variants.
+//!
+//! Consumers pop messages with a visitor, which is called with the message
+//! (as an rvalue of its actual type) after the message has been moved out of
+//! the ring and the lock on the channel has been released.
+//!
+//! The capacity of the channel is expressed in bytes. When there is not
+//! enough contiguous room for a message, pushing blocks (or fails, see
+//! `try_emplace()`) until consumers make room. Messages are always stored
+//! contiguously, so a message that does not fit before the end of the ring
+//! is stored at its beginning, and the space left at the end is wasted until
+//! it is consumed.
+//!
+//! Requirements
+//! ============
+//! The message types must be nothrow move constructible, and their alignment
+//! must not exceed the alignment of `std::max_align_t`. A message must fit in
+//! the ring, i.e. its size plus a few bytes of header and padding must not
+//! exceed the capacity.
+template <typename ...Ts>
+class message_channel {
+  static_assert(sizeof...(Ts) > 0, "A message_channel needs at least one message type.");
+  static_assert(detail::all_of<std::is_nothrow_move_constructible<Ts>::value...>::value,
+    "The message types of a message_channel must be nothrow move constructible.");
+  static_assert(detail::all_of<(alignof(Ts) <= alignof(std::max_align_t))...>::value,
+    "The message types of a message_channel may not be over-aligned.");
+
+public:
+  message_channel() = delete;
+
+  //! Creates a `message_channel` holding at most `capacity` bytes of messages
+  //! (including their headers), rounded up to a multiple of 8 bytes.
+  explicit message_channel(std::size_t capacity);
+
+  message_channel(message_channel const&) = delete;
+  message_channel(message_channel&&) = delete;
+  message_channel& operator=(message_channel const&) = delete;
+  message_channel& operator=(message_channel&&) = delete;
+
+  //! Deactivates the channel, preventing new messages from being pushed to
+  //! it. See `bounded_channel::close()`.
+  void close();
+
+  //! Closes the channel and destroys the messages left in it. See
+  //! `bounded_channel::~bounded_channel()`.
+  ~message_channel();
+
+  //! Constructs a message of type `Message` from `args...` in the channel,
+  //! possibly blocking if there is not enough room in the channel.
+  //!
+  //! - If the channel has been closed, returns `closed`.
+  //! - Otherwise, waits until there is enough room for the message (or the
+  //!   channel is closed), constructs the message, notifies at least one
+  //!   consumer and returns `success`.
+  //!
+  //! The message is constructed with the lock on the channel held. If the
+  //! constructor throws, the channel is left unchanged.
+  template <typename Message, typename ...Args>
+  channel_op_status emplace(Args&& ...args);
+
+  //! Equivalent to `emplace()`, but returns `full` instead of blocking.
+  template <typename Message, typename ...Args>
+  channel_op_status try_emplace(Args&& ...args);
+
+  //! Equivalent to `emplace<std::decay_t<Message>>(std::forward<Message>(m))`.
+  template <typename Message>
+  channel_op_status push(Message&& m) {
+    return this->emplace<std::decay_t<Message>>(std::forward<Message>(m));
+  }
+
+  //! Dequeues a message from the channel and calls `visitor` with it,
+  //! possibly blocking if the channel is empty.
+  //!
+  //! - If the channel is not empty, moves the oldest message out of the
+  //!   channel, notifies waiting producers, calls `visitor(std::move(m))`
+  //!   (without holding the lock) and returns `success`.
+  //! - If the channel is empty, waits until either a message is pushed (see
+  //!   above), or the channel is closed (returns `closed`).
+  template <typename Visitor>
+  channel_op_status pop(Visitor&& visitor);
+
+  //! Equivalent to `pop()`, but returns `empty` instead of blocking if the
+  //! channel is empty and has not been closed.
+  template <typename Visitor>
+  channel_op_status try_pop(Visitor&& visitor);
+
+private:
+  struct header {
+    std::uint32_t size; // size of the whole record, including the header
+    std::uint32_t type; // index in Ts..., or `padding_type`
+  };
+
+  static constexpr std::uint32_t padding_type = sizeof...(Ts);
+  // The capacity and the size of every record are multiples of the size of
+  // a header, so that the space left at the end of the ring can always hold
+  // a padding record.
+  static constexpr std::size_t unit = sizeof(header);
+  static_assert(sizeof(header) % alignof(header) == 0, "");
+
+  static constexpr std::size_t round_up(std::size_t n, std::size_t alignment) {
+    return (n + alignment - 1) / alignment * alignment;
+  }
+
+  // Offset of the message from the beginning of a record starting at `offset`
+  // in the ring. The ring itself is suitably aligned for any message type.
+  template <typename Message>
+  static constexpr std::size_t payload_offset(std::size_t offset) {
+    return round_up(offset + sizeof(header), alignof(Message)) - offset;
+  }
+
+  // Size of a record for a `Message` starting at `offset` in the ring.
+  template <typename Message>
+  static constexpr std::size_t record_size(std::size_t offset) {
+    return round_up(payload_offset<Message>(offset) + sizeof(Message), unit);
+  }
+
+  std::size_t const capacity_;
+  std::unique_ptr<char[]> ring_;
+  std::size_t head_; // offset of the oldest record
+  std::size_t tail_; // offset where the next record will be written
+  std::size_t used_; // bytes used by records, including padding records
+  std::mutex mutex_;
+  std::condition_variable consumers_; // notified when we push something new
+  std::condition_variable producers_; // notified when we pop something
+  bool closed_;
+
+  // Returns the offset at which a `Message` can be written, or `capacity_` if
+  // there is not enough room. If the returned offset is not `tail_`, the end
+  // of the ring must be skipped with a padding record (see `construct_at()`).
+  // WARNING -- not thread safe
+  template <typename Message>
+  std::size_t reserve();
+
+  // WARNING -- not thread safe
+  template <typename Message, typename ...Args>
+  void construct_at(std::size_t offset, Args&& ...args);
+
+  // Skips a padding record at the head of the ring, if any.
+  // WARNING -- not thread safe
+  void skip_padding();
+
+  // Frees the record at the head of the ring.
+  // WARNING -- not thread safe
+  void release_head(std::size_t size);
+
+  header& header_at(std::size_t offset) {
+    return *reinterpret_cast<header*>(ring_.get() + offset);
+  }
+
+  // Moves the message at the head of the ring out of it, releases the lock
+  // and calls the visitor on it. There is one such function per message type.
+  template <typename Message, typename Visitor>
+  static void dispatch(message_channel& self, std::unique_lock<std::mutex>& lock, Visitor& visitor) {
+    std::size_t const offset = self.head_;
+    header const h = self.header_at(offset);
+    Message* const stored = reinterpret_cast<Message*>(self.ring_.get() + offset + payload_offset<Message>(offset));
+    Message message{std::move(*stored)};
+    stored->~Message();
+    self.release_head(h.size);
+    lock.unlock();
+    self.producers_.notify_all();
+    visitor(std::move(message));
+  }
+
+  template <typename Message>
+  static void destroy(char* record, std::size_t offset) {
+    reinterpret_cast<Message*>(record + payload_offset<Message>(offset))->~Message();
+  }
+
+  template <typename Visitor>
+  void visit_head(std::unique_lock<std::mutex>& lock, Visitor& visitor) {
+    using Dispatch = void (*)(message_channel&, std::unique_lock<std::mutex>&, Visitor&);
+    static constexpr Dispatch table[] = {&message_channel::dispatch<Ts, Visitor>...};
+    table[header_at(head_).type](*this, lock, visitor);
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Channel implementation
+//////////////////////////////////////////////////////////////////////////////
+template <typename ...Ts>
+message_channel<Ts...>::message_channel(std::size_t capacity)
+  : capacity_{round_up(capacity, unit)}
+  , ring_{new char[round_up(capacity, unit)]}
+  , head_{0}
+  , tail_{0}
+  , used_{0}
+  , mutex_{}
+  , consumers_{}
+  , producers_{}
+  , closed_{false}
+{
+  assert(capacity > 0);
+  assert(capacity_ <= UINT32_MAX);
+}
+
+template <typename ...Ts>
+message_channel<Ts...>::~message_channel() {
+  close();
+  using Destroy = void (*)(char*, std::size_t);
+  static constexpr Destroy destroyers[] = {&message_channel::destroy<Ts>...};
+  while (used_ != 0) {
+    skip_padding();
+    header const h = header_at(head_);
+    destroyers[h.type](ring_.get() + head_, head_);
+    release_head(h.size);
+  }
+}
+
+template <typename ...Ts>
+void message_channel<Ts...>::close() {
+  {
+    std::unique_lock<std::mutex> lock{mutex_};
+    closed_ = true;
+  }
+  producers_.notify_all();
+  consumers_.notify_all();
+}
+
+template <typename ...Ts>
+template <typename Message>
+std::size_t message_channel<Ts...>::reserve() {
+  if (used_ == 0) {
+    head_ = tail_ = 0;
+  }
+
+  if (used_ == capacity_) {
+    return capacity_;
+  } else if (tail_ >= head_) {
+    // Free space is [tail_, capacity_) and [0, head_).
+    if (tail_ + record_size<Message>(tail_) <= capacity_) {
+      return tail_;
+    } else if (record_size<Message>(0) <= head_) {
+      return 0;
+    } else {
+      return capacity_;
+    }
+  } else {
+    // Free space is [tail_, head_).
+    return tail_ + record_size<Message>(tail_) <= head_ ? tail_ : capacity_;
+  }
+}
+
+template <typename ...Ts>
+template <typename Message, typename ...Args>
+void message_channel<Ts...>::construct_at(std::size_t offset, Args&& ...args) {
+  std::size_t const size = record_size<Message>(offset);
+  ::new (ring_.get() + offset + payload_offset<Message>(offset)) Message(std::forward<Args>(args)...);
+
+  // Only skip the end of the ring once the message has been constructed, so
+  // that the channel is left unchanged if the constructor throws.
+  if (offset != tail_) {
+    header& padding = header_at(tail_);
+    padding.size = static_cast<std::uint32_t>(capacity_ - tail_);
+    padding.type = padding_type;
+    used_ += padding.size;
+  }
+
+  header& h = header_at(offset);
+  h.size = static_cast<std::uint32_t>(size);
+  h.type = detail::type_index<Message, Ts...>::value;
+  used_ += size;
+  tail_ = offset + size == capacity_ ? 0 : offset + size;
+}
+
+template <typename ...Ts>
+template <typename Message, typename ...Args>
+channel_op_status message_channel<Ts...>::emplace(Args&& ...args) {
+  assert(record_size<Message>(0) <= capacity_ && "message too large for the channel");
+  std::unique_lock<std::mutex> lock{mutex_};
+  std::size_t offset = capacity_;
+  producers_.wait(lock, [&] {
+    return closed_ || (offset = this->reserve<Message>()) != capacity_;
+  });
+  if (closed_) {
+    return channel_op_status::closed;
+  }
+  construct_at<Message>(offset, std::forward<Args>(args)...);
+  lock.unlock();
+  consumers_.notify_one();
+  return channel_op_status::success;
+}
+
+template <typename ...Ts>
+template <typename Message, typename ...Args>
+channel_op_status message_channel<Ts...>::try_emplace(Args&& ...args) {
+  assert(record_size<Message>(0) <= capacity_ && "message too large for the channel");
+  std::unique_lock<std::mutex> lock{mutex_};
+  if (closed_) {
+    return channel_op_status::closed;
+  }
+  std::size_t const offset = reserve<Message>();
+  if (offset == capacity_) {
+    return channel_op_status::full;
+  }
+  construct_at<Message>(offset, std::forward<Args>(args)...);
+  lock.unlock();
+  consumers_.notify_one();
+  return channel_op_status::success;
+}
+
+template <typename ...Ts>
+void message_channel<Ts...>::skip_padding() {
+  if (used_ != 0 && header_at(head_).type == padding_type) {
+    release_head(header_at(head_).size);
+  }
+}
+
+template <typename ...Ts>
+void message_channel<Ts...>::release_head(std::size_t size) {
+  used_ -= size;
+  head_ += size;
+  if (head_ == capacity_)
+    head_ = 0;
+}
+
+template <typename ...Ts>
+template <typename Visitor>
+channel_op_status message_channel<Ts...>::pop(Visitor&& visitor) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  consumers_.wait(lock, [this] { return used_ != 0 || closed_; });
+  if (used_ == 0) {
+    assert(closed_);
+    return channel_op_status::closed;
+  }
+  skip_padding();
+  visit_head(lock, visitor);
+  return channel_op_status::success;
+}
+
+template <typename ...Ts>
+template <typename Visitor>
+channel_op_status message_channel<Ts...>::try_pop(Visitor&& visitor) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  if (used_ == 0) {
+    return closed_ ? channel_op_status::closed : channel_op_status::empty;
+  }
+  skip_padding();
+  visit_head(lock, visitor);
+  return channel_op_status::success;
+}
+
+} // end namespace amz
+
+#endif // include guard
@@ -0,0 +1,276 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_MPSC_QUEUE_HPP
+#define AMZ_MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+
+namespace amz {
+
+template <typename T>
+class mpsc_queue;
+
+//! Base class for objects that can be pushed to a `mpsc_queue`.
+//!
+//! Like Boost.Intrusive hooks, copying or assigning a hook does not copy its
+//! link, so deriving from this class does not prevent a type from being
+//! copyable.
+class mpsc_queue_hook {
+public:
+  mpsc_queue_hook() noexcept : next_{nullptr} { }
+  mpsc_queue_hook(mpsc_queue_hook const&) noexcept : next_{nullptr} { }
+  mpsc_queue_hook& operator=(mpsc_queue_hook const&) noexcept { return *this; }
+
+private:
+  template <typename>
+  friend class mpsc_queue;
+
+  std::atomic<mpsc_queue_hook*> next_;
+};
+
+//! Intrusive multi-producer single-consumer queue.
+//!
+//! This queue links nodes that were allocated by the user (objects of a type
+//! `T` deriving from `mpsc_queue_hook`), so pushing and popping never
+//! allocate. It is based on Dmitry Vyukov's intrusive MPSC node-based queue:
+//! - `push()` is wait-free, and costs a single atomic exchange (plus a load
+//!   to check whether the consumer is sleeping, see `pop_wait()`).
+//! - `try_pop()` is lock-free in the absence of preempted producers.
+//!
+//! Any number of threads may push to the queue concurrently, but only one
+//! thread at a time may consume from it (`try_pop()`, `pop_all()`,
+//! `pop_wait()` and `empty()` are consumer operations).
+//!
+//! Note on blocking producers
+//! ==========================
+//! A producer that has been preempted in the middle of `push()` (between
+//! its atomic exchange and linking its node) makes the nodes pushed after
+//! it invisible to the consumer until it resumes. In that window, `try_pop()`
+//! returns `nullptr` even though the queue is not empty. This is the price to
+//! pay for a wait-free `push()`, and it is usually not an issue for
+//! actor-style mailboxes, where the consumer keeps polling or waiting.
+//!
+//! Note on lifetime
+//! ================
+//! The queue does not own its nodes: a node must stay alive until it has
+//! been popped, and the queue must be empty when it is destroyed if the nodes
+//! are to be reclaimed.
+template <typename T>
+class mpsc_queue {
+  static_assert(std::is_base_of<mpsc_queue_hook, T>::value,
+    "The type of the nodes of a mpsc_queue must derive from mpsc_queue_hook.");
+
+public:
+  mpsc_queue() noexcept;
+
+  mpsc_queue(mpsc_queue const&) = delete;
+  mpsc_queue(mpsc_queue&&) = delete;
+  mpsc_queue& operator=(mpsc_queue const&) = delete;
+  mpsc_queue& operator=(mpsc_queue&&) = delete;
+
+  //! Pushes a node to the back of the queue. Can be called from any thread.
+  //!
+  //! The node must not currently be in a queue.
+  void push(T& node) noexcept;
+
+  //! Pops the node at the front of the queue and returns it, or returns
+  //! `nullptr` if no node is available (see the note on blocking producers).
+  //!
+  //! Consumer only.
+  T* try_pop() noexcept;
+
+  //! Pops all the nodes that are available, calling `f(node)` on each of them
+  //! in FIFO order, and returns the number of nodes that were popped.
+  //!
+  //! The nodes are detached as a batch: `pop_all()` takes a single snapshot
+  //! of the back of the queue and follows the links up to it, so each node
+  //! costs a single load. Only the last node of the batch requires pushing
+  //! the stub behind it, as in `try_pop()`. Nodes pushed while `pop_all()` is
+  //! running are not popped by it.
+  //!
+  //! Each node is unlinked from the queue before `f` is called on it, so `f`
+  //! may push it back to the queue or destroy it.
+  //!
+  //! Consumer only.
+  template <typename F>
+  std::size_t pop_all(F&& f);
+
+  //! Pops the node at the front of the queue, blocking if the queue is empty.
+  //!
+  //! The consumer first retries a few times before going to sleep, and
+  //! producers only pay for a notification when the consumer is actually
+  //! sleeping.
+  //!
+  //! Consumer only.
+  T& pop_wait();
+
+  //! Returns whether the queue is empty.
+  //!
+  //! A queue with a push in progress is not empty, even though `try_pop()`
+  //! might not be able to pop anything yet.
+  //!
+  //! Consumer only.
+  bool empty() const noexcept {
+    // `tail_` is either the next node to pop, or the stub. In the latter
+    // case, the queue is empty unless a node was pushed after the stub.
+    return tail_ == &stub_ && head_.load(std::memory_order_acquire) == &stub_;
+  }
+
+private:
+  static constexpr std::size_t cache_line = 64;
+  static constexpr unsigned spins_before_sleeping = 64;
+
+  // Written by producers.
+  std::atomic<mpsc_queue_hook*> head_;
+  char pad0_[cache_line - sizeof(std::atomic<mpsc_queue_hook*>)];
+
+  // Only accessed by the consumer.
+  mpsc_queue_hook* tail_;
+  mpsc_queue_hook stub_;
+  char pad1_[cache_line - sizeof(mpsc_queue_hook*) - sizeof(mpsc_queue_hook)];
+
+  // Used to put the consumer to sleep in `pop_wait()`.
+  std::atomic<bool> waiting_;
+  std::mutex mutex_;
+  std::condition_variable consumer_;
+
+  void link(mpsc_queue_hook* node) noexcept;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Queue implementation
+//////////////////////////////////////////////////////////////////////////////
+template <typename T>
+mpsc_queue<T>::mpsc_queue() noexcept
+  : head_{&stub_}
+  , tail_{&stub_}
+  , stub_{}
+  , waiting_{false}
+  , mutex_{}
+  , consumer_{}
+{ }
+
+template <typename T>
+void mpsc_queue<T>::link(mpsc_queue_hook* node) noexcept {
+  node->next_.store(nullptr, std::memory_order_relaxed);
+  // The exchange is sequentially consistent so that it can't be reordered
+  // with the load of `waiting_` in `push()`; see `pop_wait()`.
+  mpsc_queue_hook* const prev = head_.exchange(node, std::memory_order_seq_cst);
+  prev->next_.store(node, std::memory_order_release);
+}
+
+template <typename T>
+void mpsc_queue<T>::push(T& node) noexcept {
+  link(&node);
+  if (waiting_.load(std::memory_order_seq_cst)) {
+    { std::lock_guard<std::mutex> lock{mutex_}; }
+    consumer_.notify_one();
+  }
+}
+
+template <typename T>
+T* mpsc_queue<T>::try_pop() noexcept {
+  mpsc_queue_hook* tail = tail_;
+  mpsc_queue_hook* next = tail->next_.load(std::memory_order_acquire);
+  if (tail == &stub_) {
+    if (next == nullptr)
+      return nullptr;
+    tail_ = next;
+    tail = next;
+    next = next->next_.load(std::memory_order_acquire);
+  }
+
+  if (next != nullptr) {
+    tail_ = next;
+    return static_cast<T*>(tail);
+  }
+
+  // `tail` is the last linked node. If it is not the head, a producer is in
+  // the middle of pushing a node after it, and we can't pop `tail` before
+  // that node is linked.
+  if (tail != head_.load(std::memory_order_acquire))
+    return nullptr;
+
+  // Push the stub behind `tail`, so that `tail` can be popped.
+  link(&stub_);
+  next = tail->next_.load(std::memory_order_acquire);
+  if (next != nullptr) {
+    tail_ = next;
+    return static_cast<T*>(tail);
+  }
+  return nullptr;
+}
+
+template <typename T>
+template <typename F>
+std::size_t mpsc_queue<T>::pop_all(F&& f) {
+  std::size_t popped = 0;
+  mpsc_queue_hook* const last = head_.load(std::memory_order_acquire);
+
+  // Every node before `last` can be popped by following the links, without
+  // touching `head_`. We stop early if a producer has not linked its node
+  // yet (see the note on blocking producers).
+  while (tail_ != last) {
+    mpsc_queue_hook* const tail = tail_;
+    mpsc_queue_hook* const next = tail->next_.load(std::memory_order_acquire);
+    if (next == nullptr)
+      return popped;
+    tail_ = next;
+    if (tail != &stub_) {
+      ++popped;
+      f(*static_cast<T*>(tail));
+    }
+  }
+
+  // `last` can only be popped by pushing the stub behind it.
+  if (T* node = try_pop()) {
+    ++popped;
+    f(*node);
+  }
+  return popped;
+}
+
+template <typename T>
+T& mpsc_queue<T>::pop_wait() {
+  while (true) {
+    for (unsigned i = 0; i != spins_before_sleeping; ++i) {
+      if (T* node = try_pop())
+        return *node;
+      std::this_thread::yield();
+    }
+
+    // Announce that we are going to sleep, and then check again whether the
+    // queue is empty. Since both the store to `waiting_` and the exchange in
+    // `push()` are sequentially consistent, either we see the new node, or
+    // the producer sees `waiting_` and notifies us (under the mutex, so the
+    // notification can't happen before we are waiting).
+    std::unique_lock<std::mutex> lock{mutex_};
+    waiting_.store(true, std::memory_order_seq_cst);
+    consumer_.wait(lock, [this] {
+      return tail_ != &stub_ || head_.load(std::memory_order_seq_cst) != &stub_;
+    });
+    waiting_.store(false, std::memory_order_relaxed);
+  }
+}
+
+} // end namespace amz
+
+#endif // include guard
@@ -0,0 +1,355 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_NUMA_HPP
+#define AMZ_NUMA_HPP
+
+#include <amz/detail/file.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+namespace amz {
+
+namespace detail {
+  // The NUMA topology of the machine, as read from sysfs. On machines without
+  // NUMA support, this is a single node containing all the CPUs.
+  class numa_topology {
+  public:
+    static numa_topology const& get() {
+      static numa_topology const topology{};
+      return topology;
+    }
+
+    std::size_t node_count() const noexcept { return node_count_; }
+
+    // Returns the node of the given CPU, or 0 if it is unknown.
+    std::size_t node_of_cpu(int cpu) const noexcept {
+      if (cpu < 0 || static_cast<std::size_t>(cpu) >= cpu_to_node_.size())
+        return 0;
+      return cpu_to_node_[cpu];
+    }
+
+  private:
+    std::size_t node_count_;
+    std::vector<std::size_t> cpu_to_node_;
+
+    numa_topology() : node_count_{0}, cpu_to_node_{} {
+      // Node numbers are dense on all the machines we care about.
+      while (true) {
+        std::ifstream cpulist{"/sys/devices/system/node/node" + std::to_string(node_count_) + "/cpulist"};
+        if (!cpulist)
+          break;
+        std::string ranges;
+        std::getline(cpulist, ranges);
+        assign_cpus(ranges, node_count_);
+        ++node_count_;
+      }
+      node_count_ = std::max<std::size_t>(node_count_, 1);
+    }
+
+    // Parses a CPU list such as "0-3,8-11" and assigns those CPUs to `node`.
+    void assign_cpus(std::string const& ranges, std::size_t node) {
+      std::size_t pos = 0;
+      while (pos < ranges.size()) {
+        std::size_t const end = std::min(ranges.find(',', pos), ranges.size());
+        std::string const range = ranges.substr(pos, end - pos);
+        std::size_t const dash = range.find('-');
+        try {
+          std::size_t const first = std::stoul(range.substr(0, dash));
+          std::size_t const last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+          if (cpu_to_node_.size() <= last)
+            cpu_to_node_.resize(last + 1, 0);
+          std::fill(cpu_to_node_.begin() + first, cpu_to_node_.begin() + last + 1, node);
+        } catch (std::exception const&) {
+          // Ignore malformed ranges; their CPUs are reported on node 0.
+        }
+        pos = end + 1;
+      }
+    }
+  };
+
+  // Asks the kernel to place the pages of the given range on `node`, falling
+  // back to other nodes when it is out of memory. This must be done before
+  // the pages are first touched. Placement is best effort: errors (e.g. on a
+  // kernel without NUMA support) are ignored, and the pages are then placed
+  // as usual.
+  inline void numa_bind(void* p, std::size_t size, std::size_t node) noexcept {
+    constexpr int mpol_preferred = 1; // MPOL_PREFERRED, from <numaif.h>
+    constexpr std::size_t bits = sizeof(unsigned long) * CHAR_BIT;
+    std::vector<unsigned long> mask(node / bits + 1, 0);
+    mask[node / bits] = 1ul << (node % bits);
+    // The kernel reads one bit less than `maxnode`.
+    ::syscall(SYS_mbind, p, size, mpol_preferred, mask.data(), mask.size() * bits + 1, 0u);
+  }
+
+  // Maps `size` bytes of anonymous memory placed on `node`.
+  inline void* numa_map(std::size_t size, std::size_t node) {
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+      throw std::bad_alloc{};
+    detail::numa_bind(p, size, node);
+    return p;
+  }
+} // end namespace detail
+
+//! Returns the number of NUMA nodes of the machine, which is 1 on machines
+//! without NUMA support.
+inline std::size_t numa_node_count() {
+  return detail::numa_topology::get().node_count();
+}
+
+//! Returns the NUMA node of the CPU the calling thread is running on.
+//!
+//! Unless the thread is pinned to the CPUs of a node, it may have migrated
+//! to another node by the time this function returns, so this is only a hint.
+inline std::size_t current_numa_node() {
+  return detail::numa_topology::get().node_of_cpu(::sched_getcpu());
+}
+
+//! Memory resource whose memory is placed on a given NUMA node.
+//!
+//! Memory is obtained from the operating system in slabs of `slab_size`
+//! bytes, which are bound to the node before being touched. Allocations of up
+//! to `max_small_size` bytes are rounded up to a power of two and carved out
+//! of those slabs, and freed blocks are kept in per-size free lists for
+//! later allocations; that memory is never returned to the operating system.
+//! Larger allocations are mapped and unmapped individually.
+//!
+//! This is meant for long-lived data structures used by the threads of a
+//! node, such as the storage of a channel, and not as a general purpose
+//! allocator: every operation takes a lock on the resource. There is a
+//! single resource per node, obtained with `for_node()`.
+//!
+//! Note on placement
+//! =================
+//! Placement is best effort. Memory is bound to its node with the `mbind`
+//! system call in "preferred" mode, so allocations still succeed when the
+//! node is out of memory, and they behave like regular memory on machines
+//! (or kernels) without NUMA support.
+class numa_memory_resource {
+public:
+  static constexpr std::size_t slab_size = 1 << 20;
+  static constexpr std::size_t max_small_size = 1 << 16;
+
+  //! Returns the memory resource of the given node, which must be smaller
+  //! than `numa_node_count()`.
+  static numa_memory_resource& for_node(std::size_t node);
+
+  numa_memory_resource(numa_memory_resource const&) = delete;
+  numa_memory_resource(numa_memory_resource&&) = delete;
+  numa_memory_resource& operator=(numa_memory_resource const&) = delete;
+  numa_memory_resource& operator=(numa_memory_resource&&) = delete;
+
+  //! Returns the node on which the memory of this resource is placed.
+  std::size_t node() const noexcept { return node_; }
+
+  //! Allocates `size` bytes aligned to `alignment`, which must be a power of
+  //! two no larger than the size of a page. Throws `std::bad_alloc` if the
+  //! memory can't be obtained.
+  void* allocate(std::size_t size, std::size_t alignment = alignof(std::max_align_t));
+
+  //! Deallocates memory obtained from `allocate()` on this resource, with the
+  //! same size and alignment.
+  void deallocate(void* p, std::size_t size, std::size_t alignment = alignof(std::max_align_t)) noexcept;
+
+private:
+  static constexpr std::size_t min_small_size = 16;
+  static constexpr std::size_t size_classes = 13; // from 16 bytes to 64 KiB
+
+  struct free_block {
+    free_block* next;
+  };
+
+  explicit numa_memory_resource(std::size_t node)
+    : node_{node}
+    , mutex_{}
+    , free_lists_{}
+    , slab_{nullptr}
+    , slab_end_{nullptr}
+  { }
+
+  // Returns the size class of allocations of `size` bytes with the given
+  // alignment, which is `size_classes` for allocations that are not small.
+  static std::size_t size_class(std::size_t size, std::size_t alignment) noexcept {
+    std::size_t const rounded = std::max({size, alignment, min_small_size});
+    std::size_t c = 0;
+    for (std::size_t s = min_small_size; s < rounded && c != size_classes; s *= 2)
+      ++c;
+    return c;
+  }
+
+  // Returns the size of the mapping used for a large allocation.
+  static std::size_t large_size(std::size_t size) noexcept {
+    std::size_t const page = detail::page_size();
+    return (size + page - 1) / page * page;
+  }
+
+  // Carves a block of the given size class out of the current slab, mapping
+  // a new slab if needed. Blocks are aligned to their size (up to a page),
+  // so they can be reused for any alignment allowed by their size class.
+  // WARNING -- must be called with the lock held
+  void* carve(std::size_t c);
+
+  std::size_t const node_;
+  std::mutex mutex_;
+  free_block* free_lists_[size_classes];
+  char* slab_;
+  char* slab_end_;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Memory resource implementation
+//////////////////////////////////////////////////////////////////////////////
+constexpr std::size_t numa_memory_resource::slab_size;
+constexpr std::size_t numa_memory_resource::max_small_size;
+constexpr std::size_t numa_memory_resource::min_small_size;
+constexpr std::size_t numa_memory_resource::size_classes;
+
+inline numa_memory_resource& numa_memory_resource::for_node(std::size_t node) {
+  assert(node < numa_node_count());
+  // The resources are leaked on purpose, so that the memory they handed out
+  // remains valid until the very end of the program, including in the
+  // destructors of static objects.
+  static std::vector<numa_memory_resource*> const resources = [] {
+    std::vector<numa_memory_resource*> r;
+    for (std::size_t n = 0; n != numa_node_count(); ++n)
+      r.push_back(new numa_memory_resource{n});
+    return r;
+  }();
+  return *resources[node];
+}
+
+inline void* numa_memory_resource::allocate(std::size_t size, std::size_t alignment) {
+  assert(alignment != 0 && (alignment & (alignment - 1)) == 0 && alignment <= detail::page_size());
+  std::size_t const c = size_class(size, alignment);
+  if (c == size_classes)
+    return detail::numa_map(large_size(size), node_);
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (free_block* block = free_lists_[c]) {
+    free_lists_[c] = block->next;
+    return block;
+  }
+  return carve(c);
+}
+
+inline void numa_memory_resource::deallocate(void* p, std::size_t size, std::size_t alignment) noexcept {
+  std::size_t const c = size_class(size, alignment);
+  if (c == size_classes) {
+    ::munmap(p, large_size(size));
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  free_block* block = static_cast<free_block*>(p);
+  block->next = free_lists_[c];
+  free_lists_[c] = block;
+}
+
+inline void* numa_memory_resource::carve(std::size_t c) {
+  std::size_t const block_size = min_small_size << c;
+  std::size_t const alignment = std::min(block_size, detail::page_size());
+  auto aligned = [=](char* p) {
+    std::uintptr_t const address = reinterpret_cast<std::uintptr_t>(p);
+    return p + ((alignment - address % alignment) % alignment);
+  };
+
+  char* block = aligned(slab_);
+  if (slab_ == nullptr || slab_end_ - block < static_cast<std::ptrdiff_t>(block_size)) {
+    // The rest of the current slab, if any, is wasted.
+    slab_ = static_cast<char*>(detail::numa_map(slab_size, node_));
+    slab_end_ = slab_ + slab_size;
+    block = slab_;
+  }
+  slab_ = block + block_size;
+  return block;
+}
+
+//! Allocator whose memory is placed on a given NUMA node.
+//!
+//! This allocator obtains its memory from the `numa_memory_resource` of its
+//! node. It is typically used for the container of a channel, so that the
+//! elements of the channel live on the node of the threads using it:
+//!
+//! ```
+//! using Container = std::deque<T, amz::numa_allocator<T>>;
+//! amz::bounded_channel<T, Container> channel{capacity, Container(amz::numa_allocator<T>{node})};
+//! ```
+//!
+//! Allocators compare equal when they allocate on the same node.
+template <typename T>
+class numa_allocator {
+public:
+  using value_type = T;
+
+  //! Creates an allocator placing its memory on the given node.
+  explicit numa_allocator(std::size_t node)
+    : resource_{&numa_memory_resource::for_node(node)}
+  { }
+
+  template <typename U>
+  numa_allocator(numa_allocator<U> const& other) noexcept
+    : resource_{&other.resource()}
+  { }
+
+  //! Allocates storage for `n` objects of type `T`.
+  T* allocate(std::size_t n) {
+    if (n > std::size_t(-1) / sizeof(T))
+      throw std::bad_alloc{};
+    return static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  //! Deallocates storage obtained from `allocate(n)` on an allocator that
+  //! compares equal to this one.
+  void deallocate(T* p, std::size_t n) noexcept {
+    resource_->deallocate(p, n * sizeof(T), alignof(T));
+  }
+
+  //! Returns the node on which this allocator places its memory.
+  std::size_t node() const noexcept { return resource_->node(); }
+
+  //! Returns the memory resource used by this allocator.
+  numa_memory_resource& resource() const noexcept { return *resource_; }
+
+  template <typename U>
+  friend bool operator==(numa_allocator const& a, numa_allocator<U> const& b) noexcept
+  { return &a.resource() == &b.resource(); }
+
+  template <typename U>
+  friend bool operator!=(numa_allocator const& a, numa_allocator<U> const& b) noexcept
+  { return !(a == b); }
+
+private:
+  numa_memory_resource* resource_;
+};
+
+} // end namespace amz
+
+#endif // include guard
@@ -0,0 +1,315 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_NUMA_SHARDED_CHANNEL_HPP
+#define AMZ_NUMA_SHARDED_CHANNEL_HPP
+
+#include <amz/bounded_channel.hpp>
+#include <amz/numa.hpp>
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+
+namespace amz {
+
+//! Multi-producer multi-consumer channel made of one `bounded_channel` per
+//! NUMA node, which keeps handoffs between threads of the same node local to
+//! that node.
+//!
+//! Each shard of the channel is associated to a node: both the shard itself
+//! (its lock and condition variables) and the storage of its elements are
+//! placed on the memory of that node (see `numa_allocator`). Producers push
+//! to the shard of the node they are running on, and consumers pop from the
+//! shard of their node, so that elements cross sockets only when needed:
+//!
+//! - When the local shard is full, a producer tries the other shards, those
+//!   of the same node first, before blocking on the local shard.
+//! - When the local shard is empty, a consumer tries to steal from the other
+//!   shards, those of the same node first. If they are all empty, it waits on
+//!   the local shard for up to `steal_interval` before trying again, so an
+//!   element pushed to a remote shard without local consumers is picked up
+//!   with a latency of at most `steal_interval`.
+//!
+//! The channel is closed when all its shards are closed, and a popping
+//! operation only returns `closed` once all the shards are closed and empty.
+//! The order of elements is only preserved within a shard.
+//!
+//! Threads are expected to be pinned to the CPUs of a node: the local shard
+//! is determined from the CPU the thread is running on at the time of the
+//! operation (see `current_numa_node()`). The `_to` and `_from` variants of
+//! the operations take an explicit shard instead.
+template <typename T>
+class numa_sharded_channel {
+public:
+  using value_type = T;
+  using container_type = std::deque<T, numa_allocator<T>>;
+  using shard_type = bounded_channel<T, container_type>;
+
+  //! Creates a channel with one shard per node of the machine, each shard
+  //! holding up to `shard_capacity` elements.
+  explicit numa_sharded_channel(std::size_t shard_capacity,
+                                std::chrono::microseconds steal_interval = std::chrono::milliseconds{1});
+
+  //! Creates a channel with one shard for each of the given nodes, which
+  //! must be smaller than `numa_node_count()`. A node may appear several
+  //! times; the local shard of a thread is then the first shard of its node.
+  numa_sharded_channel(std::size_t shard_capacity, std::vector<std::size_t> const& nodes,
+                       std::chrono::microseconds steal_interval = std::chrono::milliseconds{1});
+
+  numa_sharded_channel(numa_sharded_channel const&) = delete;
+  numa_sharded_channel(numa_sharded_channel&&) = delete;
+  numa_sharded_channel& operator=(numa_sharded_channel const&) = delete;
+  numa_sharded_channel& operator=(numa_sharded_channel&&) = delete;
+
+  //! Closes all the shards of the channel. See `bounded_channel::close()`.
+  void close();
+
+  //! Returns the number of shards of the channel.
+  std::size_t shard_count() const noexcept { return shards_.size(); }
+
+  //! Returns the shard associated to the node of the calling thread. If no
+  //! shard is associated to that node, shards are assigned round-robin.
+  std::size_t local_shard() const { return node_to_shard_[current_numa_node()]; }
+
+  //! Returns the node of the given shard.
+  std::size_t node_of(std::size_t shard) const { return nodes_[shard]; }
+
+  //! Returns the approximate number of elements in the channel.
+  std::size_t size() const noexcept;
+
+  //! Pushes a value to the local shard, or to another shard if it is full.
+  //!
+  //! Returns `closed` if the channel has been closed. If all the shards that
+  //! are not closed are full, blocks until the local shard has room for the
+  //! value (see `bounded_channel::push()`).
+  channel_op_status push(value_type const& va) { return this->push_to(local_shard(), va); }
+  channel_op_status push(value_type&& va)      { return this->push_to(local_shard(), std::move(va)); }
+
+  //! Same as `push()`, but using the given shard as the local shard.
+  channel_op_status push_to(std::size_t shard, value_type const& va) { return this->push_impl(shard, va); }
+  channel_op_status push_to(std::size_t shard, value_type&& va)      { return this->push_impl(shard, std::move(va)); }
+
+  //! Pushes a value to the local shard, or to another shard if it is full,
+  //! without blocking. Returns `success`, `full` if all the shards that are
+  //! not closed are full, or `closed` if the channel has been closed.
+  channel_op_status try_push(value_type const& va) { return this->try_push_to(local_shard(), va); }
+  channel_op_status try_push(value_type&& va)      { return this->try_push_to(local_shard(), std::move(va)); }
+
+  //! Same as `try_push()`, but using the given shard as the local shard.
+  channel_op_status try_push_to(std::size_t shard, value_type const& va) { return this->try_push_impl(shard, va).first; }
+  channel_op_status try_push_to(std::size_t shard, value_type&& va)      { return this->try_push_impl(shard, std::move(va)).first; }
+
+  //! Pops a value from the local shard, or steals one from another shard if
+  //! it is empty, blocking until a value is available.
+  //!
+  //! Returns `success`, or `closed` if the channel is closed and empty.
+  template <typename Value>
+  channel_op_status pop(Value& va) { return this->pop_from(local_shard(), va); }
+
+  //! Same as `pop()`, but using the given shard as the local shard.
+  template <typename Value>
+  channel_op_status pop_from(std::size_t shard, Value& va);
+
+  //! Pops a value from the local shard, or steals one from another shard if
+  //! it is empty, without blocking. Returns `success`, `empty`, or `closed`
+  //! if the channel is closed and empty.
+  template <typename Value>
+  channel_op_status try_pop(Value& va) { return this->try_pop_from(local_shard(), va); }
+
+  //! Same as `try_pop()`, but using the given shard as the local shard.
+  template <typename Value>
+  channel_op_status try_pop_from(std::size_t shard, Value& va);
+
+private:
+  // Destroys a shard and returns its memory to the resource of its node.
+  struct shard_deleter {
+    numa_memory_resource* resource;
+    void operator()(shard_type* shard) const noexcept {
+      shard->~shard_type();
+      resource->deallocate(shard, sizeof(shard_type), alignof(shard_type));
+    }
+  };
+
+  std::vector<std::size_t> nodes_;
+  std::vector<std::unique_ptr<shard_type, shard_deleter>> shards_;
+  // For each shard, the order in which to visit the shards when it is full or
+  // empty: the shard itself, then the other shards of the same node, and then
+  // the shards of other nodes.
+  std::vector<std::vector<std::size_t>> visit_order_;
+  std::vector<std::size_t> node_to_shard_;
+  std::chrono::microseconds const steal_interval_;
+
+  template <typename Value>
+  channel_op_status push_impl(std::size_t shard, Value&& va);
+
+  // Returns the status of the operation, and on failure a shard that was full
+  // if any, or `shard` otherwise.
+  template <typename Value>
+  std::pair<channel_op_status, std::size_t> try_push_impl(std::size_t shard, Value&& va);
+
+  // Returns the status of the operation, and when it is `empty`, the closest
+  // shard that is not closed.
+  template <typename Value>
+  std::pair<channel_op_status, std::size_t> try_pop_impl(std::size_t shard, Value& va);
+
+  static std::vector<std::size_t> all_nodes() {
+    std::vector<std::size_t> nodes;
+    for (std::size_t n = 0; n != numa_node_count(); ++n)
+      nodes.push_back(n);
+    return nodes;
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Channel implementation
+//////////////////////////////////////////////////////////////////////////////
+template <typename T>
+numa_sharded_channel<T>::numa_sharded_channel(std::size_t shard_capacity, std::chrono::microseconds steal_interval)
+  : numa_sharded_channel{shard_capacity, all_nodes(), steal_interval}
+{ }
+
+template <typename T>
+numa_sharded_channel<T>::numa_sharded_channel(std::size_t shard_capacity, std::vector<std::size_t> const& nodes,
+                                              std::chrono::microseconds steal_interval)
+  : nodes_{nodes}
+  , shards_{}
+  , visit_order_{}
+  , node_to_shard_(numa_node_count())
+  , steal_interval_{steal_interval}
+{
+  assert(!nodes_.empty() && "a numa_sharded_channel requires at least one shard");
+  std::size_t const n = nodes_.size();
+
+  // Each shard is itself placed on its node, since its lock and condition
+  // variables are written by every operation. Reserving first ensures the
+  // shard can't leak if `emplace_back()` fails.
+  shards_.reserve(n);
+  for (std::size_t node : nodes_) {
+    assert(node < numa_node_count());
+    numa_allocator<T> allocator{node};
+    numa_memory_resource& resource = allocator.resource();
+    void* p = resource.allocate(sizeof(shard_type), alignof(shard_type));
+    try {
+      shards_.emplace_back(::new (p) shard_type{shard_capacity, container_type(allocator)}, shard_deleter{&resource});
+    } catch (...) {
+      resource.deallocate(p, sizeof(shard_type), alignof(shard_type));
+      throw;
+    }
+  }
+
+  for (std::size_t i = 0; i != n; ++i) {
+    std::vector<std::size_t> order{i};
+    for (std::size_t k = 1; k != n; ++k)
+      if (nodes_[(i + k) % n] == nodes_[i])
+        order.push_back((i + k) % n);
+    for (std::size_t k = 1; k != n; ++k)
+      if (nodes_[(i + k) % n] != nodes_[i])
+        order.push_back((i + k) % n);
+    visit_order_.push_back(std::move(order));
+  }
+
+  for (std::size_t node = 0; node != node_to_shard_.size(); ++node)
+    node_to_shard_[node] = node % n;
+  for (std::size_t i = n; i-- != 0; )
+    node_to_shard_[nodes_[i]] = i;
+}
+
+template <typename T>
+void numa_sharded_channel<T>::close() {
+  for (auto& shard : shards_)
+    shard->close();
+}
+
+template <typename T>
+std::size_t numa_sharded_channel<T>::size() const noexcept {
+  std::size_t size = 0;
+  for (auto const& shard : shards_)
+    size += shard->size();
+  return size;
+}
+
+template <typename T>
+template <typename Value>
+std::pair<channel_op_status, std::size_t> numa_sharded_channel<T>::try_push_impl(std::size_t shard, Value&& va) {
+  assert(shard < shard_count());
+  std::size_t full = shard_count();
+  for (std::size_t i : visit_order_[shard]) {
+    channel_op_status const status = shards_[i]->try_push(std::forward<Value>(va));
+    if (status == channel_op_status::success)
+      return std::make_pair(status, i);
+    if (status == channel_op_status::full && full == shard_count())
+      full = i;
+  }
+  if (full == shard_count())
+    return std::make_pair(channel_op_status::closed, shard);
+  return std::make_pair(channel_op_status::full, full);
+}
+
+template <typename T>
+template <typename Value>
+channel_op_status numa_sharded_channel<T>::push_impl(std::size_t shard, Value&& va) {
+  std::pair<channel_op_status, std::size_t> const result = try_push_impl(shard, std::forward<Value>(va));
+  if (result.first != channel_op_status::full)
+    return result.first;
+  // Wait on the closest shard that is full.
+  return shards_[result.second]->push(std::forward<Value>(va));
+}
+
+template <typename T>
+template <typename Value>
+channel_op_status numa_sharded_channel<T>::try_pop_from(std::size_t shard, Value& va) {
+  return this->try_pop_impl(shard, va).first;
+}
+
+template <typename T>
+template <typename Value>
+std::pair<channel_op_status, std::size_t> numa_sharded_channel<T>::try_pop_impl(std::size_t shard, Value& va) {
+  assert(shard < shard_count());
+  std::size_t open = shard_count();
+  for (std::size_t i : visit_order_[shard]) {
+    channel_op_status const status = shards_[i]->try_pop(va);
+    if (status == channel_op_status::success)
+      return std::make_pair(status, i);
+    // Anything but `closed` means that the shard may still provide elements.
+    if (status != channel_op_status::closed && open == shard_count())
+      open = i;
+  }
+  if (open == shard_count())
+    return std::make_pair(channel_op_status::closed, shard);
+  return std::make_pair(channel_op_status::empty, open);
+}
+
+template <typename T>
+template <typename Value>
+channel_op_status numa_sharded_channel<T>::pop_from(std::size_t shard, Value& va) {
+  while (true) {
+    std::pair<channel_op_status, std::size_t> const result = try_pop_impl(shard, va);
+    if (result.first != channel_op_status::empty)
+      return result.first;
+    // Wait on the closest shard that is still open, which is the local shard
+    // unless it has been closed, and then look at all the shards again.
+    if (shards_[result.second]->try_pop_for(steal_interval_, va) == channel_op_status::success)
+      return channel_op_status::success;
+  }
+}
+
+} // end namespace amz
+
+#endif // include guard
@@ -0,0 +1,362 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_PARTITIONED_CHANNEL_HPP
+#define AMZ_PARTITIONED_CHANNEL_HPP
+
+#include <amz/bounded_channel.hpp>
+
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+
+namespace amz {
+
+//! Multi-producer multi-consumer channel preserving the order of elements
+//! with the same key, even across consumers.
+//!
+//! Elements are pushed along with a key, and the key is hashed to select one
+//! of a fixed number of partitions. Each partition is a FIFO queue owned by
+//! one consumer at a time, and the channel guarantees that the elements of a
+//! partition are processed one at a time and in order. Hence, all the
+//! elements with the same key (e.g. all the events of a session) are
+//! processed in the order in which they were pushed, without consumers having
+//! to synchronize with each other.
+//!
+//! Consumers are identified by an index in `[0, consumers)`, and each index
+//! must be used by at most one thread at a time. A consumer is considered to
+//! be processing the last element it popped until it calls a popping
+//! operation again (or `release()`). In the meantime, no other element from
+//! the same partition is handed out.
+//!
+//! Rebalancing
+//! ===========
+//! Partitions are initially spread evenly across consumers. When a consumer
+//! has nothing to do, it takes over a non-empty partition owned by another
+//! consumer, provided that no element of that partition is being processed
+//! (which is what makes it safe). Ownership is sticky, so a partition keeps
+//! being served by the same consumer as long as that consumer keeps up.
+//!
+//! Capacity and closing
+//! ====================
+//! The capacity is shared by all partitions: pushing blocks when the total
+//! number of elements in the channel reaches the capacity, regardless of the
+//! partition. Like for `bounded_channel`, closing the channel prevents new
+//! elements from being pushed, and consumers can drain the channel before
+//! being told it is closed.
+//!
+//! Note on performance
+//! ===================
+//! The channel is protected by a single lock, and popping operations scan
+//! the partitions, so the number of partitions should stay reasonably small
+//! (typically a small multiple of the number of consumers).
+template <typename T, typename Key, typename Hash = std::hash<Key>>
+class partitioned_channel {
+public:
+  using value_type = T;
+  using key_type = Key;
+
+  partitioned_channel() = delete;
+
+  //! Creates a `partitioned_channel` with the given total capacity, number
+  //! of partitions and number of consumers.
+  partitioned_channel(std::size_t capacity, std::size_t partitions,
+                      std::size_t consumers, Hash hash = Hash{});
+
+  partitioned_channel(partitioned_channel const&) = delete;
+  partitioned_channel(partitioned_channel&&) = delete;
+  partitioned_channel& operator=(partitioned_channel const&) = delete;
+  partitioned_channel& operator=(partitioned_channel&&) = delete;
+
+  //! Deactivates the channel, preventing new elements from being pushed to
+  //! it. See `bounded_channel::close()`.
+  void close();
+
+  //! Closes the channel. See `bounded_channel::~bounded_channel()`.
+  ~partitioned_channel() { close(); }
+
+  //! Pushes a new value into the partition associated to `key`, possibly
+  //! blocking if the channel is full.
+  //!
+  //! - If the channel has been closed, returns `closed`.
+  //! - Otherwise, waits until the channel is not full or closed, enqueues the
+  //!   value, wakes up a consumer that can process it and returns `success`.
+  channel_op_status push(key_type const& key, value_type const& va) { return this->push_impl(key, va); }
+  channel_op_status push(key_type const& key, value_type&& va)      { return this->push_impl(key, std::move(va)); }
+
+  //! Dequeues an element for the given consumer, possibly blocking if there
+  //! is nothing that consumer can process.
+  //!
+  //! This first marks the element previously popped by `consumer` as
+  //! processed. Then:
+  //! - If an element can be processed by `consumer`, dequeues it into `va`
+  //!   and returns `success`. Partitions owned by `consumer` are served
+  //!   first, and other partitions may be taken over (see rebalancing).
+  //! - If the channel is closed and empty, returns `closed`.
+  //! - Otherwise, waits until one of the above happens.
+  template <typename Value, typename =
+    std::enable_if_t<std::is_assignable<Value&, value_type&&>::value>
+  >
+  channel_op_status pop(std::size_t consumer, Value& va);
+
+  //! Equivalent to `pop()`, but returns `empty` instead of blocking.
+  template <typename Value, typename =
+    std::enable_if_t<std::is_assignable<Value&, value_type&&>::value>
+  >
+  channel_op_status try_pop(std::size_t consumer, Value& va);
+
+  //! Marks the element last popped by `consumer` as processed, without
+  //! popping a new one. This should be called by a consumer that stops
+  //! consuming, so that its partitions can be taken over.
+  void release(std::size_t consumer);
+
+private:
+  static constexpr std::size_t none = static_cast<std::size_t>(-1);
+
+  struct partition {
+    std::deque<T> queue;
+    std::size_t owner;
+    bool in_flight; // whether an element of this partition is being processed
+  };
+
+  struct consumer_state {
+    std::condition_variable cv;
+    std::size_t current = none; // partition of the element being processed
+    std::size_t cursor = 0;     // where to start looking for work
+    bool waiting = false;
+  };
+
+  std::size_t const capacity_;
+  Hash hash_;
+  std::mutex mutex_;
+  std::condition_variable producers_;
+  std::unique_ptr<partition[]> partitions_;
+  std::size_t const partition_count_;
+  std::unique_ptr<consumer_state[]> consumers_;
+  std::size_t const consumer_count_;
+  std::size_t size_;
+  bool closed_;
+
+  template <typename Value>
+  channel_op_status push_impl(key_type const& key, Value&& va);
+
+  // Tries dequeuing an element that `consumer` can process, and returns
+  // whether it succeeded.
+  // WARNING -- not thread safe
+  template <typename Value>
+  bool try_take(std::size_t consumer, Value& va);
+
+  // Returns the index of a partition with an element that can be processed,
+  // preferring the ones owned by `consumer`, or `none`.
+  // WARNING -- not thread safe
+  std::size_t find_ready_partition(std::size_t consumer) const;
+
+  // WARNING -- not thread safe
+  void release_locked(std::size_t consumer);
+
+  // Wakes up a waiting consumer that can process an element of partition
+  // `p`, preferring its owner.
+  // WARNING -- not thread safe
+  void wake_consumer_for(std::size_t p);
+
+  // WARNING -- not thread safe
+  bool is_ready(std::size_t p) const {
+    return !partitions_[p].in_flight && !partitions_[p].queue.empty();
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Channel implementation
+//////////////////////////////////////////////////////////////////////////////
+template <typename T, typename Key, typename Hash>
+partitioned_channel<T, Key, Hash>::partitioned_channel(std::size_t capacity, std::size_t partitions,
+                                                       std::size_t consumers, Hash hash)
+  : capacity_{capacity}
+  , hash_{std::move(hash)}
+  , mutex_{}
+  , producers_{}
+  , partitions_{new partition[partitions]}
+  , partition_count_{partitions}
+  , consumers_{new consumer_state[consumers]}
+  , consumer_count_{consumers}
+  , size_{0}
+  , closed_{false}
+{
+  assert(partitions > 0 && consumers > 0);
+  for (std::size_t p = 0; p != partitions; ++p) {
+    partitions_[p].owner = p % consumers;
+    partitions_[p].in_flight = false;
+  }
+  for (std::size_t c = 0; c != consumers; ++c) {
+    consumers_[c].cursor = c % partitions;
+  }
+}
+
+template <typename T, typename Key, typename Hash>
+void partitioned_channel<T, Key, Hash>::close() {
+  {
+    std::unique_lock<std::mutex> lock{mutex_};
+    closed_ = true;
+  }
+  producers_.notify_all();
+  for (std::size_t c = 0; c != consumer_count_; ++c)
+    consumers_[c].cv.notify_all();
+}
+
+template <typename T, typename Key, typename Hash>
+template <typename Value>
+channel_op_status partitioned_channel<T, Key, Hash>::push_impl(key_type const& key, Value&& va) {
+  std::size_t const p = hash_(key) % partition_count_;
+  std::unique_lock<std::mutex> lock{mutex_};
+  producers_.wait(lock, [this] { return closed_ || size_ < capacity_; });
+  if (closed_) {
+    return channel_op_status::closed;
+  }
+  partitions_[p].queue.push_back(std::forward<Value>(va));
+  ++size_;
+  if (!partitions_[p].in_flight)
+    wake_consumer_for(p);
+  return channel_op_status::success;
+}
+
+template <typename T, typename Key, typename Hash>
+void partitioned_channel<T, Key, Hash>::wake_consumer_for(std::size_t p) {
+  std::size_t const owner = partitions_[p].owner;
+  if (consumers_[owner].waiting) {
+    consumers_[owner].cv.notify_one();
+    return;
+  }
+  // The owner is busy, so any idle consumer may take the partition over.
+  for (std::size_t c = 0; c != consumer_count_; ++c) {
+    if (consumers_[c].waiting) {
+      consumers_[c].cv.notify_one();
+      return;
+    }
+  }
+}
+
+template <typename T, typename Key, typename Hash>
+std::size_t partitioned_channel<T, Key, Hash>::find_ready_partition(std::size_t consumer) const {
+  std::size_t const start = consumers_[consumer].cursor;
+  std::size_t stolen = none;
+  for (std::size_t i = 0; i != partition_count_; ++i) {
+    std::size_t const p = (start + i) % partition_count_;
+    if (!is_ready(p))
+      continue;
+    if (partitions_[p].owner == consumer)
+      return p;
+    // Only take a partition over if its owner can't serve it right now.
+    if (stolen == none && !consumers_[partitions_[p].owner].waiting)
+      stolen = p;
+  }
+  return stolen;
+}
+
+template <typename T, typename Key, typename Hash>
+template <typename Value>
+bool partitioned_channel<T, Key, Hash>::try_take(std::size_t consumer, Value& va) {
+  std::size_t const p = find_ready_partition(consumer);
+  if (p == none)
+    return false;
+
+  partition& part = partitions_[p];
+  va = std::move(part.queue.front());
+  part.queue.pop_front();
+  part.owner = consumer;
+  part.in_flight = true;
+  consumers_[consumer].current = p;
+  consumers_[consumer].cursor = (p + 1) % partition_count_;
+  --size_;
+
+  // Now that we're busy, another idle consumer may be able to take over our
+  // other partitions.
+  if (closed_ && size_ == 0) {
+    for (std::size_t c = 0; c != consumer_count_; ++c)
+      consumers_[c].cv.notify_all();
+  } else {
+    for (std::size_t q = 0; q != partition_count_; ++q) {
+      if (partitions_[q].owner == consumer && is_ready(q)) {
+        wake_consumer_for(q);
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+template <typename T, typename Key, typename Hash>
+void partitioned_channel<T, Key, Hash>::release_locked(std::size_t consumer) {
+  std::size_t const p = consumers_[consumer].current;
+  if (p != none) {
+    partitions_[p].in_flight = false;
+    consumers_[consumer].current = none;
+  }
+}
+
+template <typename T, typename Key, typename Hash>
+void partitioned_channel<T, Key, Hash>::release(std::size_t consumer) {
+  assert(consumer < consumer_count_);
+  std::unique_lock<std::mutex> lock{mutex_};
+  std::size_t const p = consumers_[consumer].current;
+  release_locked(consumer);
+  if (p != none && is_ready(p))
+    wake_consumer_for(p);
+}
+
+template <typename T, typename Key, typename Hash>
+template <typename Value, typename>
+channel_op_status partitioned_channel<T, Key, Hash>::pop(std::size_t consumer, Value& va) {
+  assert(consumer < consumer_count_);
+  std::unique_lock<std::mutex> lock{mutex_};
+  release_locked(consumer);
+  consumer_state& self = consumers_[consumer];
+  while (!try_take(consumer, va)) {
+    if (closed_ && size_ == 0) {
+      return channel_op_status::closed;
+    }
+    self.waiting = true;
+    self.cv.wait(lock);
+    self.waiting = false;
+  }
+  lock.unlock();
+  producers_.notify_one();
+  return channel_op_status::success;
+}
+
+template <typename T, typename Key, typename Hash>
+template <typename Value, typename>
+channel_op_status partitioned_channel<T, Key, Hash>::try_pop(std::size_t consumer, Value& va) {
+  assert(consumer < consumer_count_);
+  std::unique_lock<std::mutex> lock{mutex_};
+  release_locked(consumer);
+  if (try_take(consumer, va)) {
+    lock.unlock();
+    producers_.notify_one();
+    return channel_op_status::success;
+  } else if (closed_ && size_ == 0) {
+    return channel_op_status::closed;
+  } else {
+    return channel_op_status::empty;
+  }
+}
+
+} // end namespace amz
+
+#endif // include guard
@@ -0,0 +1,280 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_POOL_ALLOCATOR_HPP
+#define AMZ_POOL_ALLOCATOR_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace amz {
+
+namespace detail {
+  // A block of memory that is not currently allocated. Free blocks are linked
+  // through their first bytes.
+  struct pool_free_block {
+    pool_free_block* next;
+  };
+
+  // A list of free blocks, along with its length.
+  struct pool_free_list {
+    pool_free_block* head = nullptr;
+    std::size_t size = 0;
+
+    void push(void* p) noexcept {
+      pool_free_block* block = static_cast<pool_free_block*>(p);
+      block->next = head;
+      head = block;
+      ++size;
+    }
+
+    void* pop() noexcept {
+      assert(head != nullptr);
+      pool_free_block* block = head;
+      head = block->next;
+      --size;
+      return block;
+    }
+
+    // Removes the first `n` blocks from this list and returns them as a
+    // separate list. The behavior is undefined if `n` is 0 or larger than
+    // the size of the list.
+    pool_free_list split(std::size_t n) noexcept {
+      assert(n != 0 && n <= size);
+      pool_free_list front;
+      front.head = head;
+      front.size = n;
+      pool_free_block* last = head;
+      for (std::size_t i = 1; i != n; ++i)
+        last = last->next;
+      head = last->next;
+      size -= n;
+      last->next = nullptr;
+      return front;
+    }
+  };
+
+  // Process-wide pool of blocks of `BlockSize` bytes aligned on `Alignment`.
+  //
+  // Blocks are carved out of large slabs, and they move between the central
+  // pool and the per-thread caches in batches of `batch_size` blocks, so the
+  // central lock is only taken once every `batch_size` allocations (or
+  // deallocations) on a given thread.
+  template <std::size_t BlockSize, std::size_t Alignment>
+  class pool {
+  public:
+    static constexpr std::size_t block_size = BlockSize;
+    static constexpr std::size_t batch_size = std::max<std::size_t>(4096 / BlockSize, 16);
+    static constexpr std::size_t blocks_per_slab = std::max<std::size_t>(65536 / BlockSize, batch_size);
+
+    static void* allocate() {
+      pool_free_list* cache = thread_cache::get();
+      if (cache == nullptr) {
+        // The cache of this thread is gone, so go to the central pool directly.
+        pool_free_list batch = central::get().take();
+        void* p = batch.pop();
+        if (batch.size != 0)
+          central::get().give(batch);
+        return p;
+      }
+      if (cache->head == nullptr)
+        *cache = central::get().take();
+      return cache->pop();
+    }
+
+    static void deallocate(void* p) noexcept {
+      pool_free_list* cache = thread_cache::get();
+      if (cache == nullptr) {
+        pool_free_list batch;
+        batch.push(p);
+        central::get().give(batch);
+        return;
+      }
+      cache->push(p);
+      // Keep at most two batches around, so that a thread alternating between
+      // allocations and deallocations around a batch boundary does not keep
+      // going to the central pool.
+      if (cache->size >= 2 * batch_size)
+        central::get().give(cache->split(batch_size));
+    }
+
+  private:
+    // The central pool is never destroyed, since blocks may be deallocated
+    // during static destruction (or from threads exiting late). Slabs are
+    // never returned to the system.
+    class central {
+    public:
+      static central& get() {
+        static central* instance = new central;
+        return *instance;
+      }
+
+      pool_free_list take() {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (batches_.empty())
+          carve_slab();
+        pool_free_list batch = batches_.back();
+        batches_.pop_back();
+        return batch;
+      }
+
+      void give(pool_free_list batch) {
+        std::lock_guard<std::mutex> lock{mutex_};
+        batches_.push_back(batch);
+      }
+
+    private:
+      // Allocates a new slab and pushes its blocks as batches on the central
+      // free list. Must be called with the lock held.
+      void carve_slab() {
+        static_assert(Alignment <= alignof(std::max_align_t),
+          "amz::pool_allocator does not support over-aligned types");
+        char* slab = static_cast<char*>(::operator new(blocks_per_slab * block_size));
+        batches_.reserve(batches_.size() + blocks_per_slab / batch_size + 1);
+        pool_free_list batch;
+        // Push blocks from the end of the slab, so that blocks are handed out
+        // in address order.
+        for (std::size_t i = blocks_per_slab; i != 0; --i) {
+          batch.push(slab + (i - 1) * block_size);
+          if (batch.size == batch_size) {
+            batches_.push_back(batch);
+            batch = pool_free_list{};
+          }
+        }
+        if (batch.size != 0)
+          batches_.push_back(batch);
+      }
+
+      std::mutex mutex_;
+      std::vector<pool_free_list> batches_;
+    };
+
+    // The blocks cached by the current thread. They are handed back to the
+    // central pool when the thread exits.
+    //
+    // Blocks may still be allocated or deallocated after the cache has been
+    // destroyed (e.g. by other thread-local objects, or during static
+    // destruction on the main thread). A destroyed thread-local object is
+    // never constructed again, so `get()` returns null in that case, and the
+    // caller must go to the central pool directly.
+    struct thread_cache {
+      pool_free_list blocks;
+
+      static pool_free_list* get() {
+        if (destroyed())
+          return nullptr;
+        static thread_local thread_cache cache;
+        return &cache.blocks;
+      }
+
+      ~thread_cache() {
+        destroyed() = true;
+        if (blocks.size != 0)
+          central::get().give(blocks);
+      }
+
+    private:
+      // Trivially destructible, so it can be read at any time during the
+      // lifetime of the thread.
+      static bool& destroyed() noexcept {
+        static thread_local bool flag = false;
+        return flag;
+      }
+    };
+  };
+
+  template <std::size_t BlockSize, std::size_t Alignment>
+  constexpr std::size_t pool<BlockSize, Alignment>::block_size;
+  template <std::size_t BlockSize, std::size_t Alignment>
+  constexpr std::size_t pool<BlockSize, Alignment>::batch_size;
+  template <std::size_t BlockSize, std::size_t Alignment>
+  constexpr std::size_t pool<BlockSize, Alignment>::blocks_per_slab;
+} // end namespace detail
+
+//! Allocator handing out fixed-size blocks from a process-wide pool, with
+//! per-thread caches.
+//!
+//! Single-object allocations (`allocate(1)`) are served from a pool of blocks
+//! of `sizeof(T)` bytes (rounded up to hold a pointer). Each thread keeps a
+//! cache of free blocks, so that allocating and deallocating is usually just
+//! popping and pushing on a thread-local free list. Blocks move between the
+//! thread caches and a central pool in batches, which means that blocks freed
+//! by a thread other than the one that allocated them (e.g. nodes handed over
+//! through a queue) are returned to the central pool in bulk, and that the
+//! central lock is rarely contended.
+//!
+//! Allocations of more than one object are forwarded to `::operator new`.
+//! This makes it possible to use this allocator with containers that
+//! allocate arrays in addition to nodes, and as the underlying allocator of
+//! `deferred_reclamation_allocator`.
+//!
+//! All `pool_allocator`s are stateless and compare equal: memory allocated
+//! with one of them can be deallocated with any other, from any thread. Types
+//! with the same size and alignment share the same pool. Memory is kept in
+//! the pool once it has been freed, and it is never returned to the system.
+template <typename T>
+class pool_allocator {
+  static constexpr std::size_t alignment = std::max(alignof(T), alignof(detail::pool_free_block));
+  static constexpr std::size_t block_size =
+    (std::max(sizeof(T), sizeof(detail::pool_free_block)) + alignment - 1) / alignment * alignment;
+  using Pool = detail::pool<block_size, alignment>;
+
+public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using is_always_equal = std::true_type;
+
+  pool_allocator() = default;
+
+  template <typename U>
+  pool_allocator(pool_allocator<U> const&) noexcept { }
+
+  //! Allocates storage for `n` objects of type `T`.
+  //!
+  //! When `n == 1`, the storage is taken from the pool. Otherwise, it is
+  //! allocated with `::operator new`, and `std::bad_array_new_length` is
+  //! thrown if `n * sizeof(T)` overflows.
+  T* allocate(std::size_t n) {
+    if (n == 1)
+      return static_cast<T*>(Pool::allocate());
+    if (n > std::size_t(-1) / sizeof(T))
+      throw std::bad_array_new_length{};
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  //! Deallocates storage obtained from `allocate(n)` on any `pool_allocator`
+  //! of the same type. This may be called from any thread.
+  void deallocate(T* p, std::size_t n) noexcept {
+    if (n == 1)
+      Pool::deallocate(p);
+    else
+      ::operator delete(p);
+  }
+
+  friend bool operator==(pool_allocator const&, pool_allocator const&) noexcept
+  { return true; }
+
+  friend bool operator!=(pool_allocator const&, pool_allocator const&) noexcept
+  { return false; }
+};
+
+} // end namespace amz
+
+#endif // include guard
@@ -0,0 +1,161 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_PURGE_TIMER_HPP
+#define AMZ_PURGE_TIMER_HPP
+
+#include <amz/deferred_reclamation_allocator.hpp>
+#include <amz/detail/file.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+
+#include <boost/optional.hpp>
+
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+
+namespace amz {
+
+//! Linux timer firing when purging a `deferred_reclamation_allocator` would
+//! make progress, for use in event loops.
+//!
+//! The timer is a `timerfd`, whose file descriptor becomes readable when it
+//! fires; it can be watched with `epoll` or `poll` along with the other file
+//! descriptors of an event loop. The intended usage is as follows:
+//!
+//! ```c++
+//! amz::purge_timer<Allocator> timer{allocator, std::chrono::milliseconds{100}};
+//! // register timer.fd() for reading in the event loop
+//!
+//! // after deallocating through the allocator:
+//! timer.arm();
+//!
+//! // when timer.fd() is readable:
+//! timer.handle();
+//! ```
+//!
+//! `handle()` purges the allocator, flushes its _delay buffer_ if it holds
+//! elements, and rearms the timer for the next time a purge will make
+//! progress (see `deferred_reclamation_allocator::next_purge_deadline()`),
+//! or leaves it disarmed when there is nothing left to reclaim. Hence, memory
+//! is reclaimed shortly after its _timeout time_ without polling, and
+//! elements that are stuck in a partially filled _delay buffer_ are flushed
+//! within `flush_delay` of the call to `arm()` (or on the next purge, if it
+//! comes first).
+//!
+//! Note on clocks
+//! ==============
+//! The allocator's deadlines are `std::chrono::steady_clock` time points,
+//! which are converted to absolute `CLOCK_MONOTONIC` times for the timer.
+//! This relies on `steady_clock` being implemented with `CLOCK_MONOTONIC`,
+//! which is the case with libstdc++ and libc++ on Linux.
+//!
+//! Like the allocator, the timer is not thread safe, and the allocator must
+//! outlive it.
+template <typename DeferredAllocator>
+class purge_timer {
+public:
+  using time_point = std::chrono::steady_clock::time_point;
+
+  //! Creates a disarmed timer for the given allocator.
+  //!
+  //! Throws `std::system_error` if the timer can't be created.
+  template <typename Rep, typename Period>
+  purge_timer(DeferredAllocator& allocator, std::chrono::duration<Rep, Period> flush_delay)
+    : allocator_{allocator}
+    , flush_delay_{std::chrono::duration_cast<std::chrono::steady_clock::duration>(flush_delay)}
+    , fd_{::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)}
+    , deadline_{}
+  {
+    if (!fd_)
+      detail::throw_errno("timerfd_create");
+  }
+
+  purge_timer(purge_timer const&) = delete;
+  purge_timer& operator=(purge_timer const&) = delete;
+
+  //! Returns the file descriptor of the timer, which becomes readable when
+  //! the timer fires.
+  int fd() const noexcept { return fd_.get(); }
+
+  //! Returns the time at which the timer will fire, or nothing if it is
+  //! disarmed.
+  boost::optional<time_point> deadline() const noexcept { return deadline_; }
+
+  //! Arms the timer so that it fires when the allocator has something to
+  //! reclaim, or moves its deadline earlier if needed. This should be called
+  //! after deallocating through the allocator. The timer is only reset when
+  //! its deadline moves earlier, so calling this repeatedly is cheap.
+  void arm() {
+    boost::optional<time_point> deadline = allocator_.next_purge_deadline();
+    if (allocator_.has_unflushed_elements()) {
+      time_point const flush_time = std::chrono::steady_clock::now() + flush_delay_;
+      deadline = deadline ? std::min(*deadline, flush_time) : flush_time;
+    }
+    if (deadline && (!deadline_ || *deadline < *deadline_))
+      set(deadline);
+  }
+
+  //! Purges the allocator, flushes its _delay buffer_, and rearms the timer
+  //! for the next purge that will make progress. This should be called when
+  //! the file descriptor of the timer is readable, but calling it at any
+  //! other time is harmless.
+  void handle() {
+    std::uint64_t expirations;
+    if (::read(fd_.get(), &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+      detail::throw_errno("read");
+
+    allocator_.purge(purge_mode::opportunistic);
+    bool const flushed = allocator_.flush();
+
+    boost::optional<time_point> deadline = allocator_.next_purge_deadline();
+    if (!flushed) {
+      // We ran out of memory for a new delay buffer: try again later.
+      time_point const retry = std::chrono::steady_clock::now() + flush_delay_;
+      deadline = deadline ? std::min(*deadline, retry) : retry;
+    }
+    set(deadline);
+  }
+
+private:
+  DeferredAllocator& allocator_;
+  std::chrono::steady_clock::duration const flush_delay_;
+  detail::unique_fd fd_;
+  boost::optional<time_point> deadline_; // when the timer fires, if armed
+
+  // Arms the timer at the given absolute time, or disarms it.
+  void set(boost::optional<time_point> deadline) {
+    ::itimerspec spec{};
+    if (deadline) {
+      auto const since_epoch = deadline->time_since_epoch();
+      auto const seconds = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+      spec.it_value.tv_sec = static_cast<time_t>(seconds.count());
+      spec.it_value.tv_nsec = static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch - seconds).count());
+      // A zero value would disarm the timer.
+      if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+        spec.it_value.tv_nsec = 1;
+    }
+    if (::timerfd_settime(fd_.get(), TFD_TIMER_ABSTIME, &spec, nullptr) != 0)
+      detail::throw_errno("timerfd_settime");
+    deadline_ = deadline;
+  }
+};
+
+} // end namespace amz
+
+#endif // include guard
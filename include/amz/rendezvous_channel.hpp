@@ -0,0 +1,266 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_RENDEZVOUS_CHANNEL_HPP
+#define AMZ_RENDEZVOUS_CHANNEL_HPP
+
+#include <amz/bounded_channel.hpp>
+
+#include <cassert>
+#include <condition_variable>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include <boost/intrusive/list.hpp>
+#include <boost/optional.hpp>
+
+
+namespace amz {
+
+//! Multi-producer multi-consumer channel without any buffer, where each
+//! element is handed directly from a producer to a consumer.
+//!
+//! Pushing an element blocks until a consumer takes it, and popping blocks
+//! until a producer provides an element. This is the equivalent of a
+//! `bounded_channel` with a capacity of zero (which `bounded_channel` can't
+//! represent), and it provides the tightest possible backpressure between
+//! producers and consumers.
+//!
+//! Threads waiting on the channel are queued in FIFO order, and each of them
+//! waits on its own condition variable: the element is transferred directly
+//! between the stacks of the producer and the consumer, and exactly the
+//! thread that takes part in the handoff is woken up.
+//!
+//! Closing the channel wakes up all the waiting threads, which return
+//! `closed`. Elements offered by producers waiting at that time are not
+//! transferred, even to consumers that pop before those producers wake up.
+template <typename T>
+class rendezvous_channel {
+public:
+  using value_type = T;
+
+  rendezvous_channel() = default;
+
+  rendezvous_channel(rendezvous_channel const&) = delete;
+  rendezvous_channel(rendezvous_channel&&) = delete;
+  rendezvous_channel& operator=(rendezvous_channel const&) = delete;
+  rendezvous_channel& operator=(rendezvous_channel&&) = delete;
+
+  //! Deactivates the channel. See `bounded_channel::close()`.
+  void close();
+
+  //! Closes the channel. See `bounded_channel::~bounded_channel()`.
+  ~rendezvous_channel() { close(); }
+
+  //! Hands a value to a consumer, blocking until one takes it.
+  //!
+  //! - If the channel has been closed, returns `closed`.
+  //! - If a consumer is waiting, hands the value to it and returns `success`.
+  //! - Otherwise, waits until either a consumer takes the value (returns
+  //!   `success`) or the channel is closed (returns `closed`).
+  channel_op_status push(value_type const& va) { return this->push_impl(va); }
+  channel_op_status push(value_type&& va)      { return this->push_impl(std::move(va)); }
+
+  //! Hands a value to a consumer if one is waiting, without blocking.
+  //!
+  //! Returns `closed` if the channel has been closed, `success` if a consumer
+  //! was waiting and took the value, and `full` otherwise.
+  channel_op_status try_push(value_type const& va) { return this->try_push_impl(va); }
+  channel_op_status try_push(value_type&& va)      { return this->try_push_impl(std::move(va)); }
+
+  //! Takes a value from a producer, blocking until one provides it.
+  //!
+  //! - If a producer is waiting, takes its value into `va` and returns
+  //!   `success`.
+  //! - If the channel has been closed, returns `closed`.
+  //! - Otherwise, waits until either a producer provides a value (returns
+  //!   `success`) or the channel is closed (returns `closed`).
+  template <typename Value, typename =
+    std::enable_if_t<std::is_assignable<Value&, value_type&&>::value>
+  >
+  channel_op_status pop(Value& va);
+
+  //! Takes a value from a producer if one is waiting, without blocking.
+  //!
+  //! Returns `success` if a producer was waiting, `closed` if the channel has
+  //! been closed, and `empty` otherwise.
+  template <typename Value, typename =
+    std::enable_if_t<std::is_assignable<Value&, value_type&&>::value>
+  >
+  channel_op_status try_pop(Value& va);
+
+private:
+  using hook = boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>>;
+
+  // A producer waiting for a consumer to take its value. Lives on the stack
+  // of the producer.
+  struct waiting_producer : hook {
+    explicit waiting_producer(value_type& v) : value{v}, taken{false} { }
+    value_type& value;
+    bool taken;
+    std::condition_variable cv;
+  };
+
+  // A consumer waiting for a producer to give it a value. Lives on the stack
+  // of the consumer.
+  struct waiting_consumer : hook {
+    boost::optional<value_type> value;
+    std::condition_variable cv;
+  };
+
+  std::mutex mutex_;
+  boost::intrusive::list<waiting_producer> producers_;
+  boost::intrusive::list<waiting_consumer> consumers_;
+  bool closed_ = false;
+
+  template <typename Value>
+  channel_op_status push_impl(Value&& va);
+  template <typename Value>
+  channel_op_status try_push_impl(Value&& va);
+
+  // Waits until a consumer takes `va` or the channel is closed.
+  // WARNING -- must be called with the lock held
+  channel_op_status wait_for_consumer(std::unique_lock<std::mutex>& lock, value_type const& va);
+  channel_op_status wait_for_consumer(std::unique_lock<std::mutex>& lock, value_type& va);
+
+  // Hands `va` to the first waiting consumer, which must exist.
+  // WARNING -- must be called with the lock held
+  template <typename Value>
+  void hand_off(Value&& va) {
+    waiting_consumer& consumer = consumers_.front();
+    consumers_.pop_front();
+    consumer.value.emplace(std::forward<Value>(va));
+    // Notify with the lock held, since the consumer may destroy its
+    // condition variable as soon as it can reacquire the lock.
+    consumer.cv.notify_one();
+  }
+
+  // Takes the value of the first waiting producer, which must exist.
+  // WARNING -- must be called with the lock held
+  template <typename Value>
+  void take(Value& va) {
+    waiting_producer& producer = producers_.front();
+    producers_.pop_front();
+    va = std::move(producer.value);
+    producer.taken = true;
+    producer.cv.notify_one();
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Channel implementation
+//////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void rendezvous_channel<T>::close() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  closed_ = true;
+  // Waiters remove themselves from the lists when they wake up.
+  for (waiting_producer& producer : producers_)
+    producer.cv.notify_one();
+  for (waiting_consumer& consumer : consumers_)
+    consumer.cv.notify_one();
+}
+
+template <typename T>
+template <typename Value>
+channel_op_status rendezvous_channel<T>::push_impl(Value&& va) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  if (closed_) {
+    return channel_op_status::closed;
+  } else if (!consumers_.empty()) {
+    hand_off(std::forward<Value>(va));
+    return channel_op_status::success;
+  }
+
+  // `va` is an lvalue here, so this copies the value if it was passed by
+  // const reference, and refers to the caller's value otherwise.
+  return wait_for_consumer(lock, va);
+}
+
+template <typename T>
+channel_op_status rendezvous_channel<T>::wait_for_consumer(std::unique_lock<std::mutex>& lock, value_type const& va) {
+  value_type copy{va};
+  return wait_for_consumer(lock, copy);
+}
+
+template <typename T>
+channel_op_status rendezvous_channel<T>::wait_for_consumer(std::unique_lock<std::mutex>& lock, value_type& va) {
+  // The value is only moved from if a consumer takes it.
+  waiting_producer self{va};
+  producers_.push_back(self);
+  self.cv.wait(lock, [&] { return self.taken || closed_; });
+  if (self.taken) {
+    return channel_op_status::success;
+  } else {
+    producers_.erase(producers_.iterator_to(self));
+    return channel_op_status::closed;
+  }
+}
+
+template <typename T>
+template <typename Value>
+channel_op_status rendezvous_channel<T>::try_push_impl(Value&& va) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  if (closed_) {
+    return channel_op_status::closed;
+  } else if (!consumers_.empty()) {
+    hand_off(std::forward<Value>(va));
+    return channel_op_status::success;
+  } else {
+    return channel_op_status::full;
+  }
+}
+
+template <typename T>
+template <typename Value, typename>
+channel_op_status rendezvous_channel<T>::pop(Value& va) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  // Producers still waiting after the channel was closed are about to
+  // return `closed`, so their values must not be taken.
+  if (closed_) {
+    return channel_op_status::closed;
+  } else if (!producers_.empty()) {
+    take(va);
+    return channel_op_status::success;
+  }
+
+  waiting_consumer self;
+  consumers_.push_back(self);
+  self.cv.wait(lock, [&] { return self.value || closed_; });
+  if (self.value) {
+    va = std::move(*self.value);
+    return channel_op_status::success;
+  } else {
+    consumers_.erase(consumers_.iterator_to(self));
+    return channel_op_status::closed;
+  }
+}
+
+template <typename T>
+template <typename Value, typename>
+channel_op_status rendezvous_channel<T>::try_pop(Value& va) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  if (closed_) {
+    return channel_op_status::closed;
+  } else if (!producers_.empty()) {
+    take(va);
+    return channel_op_status::success;
+  } else {
+    return channel_op_status::empty;
+  }
+}
+
+} // end namespace amz
+
+#endif // include guard
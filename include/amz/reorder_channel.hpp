@@ -0,0 +1,228 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_REORDER_CHANNEL_HPP
+#define AMZ_REORDER_CHANNEL_HPP
+
+#include <amz/bounded_channel.hpp>
+
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+
+namespace amz {
+
+//! Multi-producer multi-consumer channel restoring the order of elements
+//! based on sequence numbers.
+//!
+//! Each element is pushed along with a sequence number, and elements are
+//! popped strictly in the order of their sequence numbers, starting from the
+//! first sequence number given at construction. Elements can be pushed in
+//! any order, which makes this channel suitable for restoring the order of
+//! results after having processed elements in parallel, e.g. by numbering
+//! the elements before fanning them out to workers through a
+//! `bounded_channel` and pushing the results to a `reorder_channel`.
+//!
+//! Elements are stored in a ring of `capacity` slots indexed by their
+//! sequence number modulo the capacity, so reordering costs O(1) per element.
+//! A producer pushing an element whose sequence number is `capacity` or more
+//! past the next element to be popped blocks until that element has been
+//! popped. In particular, the capacity must be at least the number of
+//! elements that can be in flight between the two stages, otherwise the
+//! producer of the next element to be popped may never get to push it.
+//!
+//! Each sequence number must be pushed exactly once. Pushing a sequence
+//! number that was already pushed, or that is smaller than the next sequence
+//! number to be popped, is undefined behavior.
+template <typename T>
+class reorder_channel {
+public:
+  using value_type = T;
+  using sequence_type = std::uint64_t;
+
+  reorder_channel() = delete;
+
+  //! Creates a `reorder_channel` with the given capacity, whose first
+  //! element will have the sequence number `first_sequence`.
+  explicit reorder_channel(std::size_t capacity, sequence_type first_sequence = 0);
+
+  reorder_channel(reorder_channel const&) = delete;
+  reorder_channel(reorder_channel&&) = delete;
+  reorder_channel& operator=(reorder_channel const&) = delete;
+  reorder_channel& operator=(reorder_channel&&) = delete;
+
+  //! Deactivates the channel, preventing new elements from being pushed to
+  //! it. See `bounded_channel::close()`.
+  void close();
+
+  //! Closes the channel. See `bounded_channel::~bounded_channel()`.
+  ~reorder_channel() { close(); }
+
+  //! Pushes the element with sequence number `seq` into the channel, possibly
+  //! blocking if `seq` is too far ahead of the next element to be popped.
+  //!
+  //! - If the channel has been closed, returns `closed`.
+  //! - Otherwise, waits until `seq` fits in the ring (or the channel is
+  //!   closed), stores the value, notifies a consumer if the value is the
+  //!   next one to be popped, and returns `success`.
+  channel_op_status push(sequence_type seq, value_type const& va) { return this->push_impl(seq, va); }
+  channel_op_status push(sequence_type seq, value_type&& va)      { return this->push_impl(seq, std::move(va)); }
+
+  //! Dequeues the next element in sequence order, possibly blocking until
+  //! it has been pushed.
+  //!
+  //! - If the next element is available, dequeues it into `va`, notifies
+  //!   blocked producers and returns `success`.
+  //! - If the next element is not available and the channel has been closed,
+  //!   returns `closed`, even if elements with larger sequence numbers are
+  //!   available (they can never be popped in order).
+  //! - Otherwise, waits until one of the above happens.
+  template <typename Value, typename =
+    std::enable_if_t<std::is_assignable<Value&, value_type&&>::value>
+  >
+  channel_op_status pop(Value& va);
+
+  //! Equivalent to `pop()`, but returns `empty` instead of blocking.
+  template <typename Value, typename =
+    std::enable_if_t<std::is_assignable<Value&, value_type&&>::value>
+  >
+  channel_op_status try_pop(Value& va);
+
+  //! Returns the sequence number of the next element to be popped.
+  sequence_type next_sequence() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    return next_;
+  }
+
+private:
+  std::vector<boost::optional<T>> ring_;
+  sequence_type next_;
+  std::mutex mutex_;
+  std::condition_variable consumers_; // notified when the next element is pushed
+  std::condition_variable producers_; // notified when we pop something
+  bool closed_;
+
+  template <typename Value>
+  channel_op_status push_impl(sequence_type seq, Value&& va);
+
+  // WARNING -- not thread safe
+  boost::optional<T>& slot(sequence_type seq) { return ring_[seq % ring_.size()]; }
+
+  // WARNING -- not thread safe
+  bool next_is_ready() { return static_cast<bool>(slot(next_)); }
+
+  // Pops the next element into `va`, which must be ready.
+  // WARNING -- not thread safe
+  template <typename Value>
+  void take_next(Value& va) {
+    boost::optional<T>& next = slot(next_);
+    va = std::move(*next);
+    next = boost::none;
+    ++next_;
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Channel implementation
+//////////////////////////////////////////////////////////////////////////////
+template <typename T>
+reorder_channel<T>::reorder_channel(std::size_t capacity, sequence_type first_sequence)
+  : ring_(capacity)
+  , next_{first_sequence}
+  , mutex_{}
+  , consumers_{}
+  , producers_{}
+  , closed_{false}
+{
+  assert(capacity > 0);
+}
+
+template <typename T>
+void reorder_channel<T>::close() {
+  {
+    std::unique_lock<std::mutex> lock{mutex_};
+    closed_ = true;
+  }
+  producers_.notify_all();
+  consumers_.notify_all();
+}
+
+template <typename T>
+template <typename Value>
+channel_op_status reorder_channel<T>::push_impl(sequence_type seq, Value&& va) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  assert(seq >= next_ && "pushing an element that is older than the next element to be popped");
+  producers_.wait(lock, [&] { return closed_ || seq - next_ < ring_.size(); });
+  if (closed_) {
+    return channel_op_status::closed;
+  }
+
+  boost::optional<T>& s = slot(seq);
+  assert(!s && "pushing the same sequence number twice");
+  s = std::forward<Value>(va);
+  bool const is_next = seq == next_;
+  lock.unlock();
+  if (is_next)
+    consumers_.notify_one();
+  return channel_op_status::success;
+}
+
+template <typename T>
+template <typename Value, typename>
+channel_op_status reorder_channel<T>::pop(Value& va) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  consumers_.wait(lock, [this] { return this->next_is_ready() || closed_; });
+  if (!next_is_ready()) {
+    assert(closed_);
+    return channel_op_status::closed;
+  }
+
+  take_next(va);
+  bool const more = next_is_ready();
+  lock.unlock();
+  // Any producer may be waiting for the slot we just freed, and the next
+  // element may already be there for another consumer.
+  producers_.notify_all();
+  if (more)
+    consumers_.notify_one();
+  return channel_op_status::success;
+}
+
+template <typename T>
+template <typename Value, typename>
+channel_op_status reorder_channel<T>::try_pop(Value& va) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  if (!next_is_ready()) {
+    return closed_ ? channel_op_status::closed : channel_op_status::empty;
+  }
+
+  take_next(va);
+  bool const more = next_is_ready();
+  lock.unlock();
+  producers_.notify_all();
+  if (more)
+    consumers_.notify_one();
+  return channel_op_status::success;
+}
+
+} // end namespace amz
+
+#endif // include guard
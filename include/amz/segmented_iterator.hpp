@@ -0,0 +1,145 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_SEGMENTED_ITERATOR_HPP
+#define AMZ_SEGMENTED_ITERATOR_HPP
+
+#include <algorithm>
+#include <deque>
+#include <type_traits>
+#include <utility>
+
+
+namespace amz {
+
+// Traits describing iterators over segmented data structures.
+//
+// A segmented data structure is a sequence of contiguous segments, like
+// `std::deque` (which is a sequence of fixed-size arrays). Iterating over
+// such a data structure with a "flat" iterator requires checking whether a
+// segment boundary is reached on every increment, which is costly and
+// prevents the compiler from vectorizing loops. Instead, algorithms can use
+// these traits to iterate over each segment in turn with a _local iterator_
+// (typically a pointer), which makes the inner loop as tight as the loop over
+// a plain array.
+//
+// This follows the design in Matt Austern's "Segmented Iterators and
+// Hierarchical Algorithms". By default, iterators are not segmented, and
+// the traits only contain `is_segmented_iterator`, which is `std::false_type`.
+// To make algorithms of this library segment-aware for another data structure,
+// specialize these traits for its iterator with the following members:
+//
+// - `is_segmented_iterator`: `std::true_type`
+// - `segment_iterator`: an iterator over the segments of the data structure
+// - `local_iterator`: an iterator over the elements of a single segment
+// - `static segment_iterator segment(Iterator it)`: the segment `it` is in
+// - `static local_iterator local(Iterator it)`: the position of `it` within
+//   its segment
+// - `static local_iterator begin(segment_iterator s)`: the first element of `s`
+// - `static local_iterator end(segment_iterator s)`: one past the last element
+//   of `s`
+// - `static Iterator compose(segment_iterator s, local_iterator l)`: the flat
+//   iterator pointing to position `l` within segment `s`
+//
+// The past-the-end iterator of a segmented data structure must lie within a
+// valid segment (i.e. `begin(segment(last))` must be valid), and iterators
+// must be normalized so that `local(it)` is never `end(segment(it))`, except
+// possibly for the past-the-end iterator.
+//
+// A specialization is provided for `std::deque` iterators when using
+// libstdc++.
+template <typename Iterator>
+struct segmented_iterator_traits {
+  using is_segmented_iterator = std::false_type;
+};
+
+#if defined(__GLIBCXX__)
+template <typename T, typename Reference, typename Pointer>
+struct segmented_iterator_traits<std::_Deque_iterator<T, Reference, Pointer>> {
+private:
+  using Iterator = std::_Deque_iterator<T, Reference, Pointer>;
+  using ElementPointer = decltype(std::declval<Iterator&>()._M_cur);
+
+public:
+  using is_segmented_iterator = std::true_type;
+  using segment_iterator = decltype(std::declval<Iterator&>()._M_node);
+  using local_iterator = Pointer;
+
+  static segment_iterator segment(Iterator it) noexcept { return it._M_node; }
+  static local_iterator local(Iterator it) noexcept { return it._M_cur; }
+  static local_iterator begin(segment_iterator s) noexcept { return *s; }
+  static local_iterator end(segment_iterator s) noexcept { return *s + Iterator::_S_buffer_size(); }
+  static Iterator compose(segment_iterator s, local_iterator l) noexcept {
+    return Iterator(const_cast<ElementPointer>(l), s);
+  }
+};
+#endif
+
+namespace detail {
+  template <typename Iterator>
+  using is_segmented_iterator_t = typename segmented_iterator_traits<Iterator>::is_segmented_iterator;
+
+  // Given a range `[first, last)` of segmented iterators, calls
+  // `f(local_first, local_last)` on each contiguous part of the range in
+  // order. `f` must return a local iterator into the part it was given;
+  // if that iterator is not `local_last`, the traversal stops and the flat
+  // iterator to that position is returned. Otherwise, `last` is returned.
+  template <typename SegmentedIterator, typename F>
+  SegmentedIterator for_each_segment(SegmentedIterator first, SegmentedIterator last, F&& f) {
+    using Traits = segmented_iterator_traits<SegmentedIterator>;
+    auto segment = Traits::segment(first);
+    auto const last_segment = Traits::segment(last);
+    if (segment == last_segment)
+      return Traits::compose(segment, f(Traits::local(first), Traits::local(last)));
+
+    auto end = Traits::end(segment);
+    auto stop = f(Traits::local(first), end);
+    if (stop != end)
+      return Traits::compose(segment, stop);
+
+    for (++segment; segment != last_segment; ++segment) {
+      end = Traits::end(segment);
+      stop = f(Traits::begin(segment), end);
+      if (stop != end)
+        return Traits::compose(segment, stop);
+    }
+
+    return Traits::compose(last_segment, f(Traits::begin(last_segment), Traits::local(last)));
+  }
+
+  // Equivalent to `std::find_if`, but traverses segmented ranges one segment
+  // at a time.
+  template <typename InputIterator, typename Predicate>
+  InputIterator segmented_find_if(InputIterator first, InputIterator last, Predicate&& pred, std::false_type) {
+    return std::find_if(first, last, pred);
+  }
+
+  template <typename InputIterator, typename Predicate>
+  InputIterator segmented_find_if(InputIterator first, InputIterator last, Predicate&& pred, std::true_type) {
+    return detail::for_each_segment(first, last, [&](auto local_first, auto local_last) {
+      using LocalIterator = decltype(local_first);
+      return detail::segmented_find_if(local_first, local_last, pred,
+                                       detail::is_segmented_iterator_t<LocalIterator>{});
+    });
+  }
+
+  template <typename InputIterator, typename Predicate>
+  InputIterator segmented_find_if(InputIterator first, InputIterator last, Predicate&& pred) {
+    return detail::segmented_find_if(first, last, pred,
+                                     detail::is_segmented_iterator_t<InputIterator>{});
+  }
+} // end namespace detail
+
+} // end namespace amz
+
+#endif // include guard
@@ -0,0 +1,409 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_SPILLING_CHANNEL_HPP
+#define AMZ_SPILLING_CHANNEL_HPP
+
+#include <amz/bounded_channel.hpp>
+#include <amz/detail/file.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+namespace amz {
+
+//! Customization point describing how elements of type `T` are written to
+//! and read from the spool of a `spilling_channel`.
+//!
+//! A specialization must provide the following static member functions:
+//! - `std::size_t size(T const& v)`, returning the number of bytes needed to
+//!   serialize `v`.
+//! - `void serialize(T const& v, char* out)`, writing exactly `size(v)` bytes
+//!   representing `v` to `out`.
+//! - `T deserialize(char const* in, std::size_t size)`, returning the object
+//!   represented by the `size` bytes at `in`.
+//!
+//! Buffers passed to these functions are not aligned. By default, types that
+//! are TriviallyCopyable are copied as raw bytes; other types must provide a
+//! specialization.
+template <typename T, typename = void>
+struct spill_traits;
+
+template <typename T>
+struct spill_traits<T, std::enable_if_t<std::is_trivially_copyable<T>::value>> {
+  static std::size_t size(T const&) noexcept { return sizeof(T); }
+
+  static void serialize(T const& v, char* out) noexcept {
+    std::memcpy(out, std::addressof(v), sizeof(T));
+  }
+
+  static T deserialize(char const* in, std::size_t size) noexcept {
+    assert(size == sizeof(T));
+    (void)size;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    std::memcpy(&storage, in, sizeof(T));
+    return *reinterpret_cast<T*>(&storage);
+  }
+};
+
+//! Multi-producer multi-consumer thread-safe channel that spills to disk
+//! instead of blocking producers when it is full.
+//!
+//! This channel behaves like a `bounded_channel` holding at most `capacity`
+//! elements in memory. However, when the in-memory queue is full, pushed
+//! elements are serialized (see `spill_traits`) and appended to a spool made
+//! of memory-mapped files in a given directory, instead of blocking the
+//! producer. Consumers transparently read spilled elements back, and the
+//! channel remains FIFO: once an element has been spilled, all the elements
+//! pushed after it are spilled too, until the spool has been fully consumed.
+//!
+//! The spool is made of segments of `segment_size` bytes (larger if a single
+//! element does not fit). A segment is released as soon as all its elements
+//! have been consumed. The total size of the segments is bounded by
+//! `max_spill_bytes`; when the spool is full too, producers block (or
+//! `try_push()` returns `full`) like they would with a `bounded_channel`.
+//!
+//! Note on durability
+//! ==================
+//! The spool is meant to absorb bursts without using unbounded memory, not
+//! to persist elements: segment files are unlinked as soon as they are
+//! created, so they don't outlive the channel (or the process), and spilled
+//! elements are lost if the process dies.
+//!
+//! Error handling
+//! ==============
+//! Failures of the system calls used to manage the spool are reported by
+//! throwing a `std::system_error` from the pushing operation that needed a
+//! new segment; the element is not pushed in that case.
+template <typename T, typename Traits = spill_traits<T>>
+class spilling_channel {
+public:
+  using value_type = T;
+
+  spilling_channel() = delete;
+
+  //! Creates a `spilling_channel` holding up to `capacity` elements in memory
+  //! and spilling to segments created in `spool_directory`.
+  spilling_channel(std::size_t capacity,
+                   std::string spool_directory,
+                   std::size_t segment_size = std::size_t{64} << 20,
+                   std::size_t max_spill_bytes = std::numeric_limits<std::size_t>::max());
+
+  spilling_channel(spilling_channel const&) = delete;
+  spilling_channel(spilling_channel&&) = delete;
+  spilling_channel& operator=(spilling_channel const&) = delete;
+  spilling_channel& operator=(spilling_channel&&) = delete;
+
+  //! Deactivates the channel, preventing new elements from being pushed to
+  //! it. See `bounded_channel::close()`.
+  void close();
+
+  //! Closes the channel. See `bounded_channel::~bounded_channel()`.
+  ~spilling_channel() { close(); }
+
+  //! Pushes a new value into the channel, spilling it if the in-memory queue
+  //! is full, and blocking only if the spool is full too.
+  //!
+  //! - If the channel has been closed, returns `closed`.
+  //! - Otherwise, enqueues the new value (possibly waiting for room in the
+  //!   spool), notifies at least one thread waiting on a popping operation
+  //!   and returns `success`.
+  channel_op_status push(value_type const& va) { return this->push_impl(va); }
+  channel_op_status push(value_type&& va)      { return this->push_impl(std::move(va)); }
+
+  //! Tries pushing a new value into the channel without blocking.
+  //!
+  //! Returns `closed` if the channel has been closed, `full` if both the
+  //! in-memory queue and the spool are full, and `success` otherwise.
+  channel_op_status try_push(value_type const& va) { return this->try_push_impl(va); }
+  channel_op_status try_push(value_type&& va)      { return this->try_push_impl(std::move(va)); }
+
+  //! Dequeues an element from the channel, possibly blocking if the channel
+  //! is empty. See `bounded_channel::pop()`.
+  template <typename Value, typename =
+    std::enable_if_t<std::is_assignable<Value&, value_type&&>::value>
+  >
+  channel_op_status pop(Value& va);
+
+  //! Tries dequeuing an element from the channel without blocking. See
+  //! `bounded_channel::try_pop()`.
+  template <typename Value, typename =
+    std::enable_if_t<std::is_assignable<Value&, value_type&&>::value>
+  >
+  channel_op_status try_pop(Value& va);
+
+  //! Returns the number of elements currently spilled to disk.
+  std::size_t spilled() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return spilled_;
+  }
+
+private:
+  struct segment {
+    detail::unique_fd file;
+    detail::unique_mapping mapping;
+    std::size_t write_pos;
+    std::size_t read_pos;
+  };
+
+  using record_size_type = std::uint32_t;
+
+  std::size_t const capacity_;
+  std::string const spool_directory_;
+  std::size_t const segment_size_;
+  std::size_t const max_spill_bytes_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable consumers_; // notified when we push something new
+  std::condition_variable producers_; // notified when we pop something
+  std::deque<T> memory_;
+  std::deque<segment> segments_;      // front is read from, back is written to
+  std::size_t spilled_;               // number of elements in `segments_`
+  std::size_t spool_bytes_;           // total size of `segments_`
+  bool closed_;
+
+  template <typename Value>
+  channel_op_status push_impl(Value&& va);
+  template <typename Value>
+  channel_op_status try_push_impl(Value&& va);
+
+  // Enqueues `va` in memory or in the spool, and returns whether there was
+  // room to do so. `va` is left untouched if it can't be enqueued.
+  // WARNING -- not thread safe
+  template <typename Value>
+  bool enqueue(Value&& va);
+
+  // Dequeues the front element into `va`. The channel must not be empty.
+  // WARNING -- not thread safe
+  template <typename Value>
+  void dequeue(Value& va);
+
+  // WARNING -- not thread safe
+  bool spill(value_type const& va);
+  value_type unspill();
+
+  // WARNING -- not thread safe
+  bool is_empty() const { return memory_.empty() && spilled_ == 0; }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Channel implementation
+//////////////////////////////////////////////////////////////////////////////
+template <typename T, typename Traits>
+spilling_channel<T, Traits>::spilling_channel(std::size_t capacity,
+                                              std::string spool_directory,
+                                              std::size_t segment_size,
+                                              std::size_t max_spill_bytes)
+  : capacity_{capacity}
+  , spool_directory_{std::move(spool_directory)}
+  , segment_size_{segment_size}
+  , max_spill_bytes_{max_spill_bytes}
+  , mutex_{}
+  , consumers_{}
+  , producers_{}
+  , memory_{}
+  , segments_{}
+  , spilled_{0}
+  , spool_bytes_{0}
+  , closed_{false}
+{
+  assert(segment_size > 0);
+}
+
+template <typename T, typename Traits>
+void spilling_channel<T, Traits>::close() {
+  {
+    std::unique_lock<std::mutex> lock{mutex_};
+    closed_ = true;
+  }
+  producers_.notify_all();
+  consumers_.notify_all();
+}
+
+//
+// push(), try_push()
+//
+template <typename T, typename Traits>
+template <typename Value>
+channel_op_status spilling_channel<T, Traits>::push_impl(Value&& va) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (true) {
+    if (closed_) {
+      return channel_op_status::closed;
+    } else if (enqueue(std::forward<Value>(va))) {
+      lock.unlock();
+      consumers_.notify_one();
+      return channel_op_status::success;
+    }
+    producers_.wait(lock);
+  }
+}
+
+template <typename T, typename Traits>
+template <typename Value>
+channel_op_status spilling_channel<T, Traits>::try_push_impl(Value&& va) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  if (closed_) {
+    return channel_op_status::closed;
+  } else if (enqueue(std::forward<Value>(va))) {
+    lock.unlock();
+    consumers_.notify_one();
+    return channel_op_status::success;
+  } else {
+    return channel_op_status::full;
+  }
+}
+
+template <typename T, typename Traits>
+template <typename Value>
+bool spilling_channel<T, Traits>::enqueue(Value&& va) {
+  // Elements can only go to memory if nothing is spilled, since spilled
+  // elements are older than anything pushed after them.
+  if (spilled_ == 0 && memory_.size() < capacity_) {
+    memory_.push_back(std::forward<Value>(va));
+    return true;
+  }
+  return spill(va);
+}
+
+//
+// pop(), try_pop()
+//
+template <typename T, typename Traits>
+template <typename Value, typename>
+channel_op_status spilling_channel<T, Traits>::pop(Value& va) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  consumers_.wait(lock, [this] { return !this->is_empty() || closed_; });
+  if (!is_empty()) {
+    dequeue(va);
+    lock.unlock();
+    producers_.notify_one();
+    return channel_op_status::success;
+  } else {
+    assert(closed_);
+    return channel_op_status::closed;
+  }
+}
+
+template <typename T, typename Traits>
+template <typename Value, typename>
+channel_op_status spilling_channel<T, Traits>::try_pop(Value& va) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  if (!is_empty()) {
+    dequeue(va);
+    lock.unlock();
+    producers_.notify_one();
+    return channel_op_status::success;
+  } else if (closed_) {
+    return channel_op_status::closed;
+  } else {
+    return channel_op_status::empty;
+  }
+}
+
+template <typename T, typename Traits>
+template <typename Value>
+void spilling_channel<T, Traits>::dequeue(Value& va) {
+  assert(!is_empty());
+  if (!memory_.empty()) {
+    va = std::move(memory_.front());
+    memory_.pop_front();
+  } else {
+    va = unspill();
+  }
+}
+
+//
+// Spool management
+//
+template <typename T, typename Traits>
+bool spilling_channel<T, Traits>::spill(value_type const& va) {
+  std::size_t const size = Traits::size(va);
+  if (size > std::numeric_limits<record_size_type>::max()) {
+    throw std::length_error{"spilling_channel: element too large to be spilled"};
+  }
+  std::size_t const record_size = sizeof(record_size_type) + size;
+
+  if (segments_.empty() || segments_.back().mapping.size() - segments_.back().write_pos < record_size) {
+    std::size_t const page = detail::page_size();
+    std::size_t const new_segment_size = std::max(segment_size_, (record_size + page - 1) / page * page);
+    if (new_segment_size > max_spill_bytes_ - std::min(spool_bytes_, max_spill_bytes_)) {
+      return false;
+    }
+
+    std::string path = spool_directory_ + "/amz-spill.XXXXXX";
+    detail::unique_fd file{::mkstemp(&path[0])};
+    if (!file)
+      detail::throw_errno("mkstemp");
+    ::unlink(path.c_str());
+    if (::ftruncate(file.get(), static_cast<::off_t>(new_segment_size)) != 0)
+      detail::throw_errno("ftruncate");
+    detail::unique_mapping mapping{file.get(), new_segment_size, PROT_READ | PROT_WRITE};
+    segments_.push_back(segment{std::move(file), std::move(mapping), 0, 0});
+    spool_bytes_ += new_segment_size;
+  }
+
+  segment& back = segments_.back();
+  char* const out = back.mapping.data() + back.write_pos;
+  record_size_type const header = static_cast<record_size_type>(size);
+  std::memcpy(out, &header, sizeof(header));
+  Traits::serialize(va, out + sizeof(header));
+  back.write_pos += record_size;
+  ++spilled_;
+  return true;
+}
+
+template <typename T, typename Traits>
+T spilling_channel<T, Traits>::unspill() {
+  assert(spilled_ != 0);
+  segment& front = segments_.front();
+  assert(front.read_pos < front.write_pos);
+  char const* const in = front.mapping.data() + front.read_pos;
+  record_size_type size;
+  std::memcpy(&size, in, sizeof(size));
+  value_type value = Traits::deserialize(in + sizeof(size), size);
+
+  front.read_pos += sizeof(size) + size;
+  --spilled_;
+  if (front.read_pos == front.write_pos) {
+    if (segments_.size() == 1) {
+      // Keep the last segment around to avoid recreating it on the next spill.
+      front.read_pos = front.write_pos = 0;
+    } else {
+      spool_bytes_ -= front.mapping.size();
+      segments_.pop_front();
+      producers_.notify_all();
+    }
+  }
+  return value;
+}
+
+} // end namespace amz
+
+#endif // include guard
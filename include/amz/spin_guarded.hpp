@@ -0,0 +1,267 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_SPIN_GUARDED_HPP
+#define AMZ_SPIN_GUARDED_HPP
+
+#include <amz/small_spin_mutex.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+
+namespace amz {
+
+//! Layout of the lock and the data of a `spin_guarded` object.
+enum class spin_guarded_layout {
+  //! The object is aligned on a cache line, and the lock is placed right
+  //! after the data. When both fit in a cache line, locking and accessing
+  //! the data costs a single cache miss, and the object never shares its
+  //! cache line with unrelated data (no false sharing).
+  cache_aligned,
+
+  //! The object is not over-aligned, and the lock is placed in the tail
+  //! padding of the data when possible. This minimizes the size of the
+  //! object, at the cost of possible false sharing with neighbouring data.
+  packed
+};
+
+namespace detail {
+  static constexpr std::size_t spin_guarded_cache_line = 64;
+
+  template <typename T, typename Mutex, spin_guarded_layout Layout, typename = void>
+  struct spin_guarded_storage;
+
+  template <typename T, typename Mutex>
+  struct alignas(spin_guarded_cache_line) spin_guarded_storage<T, Mutex, spin_guarded_layout::cache_aligned> {
+    template <typename ...Args>
+    explicit spin_guarded_storage(Args&& ...args) : value_(std::forward<Args>(args)...) { }
+
+    T& value() noexcept { return value_; }
+    T const& value() const noexcept { return value_; }
+
+    T value_;
+    mutable Mutex mutex_;
+  };
+
+  // Whether the lock can be placed in the tail padding of `T` by deriving
+  // from it. With the Itanium C++ ABI, the members of a derived class are
+  // laid out in the tail padding of a base class that is not POD for the
+  // purpose of layout. Compiler-generated copies of the `T` base don't touch
+  // that padding, but trivially copyable types may legitimately be copied
+  // with `memcpy` (which `std::copy` does), overwriting all of `sizeof(T)`,
+  // so those must not share their padding.
+  template <typename T>
+  using spin_guarded_derives = std::integral_constant<bool,
+    std::is_class<T>::value && !std::is_final<T>::value && !std::is_trivially_copyable<T>::value
+  >;
+
+  template <typename T, typename Mutex>
+  struct spin_guarded_storage<T, Mutex, spin_guarded_layout::packed,
+                              std::enable_if_t<spin_guarded_derives<T>::value>>
+    : T
+  {
+    template <typename ...Args>
+    explicit spin_guarded_storage(Args&& ...args) : T(std::forward<Args>(args)...) { }
+
+    T& value() noexcept { return *this; }
+    T const& value() const noexcept { return *this; }
+
+    mutable Mutex mutex_;
+  };
+
+  template <typename T, typename Mutex>
+  struct spin_guarded_storage<T, Mutex, spin_guarded_layout::packed,
+                              std::enable_if_t<!spin_guarded_derives<T>::value>>
+  {
+    template <typename ...Args>
+    explicit spin_guarded_storage(Args&& ...args) : value_(std::forward<Args>(args)...) { }
+
+    T& value() noexcept { return value_; }
+    T const& value() const noexcept { return value_; }
+
+    T value_;
+    mutable Mutex mutex_;
+  };
+} // end namespace detail
+
+//! Handle providing access to the data of a `spin_guarded` object while
+//! holding its lock.
+//!
+//! The lock is released when the handle is destroyed. Handles are movable,
+//! so they can be returned from functions, but not copyable. A handle that
+//! doesn't own the lock (because it was moved from, or because `try_lock()`
+//! failed) converts to false, and must not be dereferenced.
+template <typename T, typename Mutex>
+class spin_guarded_ptr {
+public:
+  spin_guarded_ptr(spin_guarded_ptr&& other) noexcept
+    : value_{other.value_}, mutex_{other.mutex_}
+  {
+    other.value_ = nullptr;
+    other.mutex_ = nullptr;
+  }
+
+  spin_guarded_ptr& operator=(spin_guarded_ptr&& other) noexcept {
+    if (this != &other) {
+      unlock();
+      value_ = other.value_;
+      mutex_ = other.mutex_;
+      other.value_ = nullptr;
+      other.mutex_ = nullptr;
+    }
+    return *this;
+  }
+
+  spin_guarded_ptr(spin_guarded_ptr const&) = delete;
+  spin_guarded_ptr& operator=(spin_guarded_ptr const&) = delete;
+
+  ~spin_guarded_ptr() { unlock(); }
+
+  //! Returns whether this handle owns the lock.
+  explicit operator bool() const noexcept { return mutex_ != nullptr; }
+
+  T& operator*() const noexcept { assert(*this); return *value_; }
+  T* operator->() const noexcept { assert(*this); return value_; }
+
+  //! Releases the lock early. The handle must not be dereferenced anymore.
+  void unlock() noexcept {
+    if (mutex_ != nullptr) {
+      mutex_->unlock();
+      value_ = nullptr;
+      mutex_ = nullptr;
+    }
+  }
+
+private:
+  template <typename, typename, spin_guarded_layout>
+  friend class spin_guarded;
+
+  // Adopts a lock that is already held; `mutex` may be null.
+  spin_guarded_ptr(T* value, Mutex* mutex) noexcept : value_{value}, mutex_{mutex} { }
+
+  T* value_;
+  Mutex* mutex_;
+};
+
+//! Object of type `T` protected by a lock of type `Mutex`, stored together.
+//!
+//! Embedding a spin mutex next to the data it protects is error-prone: it is
+//! easy to access the data without holding the lock, and the lock may end up
+//! on a different cache line than the data, which costs two cache misses per
+//! critical section instead of one. This class stores both in a single
+//! object laid out according to `Layout`, and only gives access to the data
+//! while the lock is held, either with `with_lock()`:
+//! ```c++
+//! amz::spin_guarded<std::vector<int>> guarded;
+//! guarded.with_lock([](std::vector<int>& v) { v.push_back(1); });
+//! ```
+//! or through a handle that holds the lock until it is destroyed:
+//! ```c++
+//! auto v = guarded.lock();
+//! v->push_back(2);
+//! ```
+//!
+//! `Mutex` must meet the requirements of `Lockable`, and it is
+//! `small_spin_mutex` by default. The lock is taken for const access as
+//! well, since the data may be modified concurrently otherwise.
+//!
+//! Note on alignment
+//! =================
+//! With the default `cache_aligned` layout, the object is over-aligned. Such
+//! objects are correctly aligned as variables and members, but before C++17,
+//! `new` does not honor over-alignment, so dynamically allocated
+//! `spin_guarded` objects must use an allocator that does.
+//!
+//! Note on the packed layout
+//! =========================
+//! With the `packed` layout, the lock is placed after the data, in its tail
+//! padding if the platform ABI allows it (for class types that are not final
+//! and not POD), and if `T` is not trivially copyable. Trivially copyable
+//! objects may be copied with `memcpy`, which would overwrite the lock.
+//!
+//! For example, with `struct order { std::string id; int quantity; };`, a
+//! `small_spin_mutex` fits in the 4 bytes of padding after `quantity` on
+//! 64-bit platforms, so `sizeof(spin_guarded<order, small_spin_mutex,
+//! spin_guarded_layout::packed>) == sizeof(order)`. Otherwise, the lock is
+//! placed right after the data.
+template <typename T, typename Mutex = small_spin_mutex,
+          spin_guarded_layout Layout = spin_guarded_layout::cache_aligned>
+class spin_guarded {
+public:
+  using value_type = T;
+  using mutex_type = Mutex;
+  using locked_ptr = spin_guarded_ptr<T, Mutex>;
+  using const_locked_ptr = spin_guarded_ptr<T const, Mutex>;
+
+  //! Constructs the data with the given arguments.
+  template <typename ...Args, typename = std::enable_if_t<std::is_constructible<T, Args...>::value>>
+  explicit spin_guarded(Args&& ...args)
+    : storage_(std::forward<Args>(args)...)
+  { }
+
+  spin_guarded(spin_guarded const&) = delete;
+  spin_guarded& operator=(spin_guarded const&) = delete;
+
+  //! Calls `f` with a reference to the data while holding the lock, and
+  //! returns the result of `f`. The lock is released even if `f` throws.
+  template <typename F>
+  decltype(auto) with_lock(F&& f) {
+    locked_ptr locked = lock();
+    return std::forward<F>(f)(*locked);
+  }
+
+  //! Same as above, with a reference to const.
+  template <typename F>
+  decltype(auto) with_lock(F&& f) const {
+    const_locked_ptr locked = lock();
+    return std::forward<F>(f)(*locked);
+  }
+
+  //! Blocks until the lock is acquired, and returns a handle to the data
+  //! that holds the lock.
+  locked_ptr lock() {
+    storage_.mutex_.lock();
+    return locked_ptr{&storage_.value(), &storage_.mutex_};
+  }
+
+  //! Same as above, with a handle to const.
+  const_locked_ptr lock() const {
+    storage_.mutex_.lock();
+    return const_locked_ptr{&storage_.value(), &storage_.mutex_};
+  }
+
+  //! Tries to acquire the lock without blocking, and returns a handle that
+  //! holds the lock on success, or an empty handle otherwise.
+  locked_ptr try_lock() {
+    if (!storage_.mutex_.try_lock())
+      return locked_ptr{nullptr, nullptr};
+    return locked_ptr{&storage_.value(), &storage_.mutex_};
+  }
+
+  //! Same as above, with a handle to const.
+  const_locked_ptr try_lock() const {
+    if (!storage_.mutex_.try_lock())
+      return const_locked_ptr{nullptr, nullptr};
+    return const_locked_ptr{&storage_.value(), &storage_.mutex_};
+  }
+
+private:
+  detail::spin_guarded_storage<T, Mutex, Layout> storage_;
+};
+
+} // end namespace amz
+
+#endif // include guard
@@ -0,0 +1,391 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_TIMER_WHEEL_HPP
+#define AMZ_TIMER_WHEEL_HPP
+
+#include <amz/detail/bits.hpp>
+
+#include <boost/intrusive/link_mode.hpp>
+#include <boost/intrusive/list.hpp>
+#include <boost/intrusive/options.hpp>
+#include <boost/optional.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+
+namespace amz {
+
+template <typename T, typename Clock>
+class timer_wheel;
+
+//! Base class for objects that can be scheduled in a `timer_wheel`.
+//!
+//! Timers are intrusive: the wheel does not own them, and does not allocate
+//! anything to schedule them. A timer must outlive its membership in the
+//! wheel, however destroying a scheduled timer is fine: it is automatically
+//! cancelled.
+class timer_wheel_hook
+  : public boost::intrusive::list_base_hook<
+      boost::intrusive::link_mode<boost::intrusive::auto_unlink>
+    >
+{
+public:
+  //! Cancels the timer if it is scheduled, and does nothing otherwise.
+  //!
+  //! This is O(1) and does not require access to the wheel.
+  void cancel() noexcept { this->unlink(); }
+
+  //! Returns whether the timer is currently scheduled in a wheel.
+  bool is_scheduled() const noexcept { return this->is_linked(); }
+
+private:
+  template <typename, typename>
+  friend class timer_wheel;
+
+  std::uint64_t expiry_ = 0; // in ticks since the origin of the wheel
+};
+
+//! Hierarchical timer wheel for scheduling large numbers of timeouts.
+//!
+//! A timer wheel schedules timers (objects of a type `T` deriving from
+//! `timer_wheel_hook`) to expire at given deadlines, with O(1) scheduling and
+//! cancellation. Time is divided in _ticks_ of a fixed resolution, and the
+//! wheel never moves forward on its own: expired timers are only collected
+//! when `advance(now, f)` is called, which makes it easy to embed the wheel in
+//! an event loop (or any component that already has a notion of time
+//! passing, like the `purge()` of `deferred_reclamation_allocator`).
+//!
+//! Timers are never fired early: a timer scheduled with deadline `d` is fired
+//! by the first call to `advance(now, f)` such that `now >= d`. However,
+//! deadlines are rounded up to the next tick, so a timer may fire up to one
+//! tick late with respect to the time passed to `advance`.
+//!
+//! Implementation notes
+//! ====================
+//! The wheel is made of 4 levels of 256 slots each. Level `L` covers ticks in
+//! units of `256^L` ticks, so the wheel spans `2^32` ticks before spilling to
+//! an overflow list (for example, about 50 days with a resolution of 1ms).
+//! A timer is put in the lowest level whose horizon contains its deadline.
+//! When the current tick reaches the range covered by a slot at level `L > 0`,
+//! the timers of that slot are redistributed (cascaded) to lower levels, so
+//! each timer is moved at most 4 times during its lifetime. A bitmap of the
+//! occupied slots is maintained for each level, so that `advance` can jump
+//! directly to the next tick at which something happens instead of visiting
+//! every tick.
+template <typename T, typename Clock = std::chrono::steady_clock>
+class timer_wheel {
+  static_assert(std::is_base_of<timer_wheel_hook, T>::value,
+    "The type of timers scheduled in a timer_wheel must derive from timer_wheel_hook.");
+
+public:
+  using clock = Clock;
+  using duration = typename Clock::duration;
+  using time_point = typename Clock::time_point;
+
+  //! Creates a wheel with the given tick resolution, whose time starts at
+  //! `origin`.
+  //!
+  //! The resolution must be positive.
+  explicit timer_wheel(duration resolution, time_point origin = Clock::now());
+
+  timer_wheel(timer_wheel const&) = delete;
+  timer_wheel& operator=(timer_wheel const&) = delete;
+
+  //! Cancels all the timers that are still scheduled in the wheel.
+  ~timer_wheel() { clear(); }
+
+  //! Schedules a timer to expire at the given deadline.
+  //!
+  //! The timer must not already be scheduled. If the deadline is not later
+  //! than the current time of the wheel (see `now()`), the timer will be
+  //! fired on the next call to `advance`.
+  void schedule(T& timer, time_point deadline);
+
+  //! Schedules a timer to expire after the given delay, relative to the
+  //! current time of the wheel.
+  void schedule_after(T& timer, duration delay) { schedule(timer, now() + delay); }
+
+  //! Moves the wheel forward to `now`, and calls `f(timer)` for each timer
+  //! whose deadline is not later than `now`. Returns the number of timers that
+  //! were fired.
+  //!
+  //! Expired timers are collected in a batch before any callback is called,
+  //! and are then fired in order of deadline. Each timer is unscheduled right
+  //! before it is passed to `f`, so `f` may reschedule it (or destroy it).
+  //! `f` may also schedule or cancel other timers; timers scheduled from `f`
+  //! with a deadline not later than `now` are fired on the next call to
+  //! `advance`, and timers of the current batch that are cancelled from `f`
+  //! are not fired.
+  //!
+  //! If `now` is earlier than the current time of the wheel, only the timers
+  //! scheduled with deadlines in the past are fired.
+  template <typename F>
+  std::size_t advance(time_point now, F&& f);
+
+  //! Returns the current time of the wheel, i.e. the time of the last tick
+  //! processed by `advance`.
+  time_point now() const { return time_at(current_); }
+
+  //! Returns the earliest time at which a call to `advance` may fire a timer,
+  //! or `boost::none` if the wheel is empty.
+  //!
+  //! This is a lower bound suitable for deciding how long an event loop can
+  //! sleep: timers scheduled in the higher levels of the wheel are only
+  //! examined precisely when they are cascaded, and cancelled timers are only
+  //! noticed lazily, so `advance` may fire no timers at the returned time.
+  boost::optional<time_point> next_expiry() const;
+
+  //! Cancels all the timers scheduled in the wheel.
+  void clear() noexcept;
+
+private:
+  using list_type = boost::intrusive::list<T, boost::intrusive::constant_time_size<false>>;
+
+  static constexpr unsigned levels = 4;
+  static constexpr unsigned slot_bits = 8;
+  static constexpr unsigned slots_per_level = 1u << slot_bits;
+  static constexpr unsigned words_per_level = slots_per_level / 64;
+  static constexpr std::uint64_t never = std::numeric_limits<std::uint64_t>::max();
+
+  struct level {
+    std::array<list_type, slots_per_level> slots;
+    std::array<std::uint64_t, words_per_level> occupied{};
+  };
+
+  duration const resolution_;
+  time_point const origin_;
+  std::uint64_t current_; // all the ticks up to and including this one have been processed
+  std::array<level, levels> levels_;
+  list_type overflow_;    // timers beyond the horizon of the last level
+  list_type expired_;     // timers scheduled with a deadline that was already reached
+
+  // Returns the tick at which a timer with the given deadline must fire,
+  // rounding up so timers are never fired early.
+  std::uint64_t tick_for(time_point deadline) const;
+
+  // Returns the last tick that is entirely elapsed at time `now`.
+  std::uint64_t elapsed_ticks(time_point now) const;
+
+  time_point time_at(std::uint64_t tick) const {
+    return origin_ + resolution_ * static_cast<typename duration::rep>(tick);
+  }
+
+  // Puts a timer expiring at `timer.expiry_ > current_` in the right slot.
+  void insert(T& timer);
+
+  // Returns the smallest tick after `current_` at which a slot needs to be
+  // fired or cascaded, or `never` if there is no such tick.
+  std::uint64_t next_event() const;
+
+  // Returns the first occupied slot at `lvl` in the cyclic order starting at
+  // `from`, or `slots_per_level` if there is none.
+  unsigned next_occupied(level const& lvl, unsigned from) const;
+
+  // Redistributes the timers of a list according to the current tick. Timers
+  // may be put back in the same list (for the overflow list).
+  void cascade(list_type& timers);
+
+  static unsigned slot_index(std::uint64_t tick, unsigned lvl) {
+    return static_cast<unsigned>(tick >> (slot_bits * lvl)) & (slots_per_level - 1);
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Timer wheel implementation
+//////////////////////////////////////////////////////////////////////////////
+template <typename T, typename Clock>
+timer_wheel<T, Clock>::timer_wheel(duration resolution, time_point origin)
+  : resolution_{resolution}
+  , origin_{origin}
+  , current_{0}
+  , levels_{}
+  , overflow_{}
+  , expired_{}
+{
+  assert(resolution > duration::zero() && "the resolution of a timer_wheel must be positive");
+}
+
+template <typename T, typename Clock>
+std::uint64_t timer_wheel<T, Clock>::tick_for(time_point deadline) const {
+  if (deadline <= origin_)
+    return 0;
+  auto const elapsed = deadline - origin_;
+  auto const ticks = elapsed / resolution_;
+  return static_cast<std::uint64_t>(ticks) + (elapsed % resolution_ != duration::zero() ? 1 : 0);
+}
+
+template <typename T, typename Clock>
+std::uint64_t timer_wheel<T, Clock>::elapsed_ticks(time_point now) const {
+  if (now <= origin_)
+    return 0;
+  return static_cast<std::uint64_t>((now - origin_) / resolution_);
+}
+
+template <typename T, typename Clock>
+void timer_wheel<T, Clock>::schedule(T& timer, time_point deadline) {
+  assert(!timer.is_scheduled() && "scheduling a timer that is already scheduled");
+  timer.expiry_ = tick_for(deadline);
+  if (timer.expiry_ <= current_)
+    expired_.push_back(timer);
+  else
+    insert(timer);
+}
+
+template <typename T, typename Clock>
+void timer_wheel<T, Clock>::insert(T& timer) {
+  assert(timer.expiry_ > current_);
+  for (unsigned lvl = 0; lvl != levels; ++lvl) {
+    unsigned const shift = slot_bits * lvl;
+    if ((timer.expiry_ >> shift) - (current_ >> shift) < slots_per_level) {
+      unsigned const slot = slot_index(timer.expiry_, lvl);
+      levels_[lvl].slots[slot].push_back(timer);
+      levels_[lvl].occupied[slot / 64] |= std::uint64_t{1} << (slot % 64);
+      return;
+    }
+  }
+  overflow_.push_back(timer);
+}
+
+template <typename T, typename Clock>
+unsigned timer_wheel<T, Clock>::next_occupied(level const& lvl, unsigned from) const {
+  from %= slots_per_level;
+  for (unsigned i = 0; i <= words_per_level; ++i) {
+    unsigned const w = (from / 64 + i) % words_per_level;
+    std::uint64_t word = lvl.occupied[w];
+    if (i == 0)
+      word &= ~std::uint64_t{0} << (from % 64);                      // bits at or after `from`
+    else if (i == words_per_level)
+      word &= (std::uint64_t{1} << (from % 64)) - 1;                 // wrapped around: bits before `from`
+    if (word != 0)
+      return w * 64 + detail::count_trailing_zeros(word);
+  }
+  return slots_per_level;
+}
+
+template <typename T, typename Clock>
+std::uint64_t timer_wheel<T, Clock>::next_event() const {
+  std::uint64_t next = never;
+  for (unsigned lvl = 0; lvl != levels; ++lvl) {
+    unsigned const shift = slot_bits * lvl;
+    std::uint64_t const position = current_ >> shift;
+    unsigned const current_slot = slot_index(current_, lvl);
+    unsigned const slot = next_occupied(levels_[lvl], current_slot + 1);
+    if (slot == slots_per_level)
+      continue;
+
+    // The slot covers the next `position` whose low bits are `slot`. A slot
+    // at level 0 fires at that tick, and a slot at a higher level is cascaded
+    // at the first tick of the range it covers.
+    std::uint64_t target = (position & ~std::uint64_t{slots_per_level - 1}) + slot;
+    if (slot <= current_slot)
+      target += slots_per_level;
+    next = std::min(next, target << shift);
+  }
+  if (!overflow_.empty()) {
+    unsigned const shift = slot_bits * levels;
+    next = std::min(next, ((current_ >> shift) + 1) << shift);
+  }
+  return next;
+}
+
+template <typename T, typename Clock>
+void timer_wheel<T, Clock>::cascade(list_type& timers) {
+  list_type pending;
+  pending.splice(pending.end(), timers);
+  while (!pending.empty()) {
+    T& timer = pending.front();
+    pending.pop_front();
+    if (timer.expiry_ <= current_)
+      expired_.push_back(timer);
+    else
+      insert(timer);
+  }
+}
+
+template <typename T, typename Clock>
+template <typename F>
+std::size_t timer_wheel<T, Clock>::advance(time_point now, F&& f) {
+  std::uint64_t const target = elapsed_ticks(now);
+  list_type batch;
+  batch.splice(batch.end(), expired_);
+
+  while (current_ < target) {
+    std::uint64_t const next = next_event();
+    if (next > target) {
+      current_ = target;
+      break;
+    }
+    current_ = next;
+
+    // Cascade the slots covering the new tick, from the highest level down,
+    // so timers trickle down to the level where they are fired.
+    unsigned const overflow_shift = slot_bits * levels;
+    if ((current_ & ((std::uint64_t{1} << overflow_shift) - 1)) == 0)
+      cascade(overflow_);
+    for (unsigned lvl = levels - 1; lvl != 0; --lvl) {
+      if ((current_ & ((std::uint64_t{1} << (slot_bits * lvl)) - 1)) != 0)
+        continue;
+      unsigned const slot = slot_index(current_, lvl);
+      levels_[lvl].occupied[slot / 64] &= ~(std::uint64_t{1} << (slot % 64));
+      cascade(levels_[lvl].slots[slot]);
+    }
+
+    unsigned const slot = slot_index(current_, 0);
+    levels_[0].occupied[slot / 64] &= ~(std::uint64_t{1} << (slot % 64));
+    batch.splice(batch.end(), levels_[0].slots[slot]);
+    batch.splice(batch.end(), expired_); // timers cascaded with a deadline at the current tick
+  }
+
+  std::size_t fired = 0;
+  while (!batch.empty()) {
+    T& timer = batch.front();
+    batch.pop_front();
+    ++fired;
+    f(timer);
+  }
+  return fired;
+}
+
+template <typename T, typename Clock>
+boost::optional<typename timer_wheel<T, Clock>::time_point>
+timer_wheel<T, Clock>::next_expiry() const {
+  if (!expired_.empty())
+    return now();
+  std::uint64_t const next = next_event();
+  if (next == never)
+    return boost::none;
+  return time_at(next);
+}
+
+template <typename T, typename Clock>
+void timer_wheel<T, Clock>::clear() noexcept {
+  for (level& lvl : levels_) {
+    for (list_type& slot : lvl.slots)
+      slot.clear();
+    lvl.occupied.fill(0);
+  }
+  overflow_.clear();
+  expired_.clear();
+}
+
+} // end namespace amz
+
+#endif // include guard
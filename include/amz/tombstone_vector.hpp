@@ -0,0 +1,336 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_TOMBSTONE_VECTOR_HPP
+#define AMZ_TOMBSTONE_VECTOR_HPP
+
+#include <amz/algorithm/remove_and_copy_if.hpp>
+#include <amz/detail/bits.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace amz {
+
+namespace detail {
+  // OutputIterator that ignores everything that is assigned to it.
+  struct discard_iterator {
+    using iterator_category = std::output_iterator_tag;
+    using value_type = void;
+    using difference_type = void;
+    using pointer = void;
+    using reference = void;
+
+    template <typename T>
+    discard_iterator& operator=(T&&) noexcept { return *this; }
+    discard_iterator& operator*() noexcept { return *this; }
+    discard_iterator& operator++() noexcept { return *this; }
+    discard_iterator& operator++(int) noexcept { return *this; }
+  };
+} // end namespace detail
+
+//! Sequence container with O(1) erasure of arbitrary elements and lazy
+//! batch compaction.
+//!
+//! Erasing an element from the middle of a `std::vector` is O(n), because all
+//! the following elements must be shifted. When many single-element erasures
+//! are interleaved with scans, this quickly dominates. Instead, a
+//! `tombstone_vector` marks erased elements in a side bitmap (the element is
+//! said to be _tombstoned_) and skips them during iteration, scanning the
+//! bitmap one word at a time so that runs of tombstones are skipped quickly.
+//! Elements remain contiguous in memory, so scans stay cache friendly.
+//!
+//! Tombstoned elements are physically removed in a single pass (a
+//! _compaction_) once the ratio of tombstones to stored elements exceeds a
+//! threshold given at construction. Compaction is order-preserving, and is
+//! done with `amz::remove_and_copy_if` using a predicate that looks up the
+//! position of each element in the bitmap. Since at least
+//! `threshold * n` erasures must happen between two compactions of a vector
+//! holding `n` elements, erasure is O(1) amortized.
+//!
+//! Compaction can also be requested explicitly with `compact()`, which can
+//! optionally move the tombstoned elements out to an OutputIterator before
+//! they are destroyed.
+//!
+//! Notes
+//! =====
+//! - Tombstoned elements are not destroyed when they are erased; they are
+//!   destroyed when the vector is compacted, cleared or destroyed.
+//! - Iterators are stable across `push_back` and `emplace_back` (they do not
+//!   point to elements directly), and across `erase` unless the erasure
+//!   triggers a compaction. Any compaction invalidates all iterators.
+//! - Moving an element must not throw during compaction; otherwise the
+//!   contents of the vector are unspecified.
+template <typename T, typename Allocator = std::allocator<T>>
+class tombstone_vector {
+  using Storage = std::vector<T, Allocator>;
+  using Bitmap = std::vector<std::uint64_t>;
+  static constexpr std::size_t bits_per_word = 64;
+
+  template <bool Const>
+  class basic_iterator;
+
+public:
+  using value_type = T;
+  using allocator_type = Allocator;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = value_type&;
+  using const_reference = value_type const&;
+  using iterator = basic_iterator<false>;
+  using const_iterator = basic_iterator<true>;
+
+  //! Creates an empty `tombstone_vector` that compacts itself whenever the
+  //! ratio of tombstones to stored elements exceeds `max_tombstone_ratio`.
+  //!
+  //! `max_tombstone_ratio` must be in `(0, 1]`. A higher ratio means fewer
+  //! compactions, at the cost of more memory and longer scans.
+  explicit tombstone_vector(double max_tombstone_ratio = 0.5,
+                            Allocator const& allocator = Allocator{})
+    : elements_(allocator)
+    , dead_{}
+    , tombstones_{0}
+    , max_tombstone_ratio_{max_tombstone_ratio}
+  {
+    assert(max_tombstone_ratio > 0 && max_tombstone_ratio <= 1);
+  }
+
+  //! Returns the number of elements in the vector, not counting tombstones.
+  size_type size() const noexcept { return elements_.size() - tombstones_; }
+
+  //! Returns whether the vector contains no elements other than tombstones.
+  bool empty() const noexcept { return size() == 0; }
+
+  //! Returns the number of tombstoned elements awaiting compaction.
+  size_type tombstones() const noexcept { return tombstones_; }
+
+  //! Reserves storage for at least `n` elements, including tombstones.
+  void reserve(size_type n) {
+    elements_.reserve(n);
+    dead_.reserve(words_for(n));
+  }
+
+  //! Appends an element at the end of the vector.
+  void push_back(value_type const& value) { emplace_back(value); }
+  void push_back(value_type&& value) { emplace_back(std::move(value)); }
+
+  //! Constructs an element in place at the end of the vector.
+  template <typename ...Args>
+  reference emplace_back(Args&& ...args) {
+    if (elements_.size() == dead_.size() * bits_per_word)
+      dead_.push_back(0);
+    elements_.emplace_back(std::forward<Args>(args)...);
+    return elements_.back();
+  }
+
+  //! Erases the element pointed to by `pos` and returns an iterator to the
+  //! element following it.
+  //!
+  //! The element is tombstoned, and the vector is compacted if the ratio of
+  //! tombstones to stored elements exceeds the threshold given at construction.
+  //! In that case, the returned iterator is valid but all other iterators are
+  //! invalidated.
+  //!
+  //! The behavior is undefined if `pos` is not a dereferenceable iterator into
+  //! this vector.
+  iterator erase(const_iterator pos) {
+    size_type const i = pos.index_;
+    assert(pos.vector_ == this && i < elements_.size() && !is_dead(i) &&
+           "trying to erase an element that is not in the vector");
+    dead_[i / bits_per_word] |= std::uint64_t{1} << (i % bits_per_word);
+    ++tombstones_;
+
+    size_type const next = next_live(i + 1);
+    if (tombstones_ > max_tombstone_ratio_ * elements_.size()) {
+      size_type const rank = next - dead_before(next);
+      compact();
+      return iterator{this, rank};
+    }
+    return iterator{this, next};
+  }
+
+  //! Physically removes all the tombstoned elements from the vector.
+  //!
+  //! Relative order of the remaining elements is preserved. This invalidates
+  //! all iterators into the vector.
+  void compact() { compact(detail::discard_iterator{}); }
+
+  //! Physically removes all the tombstoned elements from the vector, moving
+  //! them to the given OutputIterator (in the order in which they appeared
+  //! in the vector) before they are destroyed.
+  //!
+  //! Relative order of the remaining elements is preserved. This invalidates
+  //! all iterators into the vector. Returns an OutputIterator to
+  //! one-past-the-last element that was moved to the output range.
+  template <typename OutputIterator>
+  OutputIterator compact(OutputIterator removed) {
+    if (tombstones_ == 0)
+      return removed;
+
+    // The predicate is applied to each element at its original position, so
+    // its index can be recovered from its address. Elements before the first
+    // tombstone are already in place, so they are skipped.
+    T const* const data = elements_.data();
+    auto const is_tombstone = [this, data](T const& element) {
+      return this->is_dead(static_cast<size_type>(std::addressof(element) - data));
+    };
+    auto const result = amz::remove_and_copy_if(elements_.begin() + next_dead(0), elements_.end(),
+                                                removed, is_tombstone);
+
+    elements_.erase(result.first, elements_.end());
+    dead_.assign(words_for(elements_.size()), 0);
+    tombstones_ = 0;
+    return result.second;
+  }
+
+  //! Destroys all the elements in the vector, including tombstones.
+  void clear() noexcept {
+    elements_.clear();
+    dead_.clear();
+    tombstones_ = 0;
+  }
+
+  iterator begin() noexcept { return iterator{this, next_live(0)}; }
+  iterator end() noexcept { return iterator{this, elements_.size()}; }
+  const_iterator begin() const noexcept { return const_iterator{this, next_live(0)}; }
+  const_iterator end() const noexcept { return const_iterator{this, elements_.size()}; }
+  const_iterator cbegin() const noexcept { return begin(); }
+  const_iterator cend() const noexcept { return end(); }
+
+private:
+  Storage elements_;
+  Bitmap dead_; // bit `i` is set iff `elements_[i]` is a tombstone
+  size_type tombstones_;
+  double max_tombstone_ratio_;
+
+  static size_type words_for(size_type n) noexcept {
+    return (n + bits_per_word - 1) / bits_per_word;
+  }
+
+  bool is_dead(size_type i) const noexcept {
+    return (dead_[i / bits_per_word] >> (i % bits_per_word)) & 1;
+  }
+
+  // Returns the index of the first live element at or after `i`, or the
+  // number of stored elements if there is none. This skips a whole word of
+  // tombstones at a time.
+  size_type next_live(size_type i) const noexcept {
+    size_type const n = elements_.size();
+    if (tombstones_ == 0)
+      return std::min(i, n);
+    return next_bit(i, n, ~std::uint64_t{0});
+  }
+
+  // Returns the index of the first tombstone at or after `i`, or the number
+  // of stored elements if there is none.
+  size_type next_dead(size_type i) const noexcept {
+    return next_bit(i, elements_.size(), 0);
+  }
+
+  // Returns the index of the first bit at or after `i` that is set in the
+  // bitmap after XOR-ing each word with `flip`, or `n` if there is none.
+  size_type next_bit(size_type i, size_type n, std::uint64_t flip) const noexcept {
+    while (i < n) {
+      size_type const w = i / bits_per_word;
+      std::uint64_t const word = (dead_[w] ^ flip) & (~std::uint64_t{0} << (i % bits_per_word));
+      if (word != 0)
+        return std::min(w * bits_per_word + detail::count_trailing_zeros(word), n);
+      i = (w + 1) * bits_per_word;
+    }
+    return n;
+  }
+
+  // Returns the number of tombstones before index `i`.
+  size_type dead_before(size_type i) const noexcept {
+    size_type count = 0;
+    size_type const full_words = i / bits_per_word;
+    for (size_type w = 0; w != full_words; ++w)
+      count += detail::popcount(dead_[w]);
+    if (i % bits_per_word != 0)
+      count += detail::popcount(dead_[full_words] & ((std::uint64_t{1} << (i % bits_per_word)) - 1));
+    return count;
+  }
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// Iterator implementation
+//////////////////////////////////////////////////////////////////////////////
+template <typename T, typename Allocator>
+template <bool Const>
+class tombstone_vector<T, Allocator>::basic_iterator {
+  using Vector = std::conditional_t<Const, tombstone_vector const, tombstone_vector>;
+  friend class tombstone_vector;
+
+  Vector* vector_;
+  size_type index_;
+
+  basic_iterator(Vector* vector, size_type index) noexcept
+    : vector_{vector}, index_{index}
+  { }
+
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using difference_type = std::ptrdiff_t;
+  using value_type = T;
+  using pointer = std::conditional_t<Const, T const*, T*>;
+  using reference = std::conditional_t<Const, T const&, T&>;
+
+  basic_iterator() noexcept : vector_{nullptr}, index_{0} { }
+
+  // Allow converting an `iterator` to a `const_iterator`.
+  template <bool OtherConst, typename = std::enable_if_t<Const && !OtherConst>>
+  basic_iterator(basic_iterator<OtherConst> const& other) noexcept
+    : vector_{other.vector_}, index_{other.index_}
+  { }
+
+  reference operator*() const noexcept {
+    assert(index_ < vector_->elements_.size() && !vector_->is_dead(index_));
+    return vector_->elements_[index_];
+  }
+
+  pointer operator->() const noexcept { return std::addressof(**this); }
+
+  basic_iterator& operator++() noexcept {
+    index_ = vector_->next_live(index_ + 1);
+    return *this;
+  }
+
+  basic_iterator operator++(int) noexcept {
+    basic_iterator copy = *this;
+    ++*this;
+    return copy;
+  }
+
+  friend bool operator==(basic_iterator const& a, basic_iterator const& b) noexcept {
+    return a.index_ == b.index_;
+  }
+
+  friend bool operator!=(basic_iterator const& a, basic_iterator const& b) noexcept {
+    return !(a == b);
+  }
+
+  template <bool>
+  friend class basic_iterator;
+};
+
+} // end namespace amz
+
+#endif // include guard
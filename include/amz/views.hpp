@@ -0,0 +1,410 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#ifndef AMZ_VIEWS_HPP
+#define AMZ_VIEWS_HPP
+
+#include <boost/optional.hpp>
+#include <boost/range/iterator_range.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+
+namespace amz {
+
+namespace detail {
+  // Type used to cache the result of dereferencing an `Iterator`. When
+  // dereferencing yields an lvalue that is guaranteed to outlive the iterator
+  // (i.e. for ForwardIterators), we only keep a reference to it. Otherwise,
+  // we keep the value itself, since the reference may point inside the
+  // iterator (e.g. `std::istream_iterator`).
+  template <typename Iterator, typename Reference = typename std::iterator_traits<Iterator>::reference>
+  using deref_cache_t = boost::optional<std::conditional_t<
+    std::is_lvalue_reference<Reference>::value &&
+      std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category>::value,
+    Reference,
+    std::remove_cv_t<std::remove_reference_t<Reference>>
+  >>;
+
+  // Holds a function object, and makes it CopyAssignable even when the
+  // function object itself is not (which is the case of lambdas).
+  template <typename F>
+  class copyable_box {
+    boost::optional<F> f_;
+
+  public:
+    copyable_box() = default;
+    explicit copyable_box(F const& f) : f_{f} { }
+    copyable_box(copyable_box const&) = default;
+    copyable_box& operator=(copyable_box const& other) {
+      if (this != &other) {
+        f_ = boost::none;
+        if (other.f_)
+          f_.emplace(*other.f_);
+      }
+      return *this;
+    }
+
+    F const& get() const noexcept {
+      assert(f_);
+      return *f_;
+    }
+  };
+
+  // The category of a view iterator adapting `Iterator`. Since view
+  // iterators return a reference to their cached element, they can only be
+  // ForwardIterators when the adapted iterator returns actual references.
+  template <typename Iterator>
+  using view_iterator_category_t = std::conditional_t<
+    std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category>::value &&
+      std::is_lvalue_reference<typename std::iterator_traits<Iterator>::reference>::value,
+    std::forward_iterator_tag,
+    std::input_iterator_tag
+  >;
+
+  template <typename Range>
+  auto range_begin(Range&& r) { using std::begin; return begin(r); }
+  template <typename Range>
+  auto range_end(Range&& r) { using std::end; return end(r); }
+} // end namespace detail
+
+namespace views {
+
+// Iterator of the view returned by `amz::views::take_while`.
+//
+// This iterator caches the result of dereferencing the underlying iterator,
+// and applies the predicate to the cached element. Iterating over the prefix
+// of length `n` satisfying the predicate (and then reaching the end of the
+// view) hence does exactly `n` increments and at most `n+1` dereferences of
+// the underlying iterator, and at most `n+1` applications of the predicate.
+// These are the same guarantees as `amz::copy_while`.
+template <typename Iterator, typename Predicate>
+class take_while_iterator {
+  using Traits = std::iterator_traits<Iterator>;
+
+public:
+  using iterator_category = detail::view_iterator_category_t<Iterator>;
+  using value_type = typename Traits::value_type;
+  using difference_type = typename Traits::difference_type;
+  using reference = std::remove_reference_t<typename Traits::reference>&;
+  using pointer = std::remove_reference_t<typename Traits::reference>*;
+
+  take_while_iterator() = default;
+
+  take_while_iterator(Iterator first, Iterator last, Predicate const& pred)
+    : current_{first}, last_{last}, pred_{pred}, cache_{}, done_{false}
+  { satisfy(); }
+
+  // Creates a past-the-end iterator.
+  take_while_iterator(Iterator last, Predicate const& pred)
+    : current_{last}, last_{last}, pred_{pred}, cache_{}, done_{true}
+  { }
+
+  // Returns the underlying iterator. When this iterator is past-the-end,
+  // this is the first element of the underlying range that did not satisfy
+  // the predicate (or the end of the underlying range).
+  Iterator const& base() const noexcept { return current_; }
+
+  reference operator*() const {
+    assert(!done_ && "dereferencing a past-the-end take_while iterator");
+    return *cache_;
+  }
+
+  pointer operator->() const { return std::addressof(**this); }
+
+  take_while_iterator& operator++() {
+    assert(!done_ && "incrementing a past-the-end take_while iterator");
+    ++current_;
+    satisfy();
+    return *this;
+  }
+
+  take_while_iterator operator++(int) {
+    take_while_iterator copy = *this;
+    ++*this;
+    return copy;
+  }
+
+  friend bool operator==(take_while_iterator const& a, take_while_iterator const& b) {
+    return a.done_ || b.done_ ? a.done_ == b.done_ : a.current_ == b.current_;
+  }
+
+  friend bool operator!=(take_while_iterator const& a, take_while_iterator const& b) {
+    return !(a == b);
+  }
+
+private:
+  Iterator current_;
+  Iterator last_;
+  detail::copyable_box<Predicate> pred_;
+  mutable detail::deref_cache_t<Iterator> cache_;
+  bool done_;
+
+  void satisfy() {
+    if (current_ == last_) {
+      done_ = true;
+      return;
+    }
+    cache_ = typename detail::deref_cache_t<Iterator>::value_type(*current_);
+    if (!pred_.get()(*cache_))
+      done_ = true;
+  }
+};
+
+// Iterator of the view returned by `amz::views::filter`.
+//
+// This iterator caches the result of dereferencing the underlying iterator,
+// and applies the predicate to the cached element. Iterating over a range of
+// length `n` hence does exactly `n` increments and `n` dereferences of the
+// underlying iterator, and exactly `n` applications of the predicate.
+template <typename Iterator, typename Predicate>
+class filter_iterator {
+  using Traits = std::iterator_traits<Iterator>;
+
+public:
+  using iterator_category = detail::view_iterator_category_t<Iterator>;
+  using value_type = typename Traits::value_type;
+  using difference_type = typename Traits::difference_type;
+  using reference = std::remove_reference_t<typename Traits::reference>&;
+  using pointer = std::remove_reference_t<typename Traits::reference>*;
+
+  filter_iterator() = default;
+
+  filter_iterator(Iterator first, Iterator last, Predicate const& pred)
+    : current_{first}, last_{last}, pred_{pred}, cache_{}
+  { satisfy(); }
+
+  Iterator const& base() const noexcept { return current_; }
+
+  reference operator*() const {
+    assert(current_ != last_ && "dereferencing a past-the-end filter iterator");
+    return *cache_;
+  }
+
+  pointer operator->() const { return std::addressof(**this); }
+
+  filter_iterator& operator++() {
+    assert(current_ != last_ && "incrementing a past-the-end filter iterator");
+    ++current_;
+    satisfy();
+    return *this;
+  }
+
+  filter_iterator operator++(int) {
+    filter_iterator copy = *this;
+    ++*this;
+    return copy;
+  }
+
+  friend bool operator==(filter_iterator const& a, filter_iterator const& b) {
+    return a.current_ == b.current_;
+  }
+
+  friend bool operator!=(filter_iterator const& a, filter_iterator const& b) {
+    return !(a == b);
+  }
+
+private:
+  Iterator current_;
+  Iterator last_;
+  detail::copyable_box<Predicate> pred_;
+  mutable detail::deref_cache_t<Iterator> cache_;
+
+  void satisfy() {
+    for (; current_ != last_; ++current_) {
+      cache_ = typename detail::deref_cache_t<Iterator>::value_type(*current_);
+      if (pred_.get()(*cache_))
+        return;
+    }
+  }
+};
+
+// Iterator of the views returned by `amz::views::group_by` and
+// `amz::views::chunk_by`.
+//
+// Dereferencing this iterator yields a `boost::iterator_range` over a
+// sub-range of consecutive equivalent elements of the underlying range. When
+// `Adjacent` is false, an element belongs to the current sub-range if it is
+// equivalent to the first element of the sub-range (like `amz::remove_range_if`).
+// When `Adjacent` is true, an element belongs to the current sub-range if it
+// is equivalent to the element right before it.
+//
+// Finding each sub-range dereferences each element of the underlying range
+// exactly once, and applies the equivalence relation once per element (minus
+// one per sub-range). Although this iterator returns sub-ranges by value and
+// is hence classified as an InputIterator, it supports multiple passes.
+template <typename ForwardIterator, typename EquivalenceRelation, bool Adjacent>
+class group_iterator {
+public:
+  using iterator_category = std::input_iterator_tag;
+  using value_type = boost::iterator_range<ForwardIterator>;
+  using difference_type = typename std::iterator_traits<ForwardIterator>::difference_type;
+  using reference = value_type;
+  using pointer = void;
+
+  group_iterator() = default;
+
+  group_iterator(ForwardIterator first, ForwardIterator last, EquivalenceRelation const& equivalent)
+    : first_{first}, next_{first}, last_{last}, equivalent_{equivalent}, head_{}
+  {
+    if (first_ != last_)
+      head_ = typename Cache::value_type(*first_);
+    find_next();
+  }
+
+  reference operator*() const {
+    assert(first_ != last_ && "dereferencing a past-the-end group iterator");
+    return value_type{first_, next_};
+  }
+
+  group_iterator& operator++() {
+    assert(first_ != last_ && "incrementing a past-the-end group iterator");
+    first_ = next_;
+    find_next();
+    return *this;
+  }
+
+  group_iterator operator++(int) {
+    group_iterator copy = *this;
+    ++*this;
+    return copy;
+  }
+
+  friend bool operator==(group_iterator const& a, group_iterator const& b) {
+    return a.first_ == b.first_;
+  }
+
+  friend bool operator!=(group_iterator const& a, group_iterator const& b) {
+    return !(a == b);
+  }
+
+private:
+  using Cache = detail::deref_cache_t<ForwardIterator>;
+  ForwardIterator first_; // beginning of the current sub-range
+  ForwardIterator next_;  // end of the current sub-range
+  ForwardIterator last_;
+  detail::copyable_box<EquivalenceRelation> equivalent_;
+  Cache head_; // cached `*first_`, carried over from the previous sub-range
+
+  void find_next() {
+    next_ = first_;
+    if (next_ == last_)
+      return;
+
+    Cache previous = head_;
+    for (++next_; next_ != last_; ++next_) {
+      Cache current{typename Cache::value_type(*next_)};
+      if (!equivalent_.get()(*previous, *current)) {
+        head_ = std::move(current);
+        return;
+      }
+      if (Adjacent)
+        previous = std::move(current);
+    }
+  }
+};
+
+// Lazy view over the longest prefix of `[first, last)` whose elements satisfy
+// `pred`.
+//
+// This is the lazy equivalent of `amz::copy_while`. It does not copy anything;
+// elements are produced on demand while iterating over the view, which allows
+// chaining several views without intermediate buffers. The view provides the
+// same guarantees as `amz::copy_while` regarding the number of dereferences
+// and increments of the underlying iterator (see `take_while_iterator`).
+//
+// The returned view is a `boost::iterator_range`, and it refers to the
+// underlying range without owning it. Hence, the underlying range must outlive
+// the view (and any iterator obtained from it). The predicate is copied into
+// the view's iterators.
+template <typename InputIterator, typename Predicate>
+boost::iterator_range<take_while_iterator<InputIterator, Predicate>>
+take_while(InputIterator first, InputIterator last, Predicate pred) {
+  using Iterator = take_while_iterator<InputIterator, Predicate>;
+  return {Iterator{first, last, pred}, Iterator{last, pred}};
+}
+
+template <typename Range, typename Predicate>
+auto take_while(Range&& range, Predicate pred) {
+  return views::take_while(detail::range_begin(range), detail::range_end(range), pred);
+}
+
+// Lazy view over the elements of `[first, last)` that satisfy `pred`.
+//
+// This is the lazy equivalent of `std::copy_if` (or of the elements that are
+// kept by `amz::remove_and_copy_if` when the predicate is negated). Each
+// element of the underlying range is dereferenced exactly once and `pred` is
+// applied exactly once to each element (see `filter_iterator`).
+//
+// The same lifetime considerations as for `amz::views::take_while` apply.
+template <typename InputIterator, typename Predicate>
+boost::iterator_range<filter_iterator<InputIterator, Predicate>>
+filter(InputIterator first, InputIterator last, Predicate pred) {
+  using Iterator = filter_iterator<InputIterator, Predicate>;
+  return {Iterator{first, last, pred}, Iterator{last, last, pred}};
+}
+
+template <typename Range, typename Predicate>
+auto filter(Range&& range, Predicate pred) {
+  return views::filter(detail::range_begin(range), detail::range_end(range), pred);
+}
+
+// Lazy view over the largest sub-ranges of `[first, last)` whose elements
+// are equivalent to the first element of the sub-range, as determined by
+// `equivalent`.
+//
+// The sub-ranges are the same as the ones considered by `amz::remove_range_if`,
+// and `equivalent` must likewise be an equivalence relation. Each element of
+// the view is a `boost::iterator_range` over the underlying range.
+//
+// The same lifetime considerations as for `amz::views::take_while` apply.
+template <typename ForwardIterator, typename EquivalenceRelation>
+boost::iterator_range<group_iterator<ForwardIterator, EquivalenceRelation, false>>
+group_by(ForwardIterator first, ForwardIterator last, EquivalenceRelation equivalent) {
+  using Iterator = group_iterator<ForwardIterator, EquivalenceRelation, false>;
+  return {Iterator{first, last, equivalent}, Iterator{last, last, equivalent}};
+}
+
+template <typename Range, typename EquivalenceRelation>
+auto group_by(Range&& range, EquivalenceRelation equivalent) {
+  return views::group_by(detail::range_begin(range), detail::range_end(range), equivalent);
+}
+
+// Lazy view over the largest sub-ranges of `[first, last)` in which every
+// pair of adjacent elements `a, b` satisfies `pred(a, b)`.
+//
+// Unlike `amz::views::group_by`, `pred` needs not be an equivalence relation;
+// it is only ever applied to adjacent elements. This matches the semantics of
+// C++23's `std::views::chunk_by`.
+//
+// The same lifetime considerations as for `amz::views::take_while` apply.
+template <typename ForwardIterator, typename BinaryPredicate>
+boost::iterator_range<group_iterator<ForwardIterator, BinaryPredicate, true>>
+chunk_by(ForwardIterator first, ForwardIterator last, BinaryPredicate pred) {
+  using Iterator = group_iterator<ForwardIterator, BinaryPredicate, true>;
+  return {Iterator{first, last, pred}, Iterator{last, last, pred}};
+}
+
+template <typename Range, typename BinaryPredicate>
+auto chunk_by(Range&& range, BinaryPredicate pred) {
+  return views::chunk_by(detail::range_begin(range), detail::range_end(range), pred);
+}
+
+} // end namespace views
+} // end namespace amz
+
+#endif // include guard
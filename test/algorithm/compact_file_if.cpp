@@ -0,0 +1,177 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/algorithm/compact_file_if.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <system_error>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+namespace fs = boost::filesystem;
+
+
+struct record {
+  std::uint32_t id;
+  std::uint32_t expired;
+  char payload[24];
+
+  friend bool operator==(record const& a, record const& b) {
+    return a.id == b.id && a.expired == b.expired;
+  }
+};
+
+static bool is_expired(record const& r) { return r.expired != 0; }
+
+struct temporary_files {
+  temporary_files()
+    : data{fs::temp_directory_path() / fs::unique_path("amz-compact-%%%%-%%%%.dat")}
+    , archive{fs::temp_directory_path() / fs::unique_path("amz-compact-%%%%-%%%%.archive")}
+  { }
+
+  ~temporary_files() {
+    fs::remove(data);
+    fs::remove(archive);
+  }
+
+  fs::path data;
+  fs::path archive;
+};
+
+static void write_records(fs::path const& path, std::vector<record> const& records) {
+  fs::ofstream out{path, std::ios::binary | std::ios::trunc};
+  out.write(reinterpret_cast<char const*>(records.data()), records.size() * sizeof(record));
+}
+
+static std::vector<record> read_records(fs::path const& path) {
+  std::vector<record> records(fs::file_size(path) / sizeof(record));
+  fs::ifstream in{path, std::ios::binary};
+  in.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(record));
+  return records;
+}
+
+static std::vector<record> make_records(std::size_t n, std::size_t expire_every) {
+  std::vector<record> records;
+  for (std::uint32_t i = 0; i != n; ++i) {
+    record r{};
+    r.id = i;
+    r.expired = (i % expire_every == 0);
+    records.push_back(r);
+  }
+  return records;
+}
+
+TEST_CASE("empty file") {
+  temporary_files files;
+  write_records(files.data, {});
+
+  auto result = amz::compact_file_if<record>(files.data.c_str(), files.archive.c_str(), is_expired);
+  REQUIRE(result.kept == 0);
+  REQUIRE(result.removed == 0);
+  REQUIRE(fs::file_size(files.data) == 0);
+  REQUIRE(fs::file_size(files.archive) == 0);
+}
+
+TEST_CASE("remove nothing") {
+  temporary_files files;
+  std::vector<record> const records = make_records(100, 1000);
+  write_records(files.data, records);
+
+  auto result = amz::compact_file_if<record>(files.data.c_str(), files.archive.c_str(),
+                                             [](record const&) { return false; });
+  REQUIRE(result.kept == 100);
+  REQUIRE(result.removed == 0);
+  REQUIRE(read_records(files.data) == records);
+  REQUIRE(read_records(files.archive).empty());
+}
+
+TEST_CASE("remove everything") {
+  temporary_files files;
+  std::vector<record> const records = make_records(100, 1000);
+  write_records(files.data, records);
+
+  auto result = amz::compact_file_if<record>(files.data.c_str(), files.archive.c_str(),
+                                             [](record const&) { return true; });
+  REQUIRE(result.kept == 0);
+  REQUIRE(result.removed == 100);
+  REQUIRE(fs::file_size(files.data) == 0);
+  REQUIRE(read_records(files.archive) == records);
+}
+
+TEST_CASE("compaction is stable and spans many windows") {
+  temporary_files files;
+  std::vector<record> const records = make_records(100000, 3);
+  write_records(files.data, records);
+
+  std::vector<record> expected_kept, expected_removed;
+  for (record const& r : records)
+    (is_expired(r) ? expected_removed : expected_kept).push_back(r);
+
+  // Use a window that is not a multiple of the record size or the page size.
+  std::size_t const window = 3 * 4096 + 17;
+  auto result = amz::compact_file_if<record>(files.data.c_str(), files.archive.c_str(),
+                                             is_expired, window);
+  REQUIRE(result.kept == expected_kept.size());
+  REQUIRE(result.removed == expected_removed.size());
+  REQUIRE(read_records(files.data) == expected_kept);
+  REQUIRE(read_records(files.archive) == expected_removed);
+}
+
+TEST_CASE("removed records are appended to an existing archive") {
+  temporary_files files;
+  std::vector<record> const first = make_records(10, 2);
+  write_records(files.data, first);
+  amz::compact_file_if<record>(files.data.c_str(), files.archive.c_str(), is_expired);
+
+  std::vector<record> const second = make_records(10, 5);
+  write_records(files.data, second);
+  amz::compact_file_if<record>(files.data.c_str(), files.archive.c_str(), is_expired);
+
+  std::vector<record> expected;
+  for (record const& r : first) if (is_expired(r)) expected.push_back(r);
+  for (record const& r : second) if (is_expired(r)) expected.push_back(r);
+  REQUIRE(read_records(files.archive) == expected);
+}
+
+TEST_CASE("removed records can be dropped") {
+  temporary_files files;
+  write_records(files.data, make_records(1000, 2));
+
+  auto result = amz::compact_file_if<record>(files.data.c_str(), nullptr, is_expired);
+  REQUIRE(result.kept == 500);
+  REQUIRE(result.removed == 500);
+  REQUIRE(fs::file_size(files.data) == 500 * sizeof(record));
+  REQUIRE(!fs::exists(files.archive));
+}
+
+TEST_CASE("errors are reported as std::system_error") {
+  temporary_files files;
+  REQUIRE_THROWS_AS(amz::compact_file_if<record>(files.data.c_str(), nullptr, is_expired),
+                    std::system_error);
+
+  // A file whose size is not a multiple of the record size is rejected and
+  // left untouched.
+  {
+    fs::ofstream out{files.data, std::ios::binary};
+    out << "not a record";
+  }
+  REQUIRE_THROWS_AS(amz::compact_file_if<record>(files.data.c_str(), nullptr, is_expired),
+                    std::system_error);
+  REQUIRE(fs::file_size(files.data) == 12);
+}
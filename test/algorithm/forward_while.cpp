@@ -0,0 +1,112 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/algorithm/forward_while.hpp>
+
+#include <amz/bounded_channel.hpp>
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+
+TEST_CASE("forward_while stops at the first element not satisfying the predicate") {
+  amz::bounded_channel<int> in{64}, out{64};
+  for (int i : {1, 2, 3, 10, 4})
+    in.push(i);
+
+  auto const result = amz::forward_while(in, out, [](int i) { return i < 5; }, 2);
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(result.second == 0);
+
+  int i;
+  for (int expected : {1, 2, 3}) {
+    REQUIRE(out.try_pop(i) == amz::channel_op_status::success);
+    REQUIRE(i == expected);
+  }
+  REQUIRE(out.try_pop(i) == amz::channel_op_status::empty);
+
+  // The element failing the predicate is left in the input channel
+  REQUIRE(in.try_pop(i) == amz::channel_op_status::success);
+  REQUIRE(i == 10);
+}
+
+TEST_CASE("forward_while propagates closing downstream, if asked to") {
+  amz::bounded_channel<std::unique_ptr<int>> in{64}, out{64};
+  in.push(std::make_unique<int>(1));
+  in.push(std::make_unique<int>(2));
+  in.close();
+
+  auto const result = amz::forward_while(in, out, [](auto const&) { return true; }, 64, true);
+  REQUIRE(result.first == amz::channel_op_status::closed);
+  REQUIRE(result.second == 0);
+
+  std::unique_ptr<int> p;
+  REQUIRE(out.pop(p) == amz::channel_op_status::success);
+  REQUIRE(*p == 1);
+  REQUIRE(out.pop(p) == amz::channel_op_status::success);
+  REQUIRE(*p == 2);
+  REQUIRE(out.pop(p) == amz::channel_op_status::closed);
+}
+
+TEST_CASE("forward_while leaves the output open by default") {
+  amz::bounded_channel<int> in{64}, out{64};
+  in.push(1);
+  in.close();
+  auto const result = amz::forward_while(in, out, [](int) { return true; });
+  REQUIRE(result.first == amz::channel_op_status::closed);
+  REQUIRE(result.second == 0);
+
+  int i;
+  REQUIRE(out.try_pop(i) == amz::channel_op_status::success);
+  REQUIRE(out.try_pop(i) == amz::channel_op_status::empty);
+}
+
+TEST_CASE("forward_while reports the elements dropped when the output channel is closed") {
+  amz::bounded_channel<int> in{64}, out{64};
+  in.push(1);
+  in.push(2);
+  out.close();
+  auto const result = amz::forward_while(in, out, [](int) { return true; });
+  REQUIRE(result.first == amz::channel_op_status::closed);
+  REQUIRE(result.second == 2);
+}
+
+TEST_CASE("forward_while streams elements between threads") {
+  amz::bounded_channel<int> in{4}, out{3};
+  int const n = 1000;
+
+  std::thread producer{[&] {
+    for (int i = 0; i != n; ++i)
+      REQUIRE(in.push(i) == amz::channel_op_status::success);
+    in.push(-1);
+    in.close();
+  }};
+  std::thread forwarder{[&] {
+    REQUIRE(amz::forward_while(in, out, [](int i) { return i >= 0; }, 16).first == amz::channel_op_status::success);
+    out.close();
+  }};
+
+  std::vector<int> received;
+  for (int i : out)
+    received.push_back(i);
+  producer.join();
+  forwarder.join();
+
+  REQUIRE(received.size() == n);
+  for (int i = 0; i != n; ++i)
+    REQUIRE(received[i] == i);
+}
@@ -15,6 +15,7 @@
 
 #include <array>
 #include <iterator>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -135,3 +136,20 @@ TEST_CASE("corner case: singleton input range, remove everything") {
   REQUIRE(actual == expected);
   REQUIRE(result.first == data.end());
 }
+
+TEST_CASE("elements are moved, so move-only types are supported") {
+  std::vector<std::unique_ptr<int>> data;
+  for (int i = 0; i != 6; ++i)
+    data.push_back(std::make_unique<int>(i));
+  std::vector<std::unique_ptr<int>> removed;
+  auto result = amz::remove_and_copy_if(data.begin(), data.end(), std::back_inserter(removed),
+                                        [](std::unique_ptr<int> const& p) { return *p % 2 == 0; });
+  data.erase(result.first, data.end());
+
+  REQUIRE(data.size() == 3);
+  REQUIRE(removed.size() == 3);
+  for (int i = 0; i != 3; ++i) {
+    REQUIRE(*data[i] == 2 * i + 1);
+    REQUIRE(*removed[i] == 2 * i);
+  }
+}
@@ -0,0 +1,171 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/algorithm/route_if.hpp>
+
+#include <amz/bounded_channel.hpp>
+
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+
+template <typename Channel>
+static std::vector<int> drain(Channel& channel) {
+  std::vector<int> result;
+  int i;
+  while (channel.try_pop(i) == amz::channel_op_status::success)
+    result.push_back(i);
+  return result;
+}
+
+TEST_CASE("route_if splits the input between the output and reject channels") {
+  amz::bounded_channel<int> in{64}, out{64}, reject{64};
+  for (int i = 0; i != 20; ++i)
+    in.push(i);
+  in.close();
+
+  auto const result = amz::route_if(in, out, reject, [](int i) { return i % 3 == 0; }, 4, true);
+  REQUIRE(result.first == amz::channel_op_status::closed);
+  REQUIRE(result.second == 0);
+
+  REQUIRE(drain(out) == (std::vector<int>{1, 2, 4, 5, 7, 8, 10, 11, 13, 14, 16, 17, 19}));
+  REQUIRE(drain(reject) == (std::vector<int>{0, 3, 6, 9, 12, 15, 18}));
+
+  // Closing was propagated downstream
+  int i;
+  REQUIRE(out.try_pop(i) == amz::channel_op_status::closed);
+  REQUIRE(reject.try_pop(i) == amz::channel_op_status::closed);
+}
+
+TEST_CASE("route_if closes the outputs when the input is closed and empty, if asked to") {
+  amz::bounded_channel<int> in{64}, out{64}, reject{64};
+  in.close();
+  REQUIRE(amz::route_if(in, out, reject, [](int) { return true; }, 64, true).first == amz::channel_op_status::closed);
+
+  int i;
+  REQUIRE(out.try_pop(i) == amz::channel_op_status::closed);
+  REQUIRE(reject.try_pop(i) == amz::channel_op_status::closed);
+}
+
+TEST_CASE("route_if leaves the outputs open by default") {
+  amz::bounded_channel<int> in{64}, out{64}, reject{64};
+  in.close();
+  auto const result = amz::route_if(in, out, reject, [](int) { return true; });
+  REQUIRE(result.first == amz::channel_op_status::closed);
+  REQUIRE(result.second == 0);
+
+  int i;
+  REQUIRE(out.try_pop(i) == amz::channel_op_status::empty);
+  REQUIRE(reject.try_pop(i) == amz::channel_op_status::empty);
+}
+
+TEST_CASE("route_if stops when a downstream channel is closed") {
+  amz::bounded_channel<int> in{64}, out{64}, reject{64};
+  out.close();
+  in.push(1);
+
+  in.push(2);
+  in.push(3);
+  in.close();
+
+  // The whole batch is dropped, which is reported
+  auto const result = amz::route_if(in, out, reject, [](int i) { return i == 2; });
+  REQUIRE(result.first == amz::channel_op_status::closed);
+  REQUIRE(result.second == 3);
+
+  // Elements that were not popped are left in the input channel
+  amz::bounded_channel<int> in2{64};
+  in2.push(1);
+  REQUIRE(amz::route_if(in2, out, reject, [](int) { return false; }).second == 1);
+  REQUIRE(in2.try_push(2) == amz::channel_op_status::success);
+}
+
+TEST_CASE("several route_if stages can feed the same channels") {
+  amz::bounded_channel<int> in{4}, out{4}, reject{4};
+  int const n = 1000;
+
+  std::thread producer{[&] {
+    for (int i = 0; i != n; ++i)
+      REQUIRE(in.push(i) == amz::channel_op_status::success);
+    in.close();
+  }};
+  std::vector<std::thread> routers;
+  for (int r = 0; r != 3; ++r) {
+    routers.emplace_back([&] {
+      auto const result = amz::route_if(in, out, reject, [](int i) { return i % 2 == 0; }, 8);
+      REQUIRE(result.first == amz::channel_op_status::closed);
+      REQUIRE(result.second == 0);
+    });
+  }
+  std::thread closer{[&] {
+    for (auto& router : routers)
+      router.join();
+    out.close();
+    reject.close();
+  }};
+
+  std::size_t rejected = 0;
+  std::thread reject_consumer{[&] {
+    for (int i : reject) {
+      REQUIRE(i % 2 == 0);
+      ++rejected;
+    }
+  }};
+  std::size_t kept = 0;
+  for (int i : out) {
+    REQUIRE(i % 2 == 1);
+    ++kept;
+  }
+
+  producer.join();
+  closer.join();
+  reject_consumer.join();
+  REQUIRE(kept == n / 2);
+  REQUIRE(rejected == n / 2);
+}
+
+TEST_CASE("route_if streams elements between threads through small channels") {
+  amz::bounded_channel<int> in{3}, out{2}, reject{5};
+  int const n = 1000;
+
+  std::thread producer{[&] {
+    for (int i = 0; i != n; ++i)
+      REQUIRE(in.push(i) == amz::channel_op_status::success);
+    in.close();
+  }};
+  std::thread router{[&] {
+    REQUIRE(amz::route_if(in, out, reject, [](int i) { return i % 2 == 0; }, 8, true).first == amz::channel_op_status::closed);
+  }};
+
+  std::vector<int> kept, rejected;
+  std::thread reject_consumer{[&] {
+    for (int i : reject)
+      rejected.push_back(i);
+  }};
+  for (int i : out)
+    kept.push_back(i);
+
+  producer.join();
+  router.join();
+  reject_consumer.join();
+
+  REQUIRE(kept.size() == n / 2);
+  REQUIRE(rejected.size() == n / 2);
+  for (int i = 0; i != n / 2; ++i) {
+    REQUIRE(kept[i] == 2 * i + 1);
+    REQUIRE(rejected[i] == 2 * i);
+  }
+}
@@ -0,0 +1,171 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/arena.hpp>
+#include <amz/algorithm/remove_and_copy_if.hpp>
+#include <amz/bounded_channel.hpp>
+#include <amz/deferred_reclamation_allocator.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <string>
+#include <vector>
+
+
+static bool is_aligned(void* p, std::size_t alignment) {
+  return reinterpret_cast<std::uintptr_t>(p) % alignment == 0;
+}
+
+TEST_CASE("allocations are distinct, aligned and usable") {
+  amz::arena arena{1024};
+  std::vector<char*> blocks;
+  for (std::size_t i = 0; i != 1000; ++i) {
+    std::size_t const alignment = std::size_t{1} << (i % 7);
+    char* p = static_cast<char*>(arena.allocate(i % 40 + 1, alignment));
+    REQUIRE(is_aligned(p, alignment));
+    std::memset(p, static_cast<int>(i % 256), i % 40 + 1);
+    blocks.push_back(p);
+  }
+  for (std::size_t i = 0; i != blocks.size(); ++i) {
+    for (std::size_t j = 0; j != i % 40 + 1; ++j)
+      REQUIRE(static_cast<unsigned char>(blocks[i][j]) == i % 256);
+  }
+}
+
+TEST_CASE("consecutive small allocations are contiguous") {
+  amz::arena arena{1024};
+  char* a = static_cast<char*>(arena.allocate(8, 8));
+  char* b = static_cast<char*>(arena.allocate(8, 8));
+  REQUIRE(b == a + 8);
+}
+
+TEST_CASE("large allocations get a dedicated chunk and don't waste the current chunk") {
+  amz::arena arena{1024};
+  char* a = static_cast<char*>(arena.allocate(8, 8));
+  char* big = static_cast<char*>(arena.allocate(4096, 8));
+  std::memset(big, 0, 4096);
+  char* b = static_cast<char*>(arena.allocate(8, 8));
+  REQUIRE(b == a + 8);
+}
+
+TEST_CASE("over-aligned allocations are honored") {
+  amz::arena arena{1024};
+  arena.allocate(1, 1);
+  REQUIRE(is_aligned(arena.allocate(16, 64), 64));
+  REQUIRE(is_aligned(arena.allocate(512, 256), 256));
+}
+
+TEST_CASE("reset(checkpoint) releases everything allocated after the checkpoint") {
+  amz::arena arena{256};
+  arena.allocate(16);
+  amz::arena::checkpoint const cp = arena.mark();
+  void* first = arena.allocate(16);
+  for (int i = 0; i != 100; ++i) // spill over many chunks
+    arena.allocate(48);
+  arena.allocate(10000);
+
+  arena.reset(cp);
+  REQUIRE(arena.allocate(16) == first);
+
+  // The checkpoint remains valid after resetting to it.
+  arena.reset(cp);
+  REQUIRE(arena.allocate(16) == first);
+}
+
+TEST_CASE("reset() reuses the chunks that were released") {
+  amz::arena arena{256};
+  void* first = arena.allocate(16);
+  for (int i = 0; i != 100; ++i)
+    arena.allocate(48);
+
+  arena.reset();
+  REQUIRE(arena.allocate(16) == first);
+}
+
+TEST_CASE("arena_allocator works with standard containers") {
+  amz::arena arena;
+  amz::arena_allocator<int> allocator{arena};
+  std::vector<int, amz::arena_allocator<int>> vector{allocator};
+  std::list<std::string, amz::arena_allocator<std::string>> list{allocator};
+  for (int i = 0; i != 1000; ++i) {
+    vector.push_back(i);
+    list.push_back(std::to_string(i));
+  }
+  REQUIRE(vector.size() == 1000);
+  REQUIRE(vector.back() == 999);
+  REQUIRE(list.back() == "999");
+}
+
+TEST_CASE("arena_allocators compare equal iff they use the same arena") {
+  amz::arena a, b;
+  amz::arena_allocator<int> x{a}, y{a}, z{b};
+  amz::arena_allocator<double> w{x};
+  REQUIRE(x == y);
+  REQUIRE(x != z);
+  REQUIRE(&w.arena() == &a);
+}
+
+TEST_CASE("arena_allocator can be used for the container of a bounded_channel") {
+  using Container = std::deque<int, amz::arena_allocator<int>>;
+  amz::arena arena;
+  amz::bounded_channel<int, Container> channel{16, Container{amz::arena_allocator<int>{arena}}};
+  std::vector<int> const input = {1, 2, 3, 4, 5};
+  channel.push_range(input.begin(), input.end());
+  channel.close();
+
+  std::vector<int> actual;
+  for (int i : channel)
+    actual.push_back(i);
+  REQUIRE(actual == input);
+}
+
+TEST_CASE("arena_allocator can be used for the output of algorithms") {
+  amz::arena arena;
+  std::vector<int> input = {1, 2, 3, 4, 5, 6};
+  std::vector<int, amz::arena_allocator<int>> removed{amz::arena_allocator<int>{arena}};
+  auto const result = amz::remove_and_copy_if(input.begin(), input.end(), std::back_inserter(removed),
+                                              [](int i) { return i % 2 == 0; });
+  input.erase(result.first, input.end());
+  REQUIRE(input == (std::vector<int>{1, 3, 5}));
+  REQUIRE(removed == (std::vector<int, amz::arena_allocator<int>>({2, 4, 6}, amz::arena_allocator<int>{arena})));
+}
+
+TEST_CASE("arena_allocator can be used as the underlying allocator of deferred_reclamation_allocator") {
+  amz::arena arena;
+  int destroyed = 0;
+  struct counted {
+    explicit counted(int* c) : count{c} { }
+    ~counted() { ++*count; }
+    int* count;
+  };
+  {
+    amz::deferred_reclamation_allocator<amz::arena_allocator<counted>> allocator{
+      amz::arena_allocator<counted>{arena}, std::chrono::milliseconds{1}, 4
+    };
+    for (int i = 0; i != 20; ++i) {
+      counted* p = allocator.allocate(1);
+      allocator.construct(p, &destroyed);
+      allocator.destroy(p);
+      allocator.deallocate(p, 1);
+    }
+  }
+  REQUIRE(destroyed == 20);
+}
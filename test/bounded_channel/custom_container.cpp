@@ -38,3 +38,18 @@ TEST_CASE("The underlying container of the channel can be customized") {
   std::vector<int> const expected = {1, 2, 3, 4 ,5};
   REQUIRE(actual == expected);
 }
+
+TEST_CASE("The channel can be given an instance of its underlying container") {
+  using Container = std::list<int>;
+  amz::bounded_channel<int, Container> channel{64, Container{1, 2}};
+  channel.push(3);
+  channel.close();
+
+  std::vector<int> actual;
+  for (int i : channel) {
+    actual.push_back(i);
+  }
+
+  std::vector<int> const expected = {1, 2, 3};
+  REQUIRE(actual == expected);
+}
@@ -0,0 +1,100 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/bounded_channel.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <deque>
+#include <list>
+#include <thread>
+#include <vector>
+
+
+TEST_CASE("drain() takes all the elements of the channel") {
+  amz::bounded_channel<int> channel{64};
+  for (int i = 0; i != 5; ++i)
+    channel.push(i);
+
+  std::deque<int> out;
+  REQUIRE(channel.drain(out) == amz::channel_op_status::success);
+  REQUIRE(out == (std::deque<int>{0, 1, 2, 3, 4}));
+
+  int value;
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::empty);
+}
+
+TEST_CASE("drain() appends to a non-empty container") {
+  amz::bounded_channel<int, std::list<int>> channel{64};
+  channel.push(3);
+  channel.push(4);
+
+  std::list<int> out = {1, 2};
+  REQUIRE(channel.drain(out) == amz::channel_op_status::success);
+  REQUIRE(out == (std::list<int>{1, 2, 3, 4}));
+}
+
+TEST_CASE("drain() returns empty or closed when there is nothing to drain") {
+  amz::bounded_channel<int> channel{64};
+  std::deque<int> out;
+  REQUIRE(channel.drain(out) == amz::channel_op_status::empty);
+  channel.close();
+  REQUIRE(channel.drain(out) == amz::channel_op_status::closed);
+  REQUIRE(out.empty());
+}
+
+TEST_CASE("drain() succeeds when the channel is non-empty and closed") {
+  amz::bounded_channel<int> channel{64};
+  channel.push(1);
+  channel.close();
+
+  std::deque<int> out;
+  REQUIRE(channel.drain(out) == amz::channel_op_status::success);
+  REQUIRE(out == (std::deque<int>{1}));
+  REQUIRE(channel.drain(out) == amz::channel_op_status::closed);
+}
+
+TEST_CASE("drain() wakes up all the blocked producers") {
+  amz::bounded_channel<int> channel{2};
+  channel.push(0);
+  channel.push(0);
+
+  amz::channel_op_status statuses[2] = {amz::channel_op_status::closed, amz::channel_op_status::closed};
+  std::vector<std::thread> producers;
+  for (int i = 0; i != 2; ++i) {
+    producers.emplace_back([&, i] { statuses[i] = channel.push(1); });
+  }
+  // Give both producers time to block on the full channel.
+  std::this_thread::sleep_for(std::chrono::milliseconds{50});
+
+  // A single drain() must be enough for both producers to push their value,
+  // without any other consumer operation.
+  std::deque<int> out;
+  REQUIRE(channel.drain(out) == amz::channel_op_status::success);
+  REQUIRE(out == (std::deque<int>{0, 0}));
+
+  auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds{5};
+  while (channel.size() != 2 && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  bool const both_pushed = channel.size() == 2;
+  if (!both_pushed)
+    channel.close(); // unblock the remaining producer, so we can join it
+  for (auto& t : producers)
+    t.join();
+
+  REQUIRE(both_pushed);
+  REQUIRE(statuses[0] == amz::channel_op_status::success);
+  REQUIRE(statuses[1] == amz::channel_op_status::success);
+}
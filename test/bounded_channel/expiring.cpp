@@ -0,0 +1,165 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/bounded_channel.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <deque>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+// A clock whose time is controlled by the tests.
+struct fake_clock {
+  using duration = std::chrono::milliseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<fake_clock>;
+  static constexpr bool is_steady = true;
+
+  static time_point now() noexcept { return current; }
+  static time_point current;
+};
+fake_clock::time_point fake_clock::current{};
+
+using Element = amz::expiring<int, fake_clock>;
+
+static Element expiring_in(int value, int ms) {
+  return Element{value, fake_clock::now() + std::chrono::milliseconds{ms}};
+}
+
+TEST_CASE("live elements are popped normally") {
+  amz::bounded_channel<Element> channel{64};
+  channel.push(expiring_in(1, 10));
+  channel.push(expiring_in(2, 10));
+
+  Element e;
+  REQUIRE(channel.pop(e) == amz::channel_op_status::success);
+  REQUIRE(e.value == 1);
+  REQUIRE(channel.try_pop(e) == amz::channel_op_status::success);
+  REQUIRE(e.value == 2);
+  REQUIRE(channel.expired_count() == 0);
+}
+
+TEST_CASE("expired elements at the front are discarded and counted") {
+  amz::bounded_channel<Element> channel{64};
+  channel.push(expiring_in(1, 5));
+  channel.push(expiring_in(2, 5));
+  channel.push(expiring_in(3, 20));
+  channel.push(expiring_in(4, 5));
+  fake_clock::current += std::chrono::milliseconds{10};
+
+  // Element 4 has expired too, but it is behind a live element; it is only
+  // discarded when it reaches the front.
+  Element e;
+  REQUIRE(channel.try_pop(e) == amz::channel_op_status::success);
+  REQUIRE(e.value == 3);
+  REQUIRE(channel.expired_count() == 2);
+  REQUIRE(channel.try_pop(e) == amz::channel_op_status::empty);
+  REQUIRE(channel.expired_count() == 3);
+}
+
+TEST_CASE("the expiry handler is called for each discarded element") {
+  amz::bounded_channel<Element> channel{64};
+  std::vector<int> discarded;
+  channel.set_expiry_handler([&](Element&& e) {
+    // The handler is called without the lock held, so using the channel
+    // from the handler does not deadlock.
+    REQUIRE(channel.expired_count() > 0);
+    discarded.push_back(e.value);
+  });
+  channel.push(expiring_in(1, 5));
+  channel.push(expiring_in(2, 5));
+  channel.push(expiring_in(3, 20));
+  fake_clock::current += std::chrono::milliseconds{10};
+
+  Element e;
+  REQUIRE(channel.pop(e) == amz::channel_op_status::success);
+  REQUIRE(e.value == 3);
+  REQUIRE(discarded == (std::vector<int>{1, 2}));
+}
+
+TEST_CASE("pop() keeps waiting when only expired elements are available") {
+  amz::bounded_channel<Element> channel{64};
+  channel.push(expiring_in(1, 5));
+  fake_clock::current += std::chrono::milliseconds{10};
+
+  Element e;
+  REQUIRE(channel.try_pop_for(std::chrono::milliseconds{10}, e) == amz::channel_op_status::timeout);
+  REQUIRE(channel.expired_count() == 1);
+
+  std::thread producer{[&] { channel.push(expiring_in(2, 5)); }};
+  REQUIRE(channel.pop(e) == amz::channel_op_status::success);
+  REQUIRE(e.value == 2);
+  producer.join();
+
+  channel.push(expiring_in(3, 5));
+  fake_clock::current += std::chrono::milliseconds{10};
+  channel.close();
+  REQUIRE(channel.pop(e) == amz::channel_op_status::closed);
+  REQUIRE(channel.expired_count() == 2);
+}
+
+TEST_CASE("pop_some() skips expired elements") {
+  amz::bounded_channel<Element> channel{64};
+  channel.push(expiring_in(1, 20));
+  channel.push(expiring_in(2, 5));
+  channel.push(expiring_in(3, 20));
+  channel.push(expiring_in(4, 5));
+  fake_clock::current += std::chrono::milliseconds{10};
+
+  std::vector<Element> out;
+  REQUIRE(channel.pop_some(std::back_inserter(out), 10).first == amz::channel_op_status::success);
+  REQUIRE(out.size() == 2);
+  REQUIRE(out[0].value == 1);
+  REQUIRE(out[1].value == 3);
+  REQUIRE(channel.expired_count() == 2);
+}
+
+TEST_CASE("discarding expired elements unblocks producers") {
+  amz::bounded_channel<Element> channel{1};
+  channel.push(expiring_in(1, 5));
+  fake_clock::current += std::chrono::milliseconds{10};
+
+  std::thread producer{[&] { channel.push(expiring_in(2, 5)); }};
+  Element e;
+  REQUIRE(channel.pop(e) == amz::channel_op_status::success);
+  REQUIRE(e.value == 2);
+  producer.join();
+}
+
+TEST_CASE("drain() does not discard expired elements") {
+  amz::bounded_channel<Element> channel{64};
+  channel.push(expiring_in(1, 5));
+  fake_clock::current += std::chrono::milliseconds{10};
+
+  std::deque<Element> out;
+  REQUIRE(channel.drain(out) == amz::channel_op_status::success);
+  REQUIRE(out.size() == 1);
+  REQUIRE(channel.expired_count() == 0);
+}
+
+TEST_CASE("expire_after() creates an element expiring after the given duration") {
+  auto const e = amz::expire_after<fake_clock>(std::chrono::milliseconds{5}, 42);
+  REQUIRE(e.value == 42);
+  REQUIRE(e.deadline == fake_clock::now() + std::chrono::milliseconds{5});
+
+  auto const s = amz::expire_after(std::chrono::seconds{1}, 1);
+  static_assert(std::is_same<decltype(s), amz::expiring<int> const>::value, "");
+  REQUIRE(s.deadline > std::chrono::steady_clock::now());
+}
@@ -0,0 +1,143 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/bounded_channel.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+
+TEST_CASE("pop_batch() returns as soon as the batch is complete") {
+  amz::bounded_channel<int> channel{64};
+  for (int i = 0; i != 5; ++i)
+    channel.push(i);
+
+  std::vector<int> out;
+  auto const start = std::chrono::steady_clock::now();
+  auto result = channel.pop_batch(std::back_inserter(out), 3, std::chrono::hours{1});
+  REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::minutes{1});
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{0, 1, 2}));
+}
+
+TEST_CASE("pop_batch() considers a full channel as a complete batch") {
+  amz::bounded_channel<int> channel{4};
+  std::thread producer{[&] {
+    for (int i = 0; i != 8; ++i)
+      channel.push(i);
+  }};
+
+  // The batch can never hold more than the capacity, so waiting for `max_n`
+  // elements would block forever while the producer is blocked too.
+  std::vector<int> out;
+  auto const start = std::chrono::steady_clock::now();
+  auto result = channel.pop_batch(std::back_inserter(out), 100, std::chrono::hours{1});
+  REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::minutes{1});
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{0, 1, 2, 3}));
+
+  // Same thing with a finite wait, which is not paid when the channel is full.
+  out.clear();
+  auto const max_wait = std::chrono::seconds{10};
+  auto const second_start = std::chrono::steady_clock::now();
+  result = channel.pop_batch(std::back_inserter(out), 100, max_wait);
+  REQUIRE(std::chrono::steady_clock::now() - second_start < max_wait);
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{4, 5, 6, 7}));
+  producer.join();
+}
+
+TEST_CASE("pop_batch() returns an incomplete batch after the maximum wait") {
+  amz::bounded_channel<int> channel{64};
+  channel.push(1);
+  channel.push(2);
+
+  std::vector<int> out;
+  auto const max_wait = std::chrono::milliseconds{20};
+  auto const start = std::chrono::steady_clock::now();
+  auto result = channel.pop_batch(std::back_inserter(out), 10, max_wait);
+  REQUIRE(std::chrono::steady_clock::now() - start >= max_wait - std::chrono::milliseconds{1});
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{1, 2}));
+}
+
+TEST_CASE("pop_batch() measures the wait from the arrival of the oldest element") {
+  amz::bounded_channel<int> channel{64};
+  channel.push(1);
+  std::this_thread::sleep_for(std::chrono::milliseconds{30});
+
+  // The oldest element has already waited longer than the maximum wait.
+  std::vector<int> out;
+  auto const start = std::chrono::steady_clock::now();
+  auto result = channel.pop_batch(std::back_inserter(out), 10, std::chrono::milliseconds{20});
+  REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds{20});
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{1}));
+}
+
+TEST_CASE("pop_batch() wakes up when producers complete the batch") {
+  amz::bounded_channel<int> channel{64};
+  std::thread producer{[&] {
+    for (int i = 0; i != 4; ++i) {
+      channel.push(i);
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+  }};
+
+  std::vector<int> out;
+  auto result = channel.pop_batch(std::back_inserter(out), 4, std::chrono::hours{1});
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{0, 1, 2, 3}));
+  producer.join();
+}
+
+TEST_CASE("pop_batch() does not swallow notifications meant for other consumers") {
+  amz::bounded_channel<int> channel{64};
+  std::vector<int> batch;
+  std::thread batcher{[&] {
+    channel.pop_batch(std::back_inserter(batch), 2, std::chrono::hours{1});
+  }};
+  int popped = -1;
+  std::thread consumer{[&] { channel.pop(popped); }};
+
+  channel.push(1);
+  channel.push(2);
+  channel.push(3);
+  batcher.join();
+  consumer.join();
+  REQUIRE(batch.size() + 1 == 3);
+}
+
+TEST_CASE("pop_batch() returns the remaining elements and then closed when the channel is closed") {
+  amz::bounded_channel<int> channel{64};
+  channel.push(1);
+  std::thread closer{[&] {
+    std::this_thread::sleep_for(std::chrono::milliseconds{5});
+    channel.close();
+  }};
+
+  std::vector<int> out;
+  auto result = channel.pop_batch(std::back_inserter(out), 10, std::chrono::hours{1});
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{1}));
+  closer.join();
+
+  result = channel.pop_batch(std::back_inserter(out), 10, std::chrono::hours{1});
+  REQUIRE(result.first == amz::channel_op_status::closed);
+  REQUIRE(out == (std::vector<int>{1}));
+}
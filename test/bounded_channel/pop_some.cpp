@@ -0,0 +1,142 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/bounded_channel.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <atomic>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+
+TEST_CASE("pop_some() pops at most the given number of elements") {
+  amz::bounded_channel<int> channel{64};
+  for (int i = 0; i != 5; ++i)
+    channel.push(i);
+
+  std::vector<int> out;
+  auto result = channel.pop_some(std::back_inserter(out), 3);
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{0, 1, 2}));
+
+  result = channel.pop_some(std::back_inserter(out), 3);
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{0, 1, 2, 3, 4}));
+}
+
+TEST_CASE("pop_some() succeeds when the channel is non-empty and closed") {
+  amz::bounded_channel<int> channel{64};
+  channel.push(1);
+  channel.push(2);
+  channel.close();
+
+  std::vector<int> out;
+  REQUIRE(channel.pop_some(std::back_inserter(out), 10).first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{1, 2}));
+  REQUIRE(channel.pop_some(std::back_inserter(out), 10).first == amz::channel_op_status::closed);
+  REQUIRE(out == (std::vector<int>{1, 2}));
+}
+
+TEST_CASE("pop_some() returns the output iterator past the last popped element") {
+  amz::bounded_channel<int> channel{64};
+  channel.push(1);
+  channel.push(2);
+
+  int out[4] = {0, 0, 0, 0};
+  auto result = channel.pop_some(out, 4);
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(result.second == out + 2);
+  REQUIRE(out[0] == 1);
+  REQUIRE(out[1] == 2);
+}
+
+TEST_CASE("pop_some() blocks until a value becomes available") {
+  amz::bounded_channel<int> channel{64};
+
+  std::atomic<bool> started{false};
+  std::thread t{[&] {
+    started = true;
+    std::vector<int> out;
+    REQUIRE(channel.pop_some(std::back_inserter(out), 10).first == amz::channel_op_status::success);
+    REQUIRE(!out.empty());
+    REQUIRE(out.front() == 1);
+  }};
+
+  // Wait until the thread has started.
+  while (!started) std::this_thread::yield();
+
+  // Here, we assume the thread is blocked in `pop_some()`, and this will unblock it.
+  channel.push(1);
+
+  t.join();
+}
+
+TEST_CASE("pop_some() unblocks producers") {
+  amz::bounded_channel<int> channel{4};
+  std::thread producer{[&] {
+    for (int i = 0; i != 100; ++i)
+      REQUIRE(channel.push(i) == amz::channel_op_status::success);
+    channel.close();
+  }};
+
+  std::vector<int> out;
+  while (channel.pop_some(std::back_inserter(out), 3).first == amz::channel_op_status::success)
+    ;
+  producer.join();
+
+  REQUIRE(out.size() == 100);
+  for (int i = 0; i != 100; ++i)
+    REQUIRE(out[i] == i);
+}
+
+TEST_CASE("pop_some_while() stops at the first element not satisfying the predicate") {
+  amz::bounded_channel<int> channel{64};
+  for (int i : {1, 3, 5, 6, 7})
+    channel.push(i);
+
+  auto odd = [](int i) { return i % 2 == 1; };
+  std::vector<int> out;
+  REQUIRE(channel.pop_some_while(std::back_inserter(out), 10, odd).first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{1, 3, 5}));
+
+  // The front of the channel fails the predicate, so nothing is popped.
+  REQUIRE(channel.pop_some_while(std::back_inserter(out), 10, odd).first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{1, 3, 5}));
+
+  int i = 999;
+  REQUIRE(channel.pop(i) == amz::channel_op_status::success);
+  REQUIRE(i == 6);
+}
+
+TEST_CASE("pop_some_while() respects the maximum number of elements") {
+  amz::bounded_channel<int> channel{64};
+  for (int i : {1, 3, 5})
+    channel.push(i);
+
+  std::vector<int> out;
+  auto result = channel.pop_some_while(std::back_inserter(out), 2, [](int) { return true; });
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{1, 3}));
+}
+
+TEST_CASE("pop_some_while() returns `closed` when the channel is empty and closed") {
+  amz::bounded_channel<int> channel{64};
+  channel.close();
+  std::vector<int> out;
+  auto result = channel.pop_some_while(std::back_inserter(out), 2, [](int) { return true; });
+  REQUIRE(result.first == amz::channel_op_status::closed);
+  REQUIRE(out.empty());
+}
@@ -0,0 +1,124 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/bounded_channel.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+TEST_CASE("push_range() pushes all the elements when there is room") {
+  amz::bounded_channel<int> channel{64};
+  std::vector<int> values{1, 2, 3, 4};
+
+  auto result = channel.push_range(values.begin(), values.end());
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(result.second == values.end());
+
+  for (int expected : values) {
+    int i = 999;
+    REQUIRE(channel.try_pop(i) == amz::channel_op_status::success);
+    REQUIRE(i == expected);
+  }
+  int i = 999;
+  REQUIRE(channel.try_pop(i) == amz::channel_op_status::empty);
+}
+
+TEST_CASE("push_range() succeeds with an empty range") {
+  amz::bounded_channel<int> channel{1};
+  std::vector<int> values;
+  auto result = channel.push_range(values.begin(), values.end());
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(result.second == values.end());
+}
+
+TEST_CASE("push_range() returns `closed` when the channel is closed") {
+  amz::bounded_channel<int> channel{64};
+  channel.close();
+  std::vector<int> values{1, 2, 3};
+
+  auto result = channel.push_range(values.begin(), values.end());
+  REQUIRE(result.first == amz::channel_op_status::closed);
+  REQUIRE(result.second == values.begin());
+}
+
+TEST_CASE("push_range() moves from move iterators") {
+  amz::bounded_channel<std::unique_ptr<int>> channel{64};
+  std::vector<std::unique_ptr<int>> values;
+  values.emplace_back(new int{1});
+  values.emplace_back(new int{2});
+
+  auto result = channel.push_range(std::make_move_iterator(values.begin()),
+                                   std::make_move_iterator(values.end()));
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(values[0] == nullptr);
+  REQUIRE(values[1] == nullptr);
+
+  std::unique_ptr<int> p;
+  REQUIRE(channel.pop(p) == amz::channel_op_status::success);
+  REQUIRE(*p == 1);
+  REQUIRE(channel.pop(p) == amz::channel_op_status::success);
+  REQUIRE(*p == 2);
+}
+
+TEST_CASE("push_range() blocks until there is room for the whole range") {
+  amz::bounded_channel<int> channel{2};
+  std::vector<int> values;
+  for (int i = 0; i != 100; ++i)
+    values.push_back(i);
+
+  std::thread producer{[&] {
+    auto result = channel.push_range(values.begin(), values.end());
+    REQUIRE(result.first == amz::channel_op_status::success);
+  }};
+
+  for (int expected : values) {
+    int i = 999;
+    REQUIRE(channel.pop(i) == amz::channel_op_status::success);
+    REQUIRE(i == expected);
+  }
+  producer.join();
+}
+
+TEST_CASE("push_range() returns `closed` when the channel is closed while blocked") {
+  amz::bounded_channel<int> channel{2};
+  channel.push(1);
+  channel.push(2);
+  std::vector<int> values{3, 4};
+
+  std::atomic<bool> started{false};
+  std::thread producer{[&] {
+    started = true;
+    auto result = channel.push_range(values.begin(), values.end());
+    REQUIRE(result.first == amz::channel_op_status::closed);
+    REQUIRE(result.second == values.begin());
+  }};
+
+  // Wait until the thread has started, and assume it is blocked in `push_range()`.
+  while (!started) std::this_thread::yield();
+  channel.close();
+  producer.join();
+
+  int i = 999;
+  REQUIRE(channel.pop(i) == amz::channel_op_status::success);
+  REQUIRE(i == 1);
+  REQUIRE(channel.pop(i) == amz::channel_op_status::success);
+  REQUIRE(i == 2);
+  REQUIRE(channel.pop(i) == amz::channel_op_status::closed);
+}
@@ -0,0 +1,155 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/bounded_channel.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+
+using namespace std::chrono_literals;
+using steady = std::chrono::steady_clock;
+
+TEST_CASE("try_pop() allows a burst and then returns timeout") {
+  amz::bounded_channel<int> channel{16};
+  channel.set_rate_limit(1, 3);
+  for (int i = 0; i != 5; ++i)
+    channel.push(i);
+
+  int value;
+  for (int i = 0; i != 3; ++i) {
+    REQUIRE(channel.try_pop(value) == amz::channel_op_status::success);
+    REQUIRE(value == i);
+  }
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::timeout);
+  REQUIRE(channel.size() == 2);
+
+  channel.clear_rate_limit();
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 3);
+}
+
+TEST_CASE("pop() releases elements at the configured rate") {
+  amz::bounded_channel<int> channel{16};
+  channel.set_rate_limit(100);
+  for (int i = 0; i != 11; ++i)
+    channel.push(i);
+
+  auto const start = steady::now();
+  int value;
+  for (int i = 0; i != 11; ++i) {
+    REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+    REQUIRE(value == i);
+  }
+  // The first element is released right away, and each of the next 10
+  // elements waits for a token.
+  REQUIRE(steady::now() - start >= 90ms);
+}
+
+TEST_CASE("try_pop_for() does not wait past its deadline for a token") {
+  amz::bounded_channel<int> channel{16};
+  channel.set_rate_limit(0.1);
+  channel.push(1);
+  channel.push(2);
+
+  int value;
+  REQUIRE(channel.try_pop_for(10ms, value) == amz::channel_op_status::success);
+  auto const start = steady::now();
+  REQUIRE(channel.try_pop_for(20ms, value) == amz::channel_op_status::timeout);
+  auto const elapsed = steady::now() - start;
+  REQUIRE(elapsed >= 20ms);
+  REQUIRE(elapsed < 5s);
+  REQUIRE(channel.size() == 1);
+}
+
+TEST_CASE("clearing the rate limit wakes up consumers waiting for a token") {
+  amz::bounded_channel<int> channel{16};
+  channel.set_rate_limit(0.01);
+  channel.push(1);
+  channel.push(2);
+  int value;
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+
+  std::thread consumer{[&] {
+    int v;
+    REQUIRE(channel.pop(v) == amz::channel_op_status::success);
+    REQUIRE(v == 2);
+  }};
+  std::this_thread::sleep_for(20ms);
+  REQUIRE(channel.size() == 1);
+  channel.clear_rate_limit();
+  consumer.join();
+}
+
+TEST_CASE("batch operations only pop as many elements as there are tokens") {
+  amz::bounded_channel<int> channel{16};
+  channel.set_rate_limit(0.01, 2);
+  for (int i = 0; i != 5; ++i)
+    channel.push(i);
+
+  std::vector<int> out;
+  auto result = channel.pop_some(std::back_inserter(out), 5);
+  REQUIRE(result.first == amz::channel_op_status::success);
+  REQUIRE(out == (std::vector<int>{0, 1}));
+
+  channel.set_rate_limit(0.01, 2);
+  out.clear();
+  result = channel.pop_some_while(std::back_inserter(out), 5, [](int v) { return v < 3; });
+  REQUIRE(out == (std::vector<int>{2}));
+  // The token taken for the element rejected by the predicate was given back.
+  int value;
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 3);
+
+  channel.set_rate_limit(0.01, 3);
+  channel.push(5);
+  out.clear();
+  result = channel.pop_batch(std::back_inserter(out), 10, 1ms);
+  REQUIRE(out == (std::vector<int>{4, 5}));
+}
+
+TEST_CASE("a paced channel applies backpressure to producers") {
+  amz::bounded_channel<int> channel{2};
+  channel.set_rate_limit(200);
+  std::thread consumer{[&] {
+    int value;
+    while (channel.pop(value) == amz::channel_op_status::success) { }
+  }};
+
+  auto const start = steady::now();
+  for (int i = 0; i != 22; ++i)
+    REQUIRE(channel.push(i) == amz::channel_op_status::success);
+  // At most capacity + 1 elements can be pushed ahead of the pace.
+  REQUIRE(steady::now() - start >= 90ms);
+  channel.close();
+  consumer.join();
+}
+
+TEST_CASE("a closed channel is still paced until it is empty") {
+  amz::bounded_channel<int> channel{16};
+  channel.set_rate_limit(0.01);
+  channel.push(1);
+  channel.push(2);
+  int value;
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+  channel.close();
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::timeout);
+  channel.clear_rate_limit();
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+  REQUIRE(channel.pop(value) == amz::channel_op_status::closed);
+}
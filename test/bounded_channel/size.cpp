@@ -0,0 +1,64 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/bounded_channel.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <deque>
+#include <iterator>
+#include <vector>
+
+
+TEST_CASE("size() follows the pushing and popping operations") {
+  amz::bounded_channel<int> channel{8};
+  REQUIRE(channel.capacity() == 8);
+  REQUIRE(channel.size() == 0);
+
+  channel.push(1);
+  channel.try_push(2);
+  int const more[] = {3, 4, 5};
+  channel.push_range(std::begin(more), std::end(more));
+  REQUIRE(channel.size() == 5);
+
+  int value;
+  channel.pop(value);
+  channel.try_pop(value);
+  REQUIRE(channel.size() == 3);
+
+  std::vector<int> out;
+  channel.pop_some(std::back_inserter(out), 2);
+  REQUIRE(channel.size() == 1);
+
+  std::deque<int> drained;
+  channel.drain(drained);
+  REQUIRE(channel.size() == 0);
+}
+
+TEST_CASE("size() accounts for the initial contents of the channel") {
+  amz::bounded_channel<int> channel{8, std::deque<int>{1, 2, 3}};
+  REQUIRE(channel.size() == 3);
+}
+
+TEST_CASE("size() accounts for expired elements that were discarded") {
+  amz::bounded_channel<amz::expiring<int>> channel{8};
+  channel.push(amz::expire_after(std::chrono::hours{-1}, 1));
+  channel.push(amz::expire_after(std::chrono::hours{1}, 2));
+  REQUIRE(channel.size() == 2);
+
+  amz::expiring<int> value;
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::success);
+  REQUIRE(value.value == 2);
+  REQUIRE(channel.size() == 0);
+}
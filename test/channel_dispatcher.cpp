@@ -0,0 +1,128 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/bounded_channel.hpp>
+#include <amz/channel_dispatcher.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+TEST_CASE("elements go to the least loaded of two channels") {
+  amz::bounded_channel<int> busy{100};
+  amz::bounded_channel<int> idle{100};
+  for (int i = 0; i != 10; ++i)
+    busy.push(i);
+
+  amz::channel_dispatcher<amz::bounded_channel<int>> dispatcher{{&busy, &idle}};
+  REQUIRE(dispatcher.channel_count() == 2);
+  for (int i = 0; i != 5; ++i)
+    REQUIRE(dispatcher.push(i) == amz::channel_op_status::success);
+  REQUIRE(busy.size() == 10);
+  REQUIRE(idle.size() == 5);
+}
+
+TEST_CASE("full channels are skipped") {
+  std::vector<std::unique_ptr<amz::bounded_channel<int>>> channels;
+  std::vector<amz::bounded_channel<int>*> pointers;
+  for (int i = 0; i != 4; ++i) {
+    channels.push_back(std::make_unique<amz::bounded_channel<int>>(2));
+    pointers.push_back(channels.back().get());
+  }
+  amz::channel_dispatcher<amz::bounded_channel<int>> dispatcher{pointers};
+
+  for (int i = 0; i != 8; ++i)
+    REQUIRE(dispatcher.try_push(i) == amz::channel_op_status::success);
+  for (auto const& channel : channels)
+    REQUIRE(channel->size() == 2);
+  REQUIRE(dispatcher.try_push(8) == amz::channel_op_status::full);
+}
+
+TEST_CASE("closed channels are skipped") {
+  amz::bounded_channel<int> closed{8};
+  amz::bounded_channel<int> open{8};
+  closed.close();
+  amz::channel_dispatcher<amz::bounded_channel<int>> dispatcher{{&closed, &open}};
+  for (int i = 0; i != 8; ++i)
+    REQUIRE(dispatcher.try_push(i) == amz::channel_op_status::success);
+  REQUIRE(open.size() == 8);
+
+  open.close();
+  REQUIRE(dispatcher.try_push(0) == amz::channel_op_status::closed);
+  REQUIRE(dispatcher.push(0) == amz::channel_op_status::closed);
+}
+
+TEST_CASE("the value is not moved from when no channel accepts it") {
+  amz::bounded_channel<std::unique_ptr<int>> channel{1};
+  channel.push(std::make_unique<int>(0));
+  amz::channel_dispatcher<amz::bounded_channel<std::unique_ptr<int>>> dispatcher{{&channel}};
+
+  auto value = std::make_unique<int>(1);
+  REQUIRE(dispatcher.try_push(std::move(value)) == amz::channel_op_status::full);
+  REQUIRE(value != nullptr);
+}
+
+TEST_CASE("push() blocks when all the channels are full") {
+  amz::bounded_channel<int> a{1};
+  amz::bounded_channel<int> b{1};
+  a.push(0);
+  b.push(0);
+  amz::channel_dispatcher<amz::bounded_channel<int>> dispatcher{{&a, &b}};
+
+  std::thread producer{[&] {
+    REQUIRE(dispatcher.push(1) == amz::channel_op_status::success);
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{20});
+  int value;
+  a.pop(value);
+  b.pop(value);
+  producer.join();
+  REQUIRE(a.size() + b.size() == 1);
+}
+
+TEST_CASE("load follows the speed of the consumers") {
+  amz::bounded_channel<int> fast{64};
+  amz::bounded_channel<int> slow{64};
+  amz::channel_dispatcher<amz::bounded_channel<int>> dispatcher{{&fast, &slow}};
+
+  std::size_t fast_count = 0;
+  std::size_t slow_count = 0;
+  std::thread fast_consumer{[&] {
+    int value;
+    while (fast.pop(value) == amz::channel_op_status::success)
+      ++fast_count;
+  }};
+  std::thread slow_consumer{[&] {
+    int value;
+    while (slow.pop(value) == amz::channel_op_status::success) {
+      ++slow_count;
+      std::this_thread::sleep_for(std::chrono::microseconds{200});
+    }
+  }};
+
+  for (int i = 0; i != 2000; ++i)
+    REQUIRE(dispatcher.push(i) == amz::channel_op_status::success);
+  fast.close();
+  slow.close();
+  fast_consumer.join();
+  slow_consumer.join();
+
+  REQUIRE(fast_count + slow_count == 2000);
+  REQUIRE(fast_count > slow_count);
+}
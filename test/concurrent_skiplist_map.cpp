@@ -0,0 +1,194 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/concurrent_skiplist_map.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+
+using namespace std::chrono_literals;
+using map_type = amz::concurrent_skiplist_map<int, std::string>;
+
+static std::vector<int> keys_of(map_type const& map) {
+  std::vector<int> keys;
+  for (auto const& kv : map)
+    keys.push_back(kv.first);
+  return keys;
+}
+
+TEST_CASE("an empty map has no elements") {
+  map_type map{10ms};
+  REQUIRE(map.empty());
+  REQUIRE(map.size() == 0);
+  REQUIRE(map.begin() == map.end());
+  REQUIRE(map.find(1) == map.end());
+  REQUIRE(!map.contains(1));
+  REQUIRE(map.lower_bound(1) == map.end());
+  REQUIRE(!map.erase(1));
+}
+
+TEST_CASE("elements are kept in key order") {
+  map_type map{10ms};
+  for (int k : {5, 1, 9, 3, 7})
+    REQUIRE(map.insert(k, std::to_string(k)));
+  REQUIRE(map.size() == 5);
+  REQUIRE(keys_of(map) == (std::vector<int>{1, 3, 5, 7, 9}));
+
+  auto it = map.find(7);
+  REQUIRE(it != map.end());
+  REQUIRE(it->first == 7);
+  REQUIRE(it->second == "7");
+  REQUIRE(map.find(4) == map.end());
+}
+
+TEST_CASE("insert() does not replace an existing element") {
+  map_type map{10ms};
+  REQUIRE(map.insert(1, "first"));
+  REQUIRE(!map.insert(1, "second"));
+  REQUIRE(map.size() == 1);
+  REQUIRE(map.find(1)->second == "first");
+}
+
+TEST_CASE("erase() removes elements") {
+  map_type map{10ms};
+  for (int k = 0; k != 100; ++k)
+    map.insert(k, std::to_string(k));
+  for (int k = 0; k != 100; k += 2)
+    REQUIRE(map.erase(k));
+  REQUIRE(!map.erase(0));
+  REQUIRE(map.size() == 50);
+
+  std::vector<int> expected;
+  for (int k = 1; k < 100; k += 2)
+    expected.push_back(k);
+  REQUIRE(keys_of(map) == expected);
+
+  // Erased keys can be inserted again
+  REQUIRE(map.insert(0, "zero"));
+  REQUIRE(map.find(0)->second == "zero");
+}
+
+TEST_CASE("lower_bound() supports range scans") {
+  map_type map{10ms};
+  for (int k = 0; k != 100; k += 10)
+    map.insert(k, std::to_string(k));
+
+  std::vector<int> keys;
+  for (auto it = map.lower_bound(25); it != map.end() && it->first < 60; ++it)
+    keys.push_back(it->first);
+  REQUIRE(keys == (std::vector<int>{30, 40, 50}));
+
+  REQUIRE(map.lower_bound(30)->first == 30);
+  REQUIRE(map.lower_bound(91) == map.end());
+}
+
+TEST_CASE("a custom comparator defines the order") {
+  amz::concurrent_skiplist_map<int, int, std::greater<int>> map{10ms};
+  for (int k : {2, 3, 1})
+    map.insert(k, k);
+  std::vector<int> keys;
+  for (auto const& kv : map)
+    keys.push_back(kv.first);
+  REQUIRE(keys == (std::vector<int>{3, 2, 1}));
+}
+
+TEST_CASE("an iterator to an erased element can still be incremented") {
+  map_type map{1s};
+  for (int k = 0; k != 5; ++k)
+    map.insert(k, std::to_string(k));
+
+  auto it = map.find(1);
+  map.erase(1);
+  map.erase(2);
+  REQUIRE(it->first == 1); // the node is still alive during the grace period
+  ++it;
+  REQUIRE(it->first == 3);
+}
+
+TEST_CASE("erased elements are destroyed after the grace period") {
+  auto tracker = std::make_shared<int>(0);
+  std::weak_ptr<int> weak = tracker;
+  amz::concurrent_skiplist_map<int, std::shared_ptr<int>> map{10ms};
+  map.insert(1, std::move(tracker));
+  map.erase(1);
+  map.purge();
+  REQUIRE(!weak.expired());
+
+  std::this_thread::sleep_for(20ms);
+  map.purge();
+  REQUIRE(weak.expired());
+}
+
+TEST_CASE("concurrent writers and readers see a consistent map") {
+  constexpr int writers = 4;
+  constexpr int keys_per_writer = 2000;
+  map_type map{200ms};
+  std::atomic<bool> done{false};
+  std::atomic<bool> ordered{true};
+
+  // Readers scan the map while writers modify it, and check that the scans
+  // always see increasing keys.
+  std::vector<std::thread> readers;
+  for (int r = 0; r != 2; ++r) {
+    readers.emplace_back([&] {
+      while (!done.load()) {
+        int previous = -1;
+        for (auto const& kv : map) {
+          if (kv.first <= previous || kv.second != std::to_string(kv.first))
+            ordered = false;
+          previous = kv.first;
+        }
+      }
+    });
+  }
+
+  // Each writer inserts its own keys (interleaved with the other writers),
+  // and then erases every odd one of them.
+  std::vector<std::thread> threads;
+  for (int w = 0; w != writers; ++w) {
+    threads.emplace_back([&, w] {
+      for (int i = 0; i != keys_per_writer; ++i) {
+        int const k = i * writers + w;
+        map.insert(k, std::to_string(k));
+        map.insert(k, "duplicate");
+      }
+      for (int i = 0; i != keys_per_writer; ++i) {
+        int const k = i * writers + w;
+        if (k % 2 == 1)
+          map.erase(k);
+      }
+    });
+  }
+  for (auto& t : threads)
+    t.join();
+  done = true;
+  for (auto& t : readers)
+    t.join();
+
+  REQUIRE(ordered);
+  REQUIRE(map.size() == writers * keys_per_writer / 2);
+  std::vector<int> expected;
+  for (int k = 0; k < writers * keys_per_writer; k += 2)
+    expected.push_back(k);
+  REQUIRE(keys_of(map) == expected);
+}
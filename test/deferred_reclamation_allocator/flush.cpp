@@ -0,0 +1,108 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/deferred_reclamation_allocator.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <thread>
+
+
+struct OnDestruction {
+  OnDestruction(std::function<void()> f) : callback(f) { }
+  ~OnDestruction() { callback(); }
+  std::function<void()> callback;
+};
+
+using ValueType = OnDestruction;
+using UnderlyingAllocator = std::allocator<ValueType>;
+using Allocator = amz::deferred_reclamation_allocator<UnderlyingAllocator>;
+
+static void deallocate_one(Allocator& allocator, std::function<void()> on_destruction) {
+  ValueType* p = allocator.allocate(1);
+  allocator.construct(p, on_destruction);
+  allocator.destroy(p);
+  allocator.deallocate(p, 1);
+}
+
+TEST_CASE("flushing makes a partially filled delay buffer reclaimable") {
+  auto const timeout = std::chrono::milliseconds{5};
+  Allocator allocator{UnderlyingAllocator{}, timeout, 10};
+
+  int destroyed = 0;
+  for (int i = 0; i != 3; ++i)
+    deallocate_one(allocator, [&] { ++destroyed; });
+  REQUIRE(allocator.has_unflushed_elements());
+  REQUIRE(!allocator.next_purge_deadline());
+
+  auto const before = std::chrono::steady_clock::now();
+  REQUIRE(allocator.flush());
+  REQUIRE(!allocator.has_unflushed_elements());
+  REQUIRE(allocator.next_purge_deadline().has_value());
+  REQUIRE(*allocator.next_purge_deadline() > before + timeout);
+
+  allocator.purge(amz::purge_mode::opportunistic);
+  REQUIRE(destroyed == 0);
+
+  std::this_thread::sleep_until(*allocator.next_purge_deadline());
+  allocator.purge(amz::purge_mode::opportunistic);
+  REQUIRE(destroyed == 3);
+  REQUIRE(!allocator.next_purge_deadline());
+}
+
+TEST_CASE("flushing an empty delay buffer does nothing") {
+  Allocator allocator{UnderlyingAllocator{}, std::chrono::milliseconds{5}, 10};
+  REQUIRE(allocator.flush());
+  REQUIRE(!allocator.next_purge_deadline());
+}
+
+TEST_CASE("the next purge deadline is the one of the oldest buffer") {
+  auto const timeout = std::chrono::milliseconds{50};
+  Allocator allocator{UnderlyingAllocator{}, timeout, 1};
+
+  int destroyed = 0;
+  deallocate_one(allocator, [&] { ++destroyed; });
+  auto const first = allocator.next_purge_deadline();
+  REQUIRE(first.has_value());
+
+  std::this_thread::sleep_for(std::chrono::milliseconds{5});
+  deallocate_one(allocator, [&] { ++destroyed; });
+  REQUIRE((allocator.next_purge_deadline() == first));
+
+  std::this_thread::sleep_until(*first);
+  allocator.purge(amz::purge_mode::opportunistic);
+  REQUIRE(destroyed == 1);
+  REQUIRE(allocator.next_purge_deadline().has_value());
+  REQUIRE(*allocator.next_purge_deadline() > *first);
+}
+
+TEST_CASE("flushed and full buffers can be mixed on the delay list") {
+  auto const timeout = std::chrono::milliseconds{2};
+  Allocator allocator{UnderlyingAllocator{}, timeout, 3};
+
+  int destroyed = 0;
+  deallocate_one(allocator, [&] { ++destroyed; });
+  allocator.flush();
+  for (int i = 0; i != 3; ++i)
+    deallocate_one(allocator, [&] { ++destroyed; });
+  deallocate_one(allocator, [&] { ++destroyed; });
+  allocator.flush();
+
+  allocator.purge(amz::purge_mode::exhaustive);
+  REQUIRE(destroyed == 5);
+}
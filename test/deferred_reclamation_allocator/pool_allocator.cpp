@@ -0,0 +1,92 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/deferred_reclamation_allocator.hpp>
+#include <amz/pool_allocator.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+
+
+struct OnDestruction {
+  explicit OnDestruction(int& count) : count(count) { }
+  ~OnDestruction() { ++count; }
+  int& count;
+};
+
+TEST_CASE("pool_allocator can be used as the underlying allocator") {
+  using Allocator = amz::deferred_reclamation_allocator<amz::pool_allocator<OnDestruction>>;
+  int destroyed = 0;
+  {
+    Allocator allocator{std::chrono::milliseconds{1}, 16};
+    for (int i = 0; i != 1000; ++i) {
+      OnDestruction* p = allocator.allocate(1);
+      allocator.construct(p, destroyed);
+      allocator.destroy(p);
+      allocator.deallocate(p, 1);
+    }
+    allocator.purge(amz::purge_mode::exhaustive);
+  }
+  REQUIRE(destroyed == 1000);
+}
+
+// An allocator that checks that memory is deallocated with the same size as
+// it was allocated with, like sized deallocation functions require.
+template <typename T>
+struct size_checking_allocator {
+  using value_type = T;
+
+  explicit size_checking_allocator(std::map<void*, std::size_t>& sizes) : sizes(&sizes) { }
+
+  template <typename U>
+  size_checking_allocator(size_checking_allocator<U> const& other) : sizes(other.sizes) { }
+
+  T* allocate(std::size_t n) {
+    T* p = std::allocator<T>{}.allocate(n);
+    (*sizes)[p] = n;
+    return p;
+  }
+
+  void deallocate(T* p, std::size_t n) {
+    REQUIRE(sizes->count(p) == 1);
+    REQUIRE((*sizes)[p] == n);
+    sizes->erase(p);
+    std::allocator<T>{}.deallocate(p, n);
+  }
+
+  friend bool operator==(size_checking_allocator const& a, size_checking_allocator const& b)
+  { return a.sizes == b.sizes; }
+
+  std::map<void*, std::size_t>* sizes;
+};
+
+TEST_CASE("delay buffers are deallocated with the size they were allocated with") {
+  using Allocator = amz::deferred_reclamation_allocator<size_checking_allocator<std::string>>;
+  std::map<void*, std::size_t> sizes;
+  {
+    Allocator allocator{size_checking_allocator<std::string>{sizes}, std::chrono::milliseconds{1}, 4};
+    for (int i = 0; i != 100; ++i) {
+      std::string* p = allocator.allocate(1);
+      allocator.construct(p, "abc");
+      allocator.destroy(p);
+      allocator.deallocate(p, 1);
+    }
+  }
+  REQUIRE(sizes.empty());
+}
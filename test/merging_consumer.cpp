@@ -0,0 +1,185 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/bounded_channel.hpp>
+#include <amz/merging_consumer.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+namespace {
+  using channel = amz::bounded_channel<int>;
+
+  std::vector<channel*> pointers(std::vector<std::unique_ptr<channel>> const& channels) {
+    std::vector<channel*> result;
+    for (auto const& c : channels)
+      result.push_back(c.get());
+    return result;
+  }
+}
+
+TEST_CASE("inputs are merged in order") {
+  for (std::size_t n = 1; n != 8; ++n) {
+    std::vector<std::unique_ptr<channel>> channels;
+    std::vector<int> expected;
+    for (std::size_t i = 0; i != n; ++i) {
+      channels.push_back(std::make_unique<channel>(64));
+      for (int k = 0; k != 10; ++k) {
+        int const value = static_cast<int>(k * n + (n - 1 - i)); // interleaved inputs
+        channels.back()->push(value);
+        expected.push_back(value);
+      }
+      channels.back()->close();
+    }
+    std::sort(expected.begin(), expected.end());
+
+    amz::merging_consumer<channel> merge{pointers(channels)};
+    REQUIRE(merge.input_count() == n);
+    std::vector<int> actual;
+    int value;
+    while (merge.pop(value) == amz::channel_op_status::success)
+      actual.push_back(value);
+    REQUIRE(actual == expected);
+    REQUIRE(merge.pop(value) == amz::channel_op_status::closed);
+  }
+}
+
+TEST_CASE("the comparison can be customized") {
+  channel a{8}, b{8};
+  for (int v : {5, 3, 1}) a.push(v);
+  for (int v : {6, 4, 2}) b.push(v);
+  a.close();
+  b.close();
+
+  amz::merging_consumer<channel, std::greater<int>> merge{{&a, &b}};
+  std::vector<int> actual;
+  int value;
+  while (merge.try_pop(value) == amz::channel_op_status::success)
+    actual.push_back(value);
+  REQUIRE(actual == (std::vector<int>{6, 5, 4, 3, 2, 1}));
+}
+
+TEST_CASE("try_pop() returns empty while an open input is empty") {
+  channel a{8}, b{8};
+  a.push(1);
+  a.push(2);
+  amz::merging_consumer<channel> merge{{&a, &b}};
+
+  int value;
+  REQUIRE(merge.try_pop(value) == amz::channel_op_status::empty);
+  b.push(3);
+  REQUIRE(merge.try_pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 1);
+  REQUIRE(merge.try_pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 2);
+  // The next element of `a` could still be smaller than 3.
+  REQUIRE(merge.try_pop(value) == amz::channel_op_status::empty);
+
+  a.close();
+  REQUIRE(merge.try_pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 3);
+  REQUIRE(merge.try_pop(value) == amz::channel_op_status::empty);
+  b.close();
+  REQUIRE(merge.try_pop(value) == amz::channel_op_status::closed);
+}
+
+TEST_CASE("pop() blocks until the lagging input catches up") {
+  channel fast{64}, slow{64};
+  for (int v : {1, 3, 5, 7})
+    fast.push(v);
+  fast.close();
+
+  std::thread producer{[&] {
+    for (int v : {2, 4, 6, 8}) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{5});
+      slow.push(v);
+    }
+    slow.close();
+  }};
+
+  amz::merging_consumer<channel> merge{{&fast, &slow}};
+  std::vector<int> actual;
+  int value;
+  while (merge.pop(value) == amz::channel_op_status::success)
+    actual.push_back(value);
+  producer.join();
+  REQUIRE(actual == (std::vector<int>{1, 2, 3, 4, 5, 6, 7, 8}));
+}
+
+TEST_CASE("concurrent producers are merged into a sorted stream") {
+  constexpr std::size_t inputs = 5;
+  constexpr int per_input = 2000;
+  std::vector<std::unique_ptr<channel>> channels;
+  for (std::size_t i = 0; i != inputs; ++i)
+    channels.push_back(std::make_unique<channel>(16));
+
+  std::vector<std::thread> producers;
+  for (std::size_t i = 0; i != inputs; ++i) {
+    producers.emplace_back([&, i] {
+      std::mt19937 random{static_cast<unsigned>(i)};
+      int timestamp = 0;
+      for (int k = 0; k != per_input; ++k) {
+        timestamp += std::uniform_int_distribution<int>{0, 10}(random);
+        channels[i]->push(timestamp);
+      }
+      channels[i]->close();
+    });
+  }
+
+  amz::merging_consumer<channel> merge{pointers(channels)};
+  std::vector<int> actual;
+  int value;
+  while (merge.pop(value) == amz::channel_op_status::success)
+    actual.push_back(value);
+  for (auto& t : producers)
+    t.join();
+
+  REQUIRE(actual.size() == inputs * per_input);
+  REQUIRE(std::is_sorted(actual.begin(), actual.end()));
+}
+
+TEST_CASE("try_pop() returns empty while a paced input has no token") {
+  channel paced{64}, other{64};
+  paced.set_rate_limit(0.01, 1);
+  for (int i : {0, 2, 4})
+    paced.push(i);
+  other.push(1);
+  other.close();
+
+  // Use up the only token of the paced input.
+  int value;
+  REQUIRE(paced.try_pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 0);
+
+  amz::merging_consumer<channel> merge{{&paced, &other}};
+  REQUIRE(merge.try_pop(value) == amz::channel_op_status::empty);
+  REQUIRE(merge.try_pop(value) == amz::channel_op_status::empty);
+
+  paced.clear_rate_limit();
+  paced.close();
+  std::vector<int> actual;
+  while (merge.try_pop(value) == amz::channel_op_status::success)
+    actual.push_back(value);
+  REQUIRE(actual == (std::vector<int>{1, 2, 4}));
+  REQUIRE(merge.try_pop(value) == amz::channel_op_status::closed);
+}
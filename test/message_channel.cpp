@@ -0,0 +1,221 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/message_channel.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct small { std::uint8_t value; };
+struct large { std::array<std::uint64_t, 8> values; };
+struct alignas(16) aligned { long double value; };
+struct text { std::string value; };
+
+// Records which message was received, in order.
+struct recorder {
+  std::vector<std::string>& received;
+  void operator()(small&& m) const { received.push_back("small " + std::to_string(m.value)); }
+  void operator()(large&& m) const { received.push_back("large " + std::to_string(m.values[7])); }
+  void operator()(aligned&& m) const { received.push_back("aligned " + std::to_string(static_cast<int>(m.value))); }
+  void operator()(text&& m) const { received.push_back("text " + m.value); }
+};
+
+using Channel = amz::message_channel<small, large, aligned, text>;
+
+TEST_CASE("messages of different types are received in order with their type") {
+  Channel channel{1024};
+  large l{};
+  l.values[7] = 7;
+  REQUIRE(channel.push(small{1}) == amz::channel_op_status::success);
+  REQUIRE(channel.push(l) == amz::channel_op_status::success);
+  REQUIRE(channel.emplace<aligned>(aligned{3.0L}) == amz::channel_op_status::success);
+  REQUIRE(channel.emplace<text>(text{"hello"}) == amz::channel_op_status::success);
+
+  std::vector<std::string> received;
+  recorder r{received};
+  while (channel.try_pop(r) == amz::channel_op_status::success)
+    ;
+  REQUIRE(received == (std::vector<std::string>{"small 1", "large 7", "aligned 3", "text hello"}));
+}
+
+TEST_CASE("aligned messages are properly aligned in the ring") {
+  amz::message_channel<small, aligned> channel{256};
+  for (int i = 0; i != 20; ++i) {
+    channel.push(small{static_cast<std::uint8_t>(i)});
+    channel.push(aligned{static_cast<long double>(i)});
+    bool ok = true;
+    auto check = [&](auto&& m) {
+      ok = ok && reinterpret_cast<std::uintptr_t>(&m) % alignof(decltype(m)) == 0;
+    };
+    channel.try_pop(check);
+    channel.try_pop(check);
+    REQUIRE(ok);
+  }
+}
+
+TEST_CASE("the ring wraps around") {
+  Channel channel{200};
+  std::vector<std::string> received;
+  std::vector<std::string> expected;
+  recorder r{received};
+  for (int i = 0; i != 1000; ++i) {
+    if (i % 3 == 0) {
+      large l{};
+      l.values[7] = static_cast<std::uint64_t>(i);
+      REQUIRE(channel.try_emplace<large>(l) == amz::channel_op_status::success);
+      expected.push_back("large " + std::to_string(i));
+    } else {
+      REQUIRE(channel.try_emplace<small>(small{static_cast<std::uint8_t>(i % 256)}) == amz::channel_op_status::success);
+      expected.push_back("small " + std::to_string(i % 256));
+    }
+    if (i % 2 == 1) {
+      REQUIRE(channel.try_pop(r) == amz::channel_op_status::success);
+      REQUIRE(channel.try_pop(r) == amz::channel_op_status::success);
+    }
+  }
+  while (channel.try_pop(r) == amz::channel_op_status::success)
+    ;
+  REQUIRE(received == expected);
+}
+
+TEST_CASE("the ring wraps around when the space left at its end is a single header") {
+  // Records for a `std::uint32_t` take 16 bytes, so 6 of them fill 96 bytes
+  // out of 104, and the 7th one has to skip the last 8 bytes of the ring.
+  amz::message_channel<std::uint32_t> channel{100};
+  std::uint32_t pushed = 0;
+  while (channel.try_emplace<std::uint32_t>(pushed) == amz::channel_op_status::success)
+    ++pushed;
+  REQUIRE(pushed == 6);
+
+  std::vector<std::uint32_t> received;
+  auto record = [&](std::uint32_t value) { received.push_back(value); };
+  REQUIRE(channel.try_pop(record) == amz::channel_op_status::success);
+  REQUIRE(channel.try_emplace<std::uint32_t>(pushed++) == amz::channel_op_status::success);
+  REQUIRE(channel.try_emplace<std::uint32_t>(pushed) == amz::channel_op_status::full);
+  while (channel.try_pop(record) == amz::channel_op_status::success)
+    ;
+  REQUIRE(received == (std::vector<std::uint32_t>{0, 1, 2, 3, 4, 5, 6}));
+}
+
+TEST_CASE("try_emplace() returns full when there is not enough room") {
+  amz::message_channel<large> channel{2 * (sizeof(large) + 8)};
+  REQUIRE(channel.try_emplace<large>() == amz::channel_op_status::success);
+  REQUIRE(channel.try_emplace<large>() == amz::channel_op_status::success);
+  REQUIRE(channel.try_emplace<large>() == amz::channel_op_status::full);
+  REQUIRE(channel.try_pop([](large&&) { }) == amz::channel_op_status::success);
+  REQUIRE(channel.try_emplace<large>() == amz::channel_op_status::success);
+}
+
+TEST_CASE("emplace() blocks until consumers make room") {
+  amz::message_channel<large> channel{sizeof(large) + 8};
+  REQUIRE(channel.emplace<large>() == amz::channel_op_status::success);
+
+  std::atomic<bool> pushed{false};
+  std::thread producer{[&] {
+    REQUIRE(channel.emplace<large>() == amz::channel_op_status::success);
+    pushed = true;
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  REQUIRE(!pushed);
+  REQUIRE(channel.pop([](large&&) { }) == amz::channel_op_status::success);
+  producer.join();
+  REQUIRE(pushed);
+}
+
+TEST_CASE("closing the channel lets consumers drain it") {
+  Channel channel{1024};
+  channel.push(small{1});
+  channel.close();
+  REQUIRE(channel.push(small{2}) == amz::channel_op_status::closed);
+  REQUIRE(channel.try_emplace<small>(small{2}) == amz::channel_op_status::closed);
+
+  std::vector<std::string> received;
+  recorder r{received};
+  REQUIRE(channel.pop(r) == amz::channel_op_status::success);
+  REQUIRE(channel.pop(r) == amz::channel_op_status::closed);
+  REQUIRE(channel.try_pop(r) == amz::channel_op_status::closed);
+}
+
+TEST_CASE("messages left in the channel are destroyed with it") {
+  auto token = std::make_shared<int>(0);
+  {
+    amz::message_channel<small, std::shared_ptr<int>> channel{1024};
+    for (int i = 0; i != 10; ++i) {
+      channel.push(small{0});
+      channel.push(token);
+    }
+    REQUIRE(token.use_count() == 11);
+    channel.try_pop([](auto&&) { });
+    channel.try_pop([](auto&&) { });
+    REQUIRE(token.use_count() == 10);
+  }
+  REQUIRE(token.use_count() == 1);
+}
+
+TEST_CASE("a throwing constructor leaves the channel unchanged") {
+  struct throwing {
+    throwing() = default;
+    throwing(throwing&&) noexcept = default;
+    explicit throwing(int) { throw 42; }
+    char data[64];
+  };
+  amz::message_channel<throwing, small> channel{3 * 72 - 8};
+  channel.emplace<throwing>();
+  channel.emplace<throwing>();
+  channel.try_pop([](auto&&) { });
+  // The next message would wrap around; make sure no padding is left behind.
+  REQUIRE_THROWS(channel.emplace<throwing>(1));
+  channel.try_pop([](auto&&) { });
+  REQUIRE(channel.try_pop([](auto&&) { }) == amz::channel_op_status::empty);
+}
+
+TEST_CASE("messages can be exchanged between threads") {
+  amz::message_channel<small, large> channel{512};
+  int const n = 50000;
+  std::thread producer{[&] {
+    for (int i = 0; i != n; ++i) {
+      if (i % 2 == 0) {
+        channel.push(small{static_cast<std::uint8_t>(i % 256)});
+      } else {
+        large l{};
+        l.values[7] = static_cast<std::uint64_t>(i);
+        channel.push(l);
+      }
+    }
+    channel.close();
+  }};
+
+  int count = 0;
+  bool in_order = true;
+  struct visitor {
+    int& count;
+    bool& in_order;
+    void operator()(small&& m) const { in_order = in_order && count % 2 == 0 && m.value == count % 256; ++count; }
+    void operator()(large&& m) const { in_order = in_order && count % 2 == 1 && m.values[7] == static_cast<std::uint64_t>(count); ++count; }
+  };
+  while (channel.pop(visitor{count, in_order}) == amz::channel_op_status::success)
+    ;
+  producer.join();
+  REQUIRE(count == n);
+  REQUIRE(in_order);
+}
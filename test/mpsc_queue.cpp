@@ -0,0 +1,191 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/mpsc_queue.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+
+struct message : amz::mpsc_queue_hook {
+  message(int producer = 0, int value = 0) : producer{producer}, value{value} { }
+  int producer;
+  int value;
+};
+
+TEST_CASE("try_pop() returns nullptr on an empty queue") {
+  amz::mpsc_queue<message> queue;
+  REQUIRE(queue.empty());
+  REQUIRE(queue.try_pop() == nullptr);
+  REQUIRE(queue.empty());
+}
+
+TEST_CASE("nodes are popped in FIFO order") {
+  amz::mpsc_queue<message> queue;
+  message a{0, 1}, b{0, 2}, c{0, 3};
+  queue.push(a);
+  REQUIRE(!queue.empty());
+  queue.push(b);
+
+  REQUIRE(queue.try_pop() == &a);
+  queue.push(c);
+  REQUIRE(queue.try_pop() == &b);
+  REQUIRE(queue.try_pop() == &c);
+  REQUIRE(queue.try_pop() == nullptr);
+  REQUIRE(queue.empty());
+
+  // Nodes can be pushed again once popped
+  queue.push(a);
+  REQUIRE(queue.try_pop() == &a);
+  REQUIRE(queue.try_pop() == nullptr);
+}
+
+TEST_CASE("empty() is false while a popped node is followed by another one") {
+  amz::mpsc_queue<message> queue;
+  message a{0, 1}, b{0, 2}, c{0, 3};
+  queue.push(a);
+  queue.push(b);
+  REQUIRE(queue.try_pop() == &a);
+  REQUIRE(!queue.empty());
+  REQUIRE(queue.try_pop() == &b);
+  REQUIRE(queue.empty());
+
+  // Once the stub has been pushed behind the last node
+  queue.push(c);
+  REQUIRE(!queue.empty());
+  REQUIRE(queue.try_pop() == &c);
+  REQUIRE(queue.empty());
+}
+
+TEST_CASE("pop_all() pops every available node in order") {
+  amz::mpsc_queue<message> queue;
+  std::vector<message> messages;
+  for (int i = 0; i != 10; ++i)
+    messages.emplace_back(0, i);
+  for (message& m : messages)
+    queue.push(m);
+
+  std::vector<int> values;
+  std::size_t const n = queue.pop_all([&](message& m) { values.push_back(m.value); });
+  REQUIRE(n == 10);
+  REQUIRE(values == (std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+  REQUIRE(queue.empty());
+  REQUIRE(queue.pop_all([](message&) { FAIL("the queue should be empty"); }) == 0);
+}
+
+TEST_CASE("pop_all() allows pushing popped nodes back") {
+  amz::mpsc_queue<message> queue;
+  message a{0, 1};
+  queue.push(a);
+
+  int calls = 0;
+  queue.pop_all([&](message& m) {
+    // Only push back once, otherwise pop_all might never end
+    if (calls++ == 0)
+      queue.push(m);
+  });
+  REQUIRE(calls >= 1);
+  while (queue.try_pop() != nullptr)
+    ++calls;
+  REQUIRE(calls == 2);
+}
+
+TEST_CASE("pop_all() only pops the nodes available when it starts") {
+  amz::mpsc_queue<message> queue;
+  message a{0, 1}, b{0, 2}, c{0, 3};
+  queue.push(a);
+  queue.push(b);
+  REQUIRE(queue.try_pop() == &a);
+  queue.push(c);
+
+  // Every node is pushed back, which would never end if pop_all() popped
+  // the nodes pushed while it is running.
+  std::vector<int> values;
+  std::size_t const n = queue.pop_all([&](message& m) {
+    values.push_back(m.value);
+    queue.push(m);
+  });
+  REQUIRE(n == 2);
+  REQUIRE(values == (std::vector<int>{2, 3}));
+  REQUIRE(!queue.empty());
+  REQUIRE(queue.try_pop() == &b);
+  REQUIRE(queue.try_pop() == &c);
+  REQUIRE(queue.try_pop() == nullptr);
+  REQUIRE(queue.empty());
+}
+
+TEST_CASE("pop_wait() blocks until a node is pushed") {
+  amz::mpsc_queue<message> queue;
+  message a{0, 42};
+
+  std::atomic<bool> started{false};
+  std::thread consumer{[&] {
+    started = true;
+    message& m = queue.pop_wait();
+    REQUIRE(&m == &a);
+  }};
+
+  while (!started) std::this_thread::yield();
+  // Give the consumer a chance to go to sleep
+  std::this_thread::sleep_for(std::chrono::milliseconds{20});
+  queue.push(a);
+  consumer.join();
+}
+
+TEST_CASE("multiple producers and a blocking consumer") {
+  amz::mpsc_queue<message> queue;
+  int const producers = 4;
+  int const per_producer = 20000;
+
+  std::vector<std::unique_ptr<message[]>> storage;
+  for (int p = 0; p != producers; ++p) {
+    storage.emplace_back(new message[per_producer]);
+    for (int i = 0; i != per_producer; ++i)
+      storage.back()[i] = message{p, i};
+  }
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p != producers; ++p) {
+    threads.emplace_back([&, p] {
+      for (int i = 0; i != per_producer; ++i) {
+        queue.push(storage[p][i]);
+        if (i % 1000 == 0)
+          std::this_thread::sleep_for(std::chrono::microseconds{100});
+      }
+    });
+  }
+
+  std::vector<int> next(producers, 0);
+  for (int received = 0; received != producers * per_producer; ++received) {
+    message& m = (received % 2 == 0) ? queue.pop_wait() : [&]() -> message& {
+      message* p;
+      while ((p = queue.try_pop()) == nullptr)
+        std::this_thread::yield();
+      return *p;
+    }();
+    // Nodes pushed by the same producer are popped in order
+    REQUIRE(m.value == next[m.producer]);
+    ++next[m.producer];
+  }
+
+  for (std::thread& t : threads)
+    t.join();
+  REQUIRE(queue.try_pop() == nullptr);
+}
@@ -0,0 +1,92 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/numa.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <set>
+#include <vector>
+
+
+TEST_CASE("the topology has at least one node") {
+  REQUIRE(amz::numa_node_count() >= 1);
+  REQUIRE(amz::current_numa_node() < amz::numa_node_count());
+}
+
+TEST_CASE("there is one memory resource per node") {
+  for (std::size_t node = 0; node != amz::numa_node_count(); ++node) {
+    amz::numa_memory_resource& resource = amz::numa_memory_resource::for_node(node);
+    REQUIRE(resource.node() == node);
+    REQUIRE(&resource == &amz::numa_memory_resource::for_node(node));
+  }
+}
+
+TEST_CASE("small blocks are aligned and reused") {
+  amz::numa_memory_resource& resource = amz::numa_memory_resource::for_node(0);
+  std::set<void*> blocks;
+  for (int i = 0; i != 100; ++i) {
+    void* p = resource.allocate(48, 16);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(p) % 64 == 0); // rounded up to 64 bytes
+    REQUIRE(blocks.insert(p).second);
+  }
+  void* first = *blocks.begin();
+  resource.deallocate(first, 48, 16);
+  REQUIRE(resource.allocate(64, 64) == first);
+
+  for (void* p : blocks)
+    resource.deallocate(p, 48, 16);
+}
+
+TEST_CASE("large blocks are mapped individually") {
+  amz::numa_memory_resource& resource = amz::numa_memory_resource::for_node(0);
+  std::size_t const size = amz::numa_memory_resource::max_small_size * 3 + 1;
+  char* p = static_cast<char*>(resource.allocate(size));
+  for (std::size_t i = 0; i != size; ++i)
+    p[i] = static_cast<char>(i);
+  for (std::size_t i = 0; i != size; ++i)
+    REQUIRE(p[i] == static_cast<char>(i));
+  resource.deallocate(p, size);
+}
+
+TEST_CASE("numa_allocator can be used with standard containers") {
+  amz::numa_allocator<int> allocator{0};
+  REQUIRE(allocator.node() == 0);
+
+  std::vector<int, amz::numa_allocator<int>> vector(allocator);
+  std::deque<int, amz::numa_allocator<int>> deque(allocator);
+  std::list<int, amz::numa_allocator<int>> list(allocator);
+  for (int i = 0; i != 100000; ++i) {
+    vector.push_back(i);
+    deque.push_back(i);
+    list.push_back(i);
+  }
+  for (int i = 0; i != 100000; ++i) {
+    REQUIRE(vector[i] == i);
+    REQUIRE(deque[i] == i);
+  }
+  REQUIRE(list.size() == 100000);
+}
+
+TEST_CASE("numa_allocators compare equal when they use the same node") {
+  amz::numa_allocator<int> a{0};
+  amz::numa_allocator<long> b{0};
+  REQUIRE(a == b);
+  REQUIRE(!(a != b));
+  REQUIRE(amz::numa_allocator<int>{b} == a);
+}
@@ -0,0 +1,129 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/numa_sharded_channel.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+TEST_CASE("there is one shard per node by default") {
+  amz::numa_sharded_channel<int> channel{16};
+  REQUIRE(channel.shard_count() == amz::numa_node_count());
+  REQUIRE(channel.local_shard() < channel.shard_count());
+
+  REQUIRE(channel.push(1) == amz::channel_op_status::success);
+  int value;
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 1);
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::empty);
+}
+
+TEST_CASE("consumers prefer their own shard") {
+  amz::numa_sharded_channel<int> channel{16, {0, 0}};
+  REQUIRE(channel.shard_count() == 2);
+  REQUIRE(channel.node_of(1) == 0);
+  channel.push_to(0, 0);
+  channel.push_to(1, 1);
+
+  int value;
+  REQUIRE(channel.try_pop_from(1, value) == amz::channel_op_status::success);
+  REQUIRE(value == 1);
+  REQUIRE(channel.try_pop_from(0, value) == amz::channel_op_status::success);
+  REQUIRE(value == 0);
+}
+
+TEST_CASE("consumers steal from other shards when theirs is empty") {
+  amz::numa_sharded_channel<int> channel{16, {0, 0, 0}};
+  channel.push_to(2, 42);
+  REQUIRE(channel.size() == 1);
+
+  int value;
+  REQUIRE(channel.try_pop_from(0, value) == amz::channel_op_status::success);
+  REQUIRE(value == 42);
+  REQUIRE(channel.size() == 0);
+}
+
+TEST_CASE("producers spill to other shards when theirs is full") {
+  amz::numa_sharded_channel<int> channel{2, {0, 0}};
+  for (int i = 0; i != 4; ++i)
+    REQUIRE(channel.try_push_to(0, i) == amz::channel_op_status::success);
+  REQUIRE(channel.try_push_to(0, 4) == amz::channel_op_status::full);
+
+  int value;
+  REQUIRE(channel.try_pop_from(1, value) == amz::channel_op_status::success);
+  REQUIRE(value == 2);
+}
+
+TEST_CASE("a blocked consumer picks up elements pushed to another shard") {
+  amz::numa_sharded_channel<std::unique_ptr<int>> channel{16, {0, 0}, std::chrono::microseconds{500}};
+  std::thread consumer{[&] {
+    std::unique_ptr<int> value;
+    REQUIRE(channel.pop_from(0, value) == amz::channel_op_status::success);
+    REQUIRE(*value == 3);
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  channel.push_to(1, std::make_unique<int>(3));
+  consumer.join();
+}
+
+TEST_CASE("popping returns closed once every shard is closed and empty") {
+  amz::numa_sharded_channel<int> channel{16, {0, 0}};
+  channel.push_to(1, 1);
+  channel.close();
+  REQUIRE(channel.push(2) == amz::channel_op_status::closed);
+  REQUIRE(channel.try_push(2) == amz::channel_op_status::closed);
+
+  int value;
+  REQUIRE(channel.pop_from(0, value) == amz::channel_op_status::success);
+  REQUIRE(value == 1);
+  REQUIRE(channel.pop_from(0, value) == amz::channel_op_status::closed);
+  REQUIRE(channel.try_pop_from(1, value) == amz::channel_op_status::closed);
+}
+
+TEST_CASE("all the elements are delivered under concurrency") {
+  amz::numa_sharded_channel<int> channel{8, {0, 0, 0, 0}, std::chrono::microseconds{200}};
+  constexpr int per_producer = 5000;
+  std::vector<std::thread> threads;
+  std::vector<long> sums(4, 0);
+  for (std::size_t shard = 0; shard != 4; ++shard) {
+    threads.emplace_back([&, shard] {
+      int value;
+      while (channel.pop_from(shard, value) == amz::channel_op_status::success)
+        sums[shard] += value;
+    });
+  }
+  std::vector<std::thread> producers;
+  for (std::size_t shard = 0; shard != 4; ++shard) {
+    producers.emplace_back([&, shard] {
+      for (int i = 1; i <= per_producer; ++i)
+        REQUIRE(channel.push_to(shard, i) == amz::channel_op_status::success);
+    });
+  }
+  for (auto& t : producers)
+    t.join();
+  channel.close();
+  for (auto& t : threads)
+    t.join();
+
+  long total = 0;
+  for (long sum : sums)
+    total += sum;
+  REQUIRE(total == 4L * per_producer * (per_producer + 1) / 2);
+}
@@ -0,0 +1,158 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/partitioned_channel.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <thread>
+#include <vector>
+
+
+struct identity_hash {
+  std::size_t operator()(std::size_t key) const { return key; }
+};
+
+using Channel = amz::partitioned_channel<int, std::size_t, identity_hash>;
+
+TEST_CASE("a single consumer receives all the elements in FIFO order per key") {
+  Channel channel{64, 4, 1};
+  for (int i = 0; i != 20; ++i)
+    channel.push(static_cast<std::size_t>(i % 3), i);
+  channel.close();
+
+  std::map<std::size_t, std::vector<int>> received;
+  int value;
+  while (channel.pop(0, value) == amz::channel_op_status::success)
+    received[static_cast<std::size_t>(value % 3)].push_back(value);
+
+  for (auto const& kv : received) {
+    for (std::size_t i = 1; i < kv.second.size(); ++i)
+      REQUIRE(kv.second[i - 1] < kv.second[i]);
+  }
+  REQUIRE(received[0].size() + received[1].size() + received[2].size() == 20);
+}
+
+TEST_CASE("try_pop() returns empty, and then closed once the channel is closed and drained") {
+  Channel channel{64, 2, 1};
+  int value;
+  REQUIRE(channel.try_pop(0, value) == amz::channel_op_status::empty);
+  channel.push(1, 42);
+  channel.close();
+  REQUIRE(channel.push(1, 43) == amz::channel_op_status::closed);
+  REQUIRE(channel.try_pop(0, value) == amz::channel_op_status::success);
+  REQUIRE(value == 42);
+  REQUIRE(channel.try_pop(0, value) == amz::channel_op_status::closed);
+}
+
+TEST_CASE("elements of a partition are not handed out while one of them is being processed") {
+  Channel channel{64, 1, 2};
+  channel.push(0, 1);
+  channel.push(0, 2);
+
+  int value;
+  REQUIRE(channel.try_pop(0, value) == amz::channel_op_status::success);
+  REQUIRE(value == 1);
+
+  // Consumer 0 is processing an element of the only partition.
+  REQUIRE(channel.try_pop(1, value) == amz::channel_op_status::empty);
+
+  // Once consumer 0 is done, consumer 1 can take the partition over.
+  channel.release(0);
+  REQUIRE(channel.try_pop(1, value) == amz::channel_op_status::success);
+  REQUIRE(value == 2);
+}
+
+TEST_CASE("idle consumers take over partitions whose owner is busy") {
+  // Partitions 0 and 2 are owned by consumer 0, partition 1 by consumer 1.
+  Channel channel{64, 3, 2};
+  channel.push(0, 1);
+  channel.push(2, 2);
+
+  int value;
+  REQUIRE(channel.try_pop(0, value) == amz::channel_op_status::success);
+  REQUIRE(value == 1);
+  REQUIRE(channel.try_pop(1, value) == amz::channel_op_status::success);
+  REQUIRE(value == 2);
+
+  // Ownership is sticky: partition 2 now belongs to consumer 1.
+  channel.push(2, 3);
+  REQUIRE(channel.try_pop(0, value) == amz::channel_op_status::empty);
+  REQUIRE(channel.try_pop(1, value) == amz::channel_op_status::success);
+  REQUIRE(value == 3);
+}
+
+TEST_CASE("the capacity is shared by all the partitions") {
+  Channel channel{2, 4, 1};
+  channel.push(0, 1);
+  channel.push(1, 2);
+
+  std::atomic<bool> pushed{false};
+  std::thread producer{[&] {
+    channel.push(2, 3);
+    pushed = true;
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  REQUIRE(!pushed);
+
+  int value;
+  REQUIRE(channel.pop(0, value) == amz::channel_op_status::success);
+  producer.join();
+  REQUIRE(pushed);
+}
+
+TEST_CASE("per-key order and exclusivity are preserved with concurrent consumers") {
+  std::size_t const keys = 16;
+  std::size_t const consumers = 4;
+  int const per_key = 2000;
+  Channel channel{32, 8, consumers};
+
+  std::vector<std::atomic<int>> active(keys);
+  std::vector<std::vector<int>> received(keys);
+  std::atomic<bool> overlap{false};
+  std::vector<std::thread> threads;
+  for (std::size_t c = 0; c != consumers; ++c) {
+    threads.emplace_back([&, c] {
+      int value;
+      while (channel.pop(c, value) == amz::channel_op_status::success) {
+        std::size_t const key = static_cast<std::size_t>(value) % keys;
+        // No other consumer may be processing an element with the same key.
+        if (active[key].fetch_add(1) != 0)
+          overlap = true;
+        received[key].push_back(value);
+        active[key].fetch_sub(1);
+      }
+    });
+  }
+
+  std::thread producer{[&] {
+    for (int i = 0; i != per_key * static_cast<int>(keys); ++i)
+      channel.push(static_cast<std::size_t>(i) % keys, i);
+    channel.close();
+  }};
+  producer.join();
+  for (auto& t : threads)
+    t.join();
+
+  REQUIRE(!overlap);
+  for (std::size_t key = 0; key != keys; ++key) {
+    REQUIRE(received[key].size() == static_cast<std::size_t>(per_key));
+    for (std::size_t i = 1; i < received[key].size(); ++i)
+      REQUIRE(received[key][i - 1] < received[key][i]);
+  }
+}
@@ -0,0 +1,182 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/pool_allocator.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+TEST_CASE("a freed block is reused by the next allocation on the same thread") {
+  amz::pool_allocator<std::uint64_t> allocator;
+  std::uint64_t* p = allocator.allocate(1);
+  allocator.deallocate(p, 1);
+  std::uint64_t* q = allocator.allocate(1);
+  REQUIRE(p == q);
+  allocator.deallocate(q, 1);
+}
+
+TEST_CASE("live blocks are distinct and suitably aligned") {
+  struct alignas(16) node { char data[24]; };
+  amz::pool_allocator<node> allocator;
+  std::set<node*> live;
+  for (int i = 0; i != 10000; ++i) {
+    node* p = allocator.allocate(1);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(p) % alignof(node) == 0);
+    REQUIRE(live.insert(p).second);
+  }
+  for (node* p : live)
+    allocator.deallocate(p, 1);
+}
+
+TEST_CASE("array allocations bypass the pool") {
+  amz::pool_allocator<int> allocator;
+  int* p = allocator.allocate(100);
+  for (int i = 0; i != 100; ++i)
+    p[i] = i;
+  allocator.deallocate(p, 100);
+}
+
+TEST_CASE("pool allocators compare equal and can be rebound") {
+  amz::pool_allocator<int> a;
+  amz::pool_allocator<int> b;
+  REQUIRE(a == b);
+  REQUIRE(!(a != b));
+
+  using Traits = std::allocator_traits<amz::pool_allocator<int>>;
+  Traits::rebind_alloc<std::string> strings{a};
+  std::string* s = strings.allocate(1);
+  strings.deallocate(s, 1);
+}
+
+TEST_CASE("node containers work with pool_allocator") {
+  std::list<std::string, amz::pool_allocator<std::string>> list;
+  std::map<int, int, std::less<int>, amz::pool_allocator<std::pair<int const, int>>> map;
+  for (int i = 0; i != 1000; ++i) {
+    list.push_back(std::to_string(i));
+    map[i] = i * 2;
+  }
+  REQUIRE(list.size() == 1000);
+  REQUIRE(list.front() == "0");
+  REQUIRE(list.back() == "999");
+  for (int i = 0; i != 1000; ++i)
+    REQUIRE(map.at(i) == i * 2);
+  list.clear();
+  map.clear();
+}
+
+TEST_CASE("blocks can be freed by a thread other than the one that allocated them") {
+  amz::pool_allocator<std::uint64_t> allocator;
+  std::size_t const n = 100000;
+
+  // Allocate on this thread, and free everything on another thread, twice.
+  // The second round must be able to reuse the blocks returned by the other
+  // thread (through the central pool) without corrupting anything.
+  for (int round = 0; round != 2; ++round) {
+    std::vector<std::uint64_t*> blocks;
+    for (std::size_t i = 0; i != n; ++i) {
+      blocks.push_back(allocator.allocate(1));
+      *blocks.back() = i;
+    }
+    for (std::size_t i = 0; i != n; ++i)
+      REQUIRE(*blocks[i] == i);
+
+    std::thread consumer{[&] {
+      for (std::uint64_t* p : blocks)
+        allocator.deallocate(p, 1);
+    }};
+    consumer.join();
+  }
+}
+
+TEST_CASE("many threads can allocate and deallocate concurrently") {
+  std::size_t const threads = 8;
+  std::size_t const n = 20000;
+  std::vector<std::thread> workers;
+  std::vector<bool> ok(threads, false);
+  for (std::size_t t = 0; t != threads; ++t) {
+    workers.emplace_back([&, t] {
+      amz::pool_allocator<std::uint64_t> allocator;
+      std::vector<std::uint64_t*> blocks;
+      bool good = true;
+      for (int round = 0; round != 4; ++round) {
+        for (std::size_t i = 0; i != n; ++i) {
+          blocks.push_back(allocator.allocate(1));
+          *blocks.back() = t * n + i;
+        }
+        for (std::size_t i = 0; i != n; ++i)
+          good = good && *blocks[i] == t * n + i;
+        for (std::uint64_t* p : blocks)
+          allocator.deallocate(p, 1);
+        blocks.clear();
+      }
+      ok[t] = good;
+    });
+  }
+  for (auto& w : workers)
+    w.join();
+  for (std::size_t t = 0; t != threads; ++t)
+    REQUIRE(ok[t]);
+}
+
+TEST_CASE("array allocations that would overflow throw") {
+  amz::pool_allocator<std::uint64_t> allocator;
+  REQUIRE_THROWS_AS(allocator.allocate(std::size_t(-1) / 4), std::bad_array_new_length);
+}
+
+namespace {
+  // Used only in the test below, so that it is the only user of its pool.
+  struct late_block { char bytes[200]; };
+
+  // Deallocates its block when the thread exits. Since it is constructed
+  // before the thread cache of the pool, it is destroyed after it.
+  struct late_deallocator {
+    late_block* block = nullptr;
+    ~late_deallocator() {
+      if (block != nullptr)
+        amz::pool_allocator<late_block>{}.deallocate(block, 1);
+    }
+  };
+}
+
+TEST_CASE("blocks deallocated after the thread cache is destroyed go to the central pool") {
+  late_block* freed = nullptr;
+  std::thread thread{[&] {
+    static thread_local late_deallocator deallocator;
+    deallocator.block = amz::pool_allocator<late_block>{}.allocate(1);
+    freed = deallocator.block;
+  }};
+  thread.join();
+
+  // The block was handed back to the central pool as a batch of its own,
+  // after the rest of the thread's cache, so it is the next one handed out
+  // to a thread that has not used the pool yet.
+  late_block* reused = nullptr;
+  std::thread other{[&] {
+    amz::pool_allocator<late_block> allocator;
+    reused = allocator.allocate(1);
+    allocator.deallocate(reused, 1);
+  }};
+  other.join();
+  REQUIRE(reused == freed);
+}
@@ -0,0 +1,125 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/deferred_reclamation_allocator.hpp>
+#include <amz/purge_timer.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include <poll.h>
+
+
+struct OnDestruction {
+  OnDestruction(std::function<void()> f) : callback(f) { }
+  ~OnDestruction() { callback(); }
+  std::function<void()> callback;
+};
+
+using ValueType = OnDestruction;
+using UnderlyingAllocator = std::allocator<ValueType>;
+using Allocator = amz::deferred_reclamation_allocator<UnderlyingAllocator>;
+
+static void deallocate_one(Allocator& allocator, std::function<void()> on_destruction) {
+  ValueType* p = allocator.allocate(1);
+  allocator.construct(p, on_destruction);
+  allocator.destroy(p);
+  allocator.deallocate(p, 1);
+}
+
+// Waits for the timer to fire, for up to a second.
+static bool wait_for(amz::purge_timer<Allocator> const& timer) {
+  ::pollfd fd{timer.fd(), POLLIN, 0};
+  return ::poll(&fd, 1, 1000) == 1;
+}
+
+TEST_CASE("the timer is disarmed when there is nothing to reclaim") {
+  Allocator allocator{UnderlyingAllocator{}, std::chrono::milliseconds{5}, 10};
+  amz::purge_timer<Allocator> timer{allocator, std::chrono::milliseconds{5}};
+  REQUIRE(timer.fd() >= 0);
+  timer.arm();
+  REQUIRE(!timer.deadline());
+}
+
+TEST_CASE("the timer reclaims a partially filled delay buffer") {
+  auto const timeout = std::chrono::milliseconds{5};
+  Allocator allocator{UnderlyingAllocator{}, timeout, 10};
+  amz::purge_timer<Allocator> timer{allocator, std::chrono::milliseconds{5}};
+
+  int destroyed = 0;
+  deallocate_one(allocator, [&] { ++destroyed; });
+  deallocate_one(allocator, [&] { ++destroyed; });
+  timer.arm();
+  REQUIRE(timer.deadline().has_value());
+
+  // First, the delay buffer is flushed.
+  REQUIRE(wait_for(timer));
+  timer.handle();
+  REQUIRE(destroyed == 0);
+  REQUIRE(!allocator.has_unflushed_elements());
+  REQUIRE((timer.deadline() == allocator.next_purge_deadline()));
+
+  // Then, its elements are reclaimed once their timeout has elapsed.
+  REQUIRE(wait_for(timer));
+  timer.handle();
+  REQUIRE(destroyed == 2);
+  REQUIRE(!timer.deadline());
+}
+
+TEST_CASE("the timer fires when full buffers can be purged") {
+  auto const timeout = std::chrono::milliseconds{5};
+  Allocator allocator{UnderlyingAllocator{}, timeout, 1};
+  amz::purge_timer<Allocator> timer{allocator, std::chrono::seconds{10}};
+
+  int destroyed = 0;
+  deallocate_one(allocator, [&] { ++destroyed; });
+  timer.arm();
+  REQUIRE((timer.deadline() == allocator.next_purge_deadline()));
+
+  REQUIRE(wait_for(timer));
+  timer.handle();
+  REQUIRE(destroyed == 1);
+  REQUIRE(!timer.deadline());
+}
+
+TEST_CASE("arming moves the deadline earlier, but never later") {
+  Allocator allocator{UnderlyingAllocator{}, std::chrono::milliseconds{50}, 1};
+  amz::purge_timer<Allocator> timer{allocator, std::chrono::milliseconds{5}};
+
+  int destroyed = 0;
+  deallocate_one(allocator, [&] { ++destroyed; });
+  timer.arm();
+  auto const first = timer.deadline();
+  REQUIRE(first.has_value());
+
+  deallocate_one(allocator, [&] { ++destroyed; });
+  timer.arm();
+  REQUIRE((timer.deadline() == first));
+}
+
+TEST_CASE("handling the timer before it fires is harmless") {
+  Allocator allocator{UnderlyingAllocator{}, std::chrono::milliseconds{5}, 1};
+  amz::purge_timer<Allocator> timer{allocator, std::chrono::milliseconds{5}};
+  int destroyed = 0;
+  deallocate_one(allocator, [&] { ++destroyed; });
+  timer.handle();
+  REQUIRE(destroyed == 0);
+  REQUIRE(timer.deadline().has_value());
+  REQUIRE(wait_for(timer));
+  timer.handle();
+  REQUIRE(destroyed == 1);
+}
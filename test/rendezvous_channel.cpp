@@ -0,0 +1,172 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/bounded_channel.hpp>
+#include <amz/rendezvous_channel.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+TEST_CASE("non-blocking operations fail without a counterpart") {
+  amz::rendezvous_channel<int> channel;
+  int value = 0;
+  REQUIRE(channel.try_push(1) == amz::channel_op_status::full);
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::empty);
+
+  channel.close();
+  REQUIRE(channel.try_push(1) == amz::channel_op_status::closed);
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::closed);
+  REQUIRE(channel.push(1) == amz::channel_op_status::closed);
+  REQUIRE(channel.pop(value) == amz::channel_op_status::closed);
+}
+
+TEST_CASE("push blocks until a consumer takes the value") {
+  amz::rendezvous_channel<std::string> channel;
+  std::atomic<bool> pushed{false};
+  std::thread producer{[&] {
+    REQUIRE(channel.push("hello") == amz::channel_op_status::success);
+    pushed = true;
+  }};
+
+  std::this_thread::sleep_for(std::chrono::milliseconds{50});
+  REQUIRE(!pushed);
+
+  std::string value;
+  while (channel.try_pop(value) != amz::channel_op_status::success)
+    std::this_thread::yield();
+  REQUIRE(value == "hello");
+  producer.join();
+  REQUIRE(pushed);
+}
+
+TEST_CASE("pop blocks until a producer hands a value") {
+  amz::rendezvous_channel<std::unique_ptr<int>> channel;
+  std::thread consumer{[&] {
+    std::unique_ptr<int> value;
+    REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+    REQUIRE(*value == 42);
+  }};
+
+  auto value = std::make_unique<int>(42);
+  while (channel.try_push(std::move(value)) != amz::channel_op_status::success) {
+    REQUIRE(value != nullptr); // not moved from when the push fails
+    std::this_thread::yield();
+  }
+  consumer.join();
+}
+
+TEST_CASE("a const value is copied when the producer has to wait") {
+  amz::rendezvous_channel<std::string> channel;
+  std::string const original = "value";
+  std::thread producer{[&] {
+    REQUIRE(channel.push(original) == amz::channel_op_status::success);
+  }};
+  std::string value;
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+  producer.join();
+  REQUIRE(value == "value");
+  REQUIRE(original == "value");
+}
+
+TEST_CASE("closing the channel wakes up waiting threads") {
+  amz::rendezvous_channel<std::unique_ptr<int>> channel;
+  auto value = std::make_unique<int>(1);
+  std::thread producer{[&] {
+    REQUIRE(channel.push(std::move(value)) == amz::channel_op_status::closed);
+  }};
+  std::thread consumer{[&] {
+    amz::rendezvous_channel<std::unique_ptr<int>> other;
+    std::thread closer{[&] {
+      std::this_thread::sleep_for(std::chrono::milliseconds{20});
+      other.close();
+    }};
+    std::unique_ptr<int> v;
+    REQUIRE(other.pop(v) == amz::channel_op_status::closed);
+    closer.join();
+  }};
+
+  std::this_thread::sleep_for(std::chrono::milliseconds{20});
+  channel.close();
+  producer.join();
+  consumer.join();
+  // The value offered by the producer was not transferred.
+  REQUIRE(value != nullptr);
+  REQUIRE(*value == 1);
+}
+
+TEST_CASE("popping after close() does not take the value of a waiting producer") {
+  for (int i = 0; i != 20; ++i) {
+    amz::rendezvous_channel<std::unique_ptr<int>> channel;
+    auto value = std::make_unique<int>(1);
+    amz::channel_op_status pushed = amz::channel_op_status::success;
+    std::thread producer{[&] { pushed = channel.push(std::move(value)); }};
+
+    std::this_thread::sleep_for(std::chrono::milliseconds{2});
+    channel.close();
+    std::unique_ptr<int> v;
+    REQUIRE(channel.try_pop(v) == amz::channel_op_status::closed);
+    REQUIRE(channel.pop(v) == amz::channel_op_status::closed);
+    producer.join();
+
+    REQUIRE(pushed == amz::channel_op_status::closed);
+    REQUIRE(v == nullptr);
+    REQUIRE(value != nullptr);
+  }
+}
+
+TEST_CASE("every value is handed to exactly one consumer") {
+  amz::rendezvous_channel<int> channel;
+  constexpr int producers = 4;
+  constexpr int consumers = 4;
+  constexpr int per_producer = 2000;
+
+  std::vector<std::thread> threads;
+  std::vector<std::vector<int>> received(consumers);
+  for (int c = 0; c != consumers; ++c) {
+    threads.emplace_back([&, c] {
+      int value;
+      while (channel.pop(value) == amz::channel_op_status::success)
+        received[c].push_back(value);
+    });
+  }
+  std::vector<std::thread> producer_threads;
+  for (int p = 0; p != producers; ++p) {
+    producer_threads.emplace_back([&, p] {
+      for (int i = 0; i != per_producer; ++i)
+        REQUIRE(channel.push(p * per_producer + i) == amz::channel_op_status::success);
+    });
+  }
+  for (auto& t : producer_threads)
+    t.join();
+  channel.close();
+  for (auto& t : threads)
+    t.join();
+
+  std::vector<bool> seen(producers * per_producer, false);
+  for (auto const& values : received) {
+    for (int v : values) {
+      REQUIRE(!seen[v]);
+      seen[v] = true;
+    }
+  }
+  for (bool s : seen)
+    REQUIRE(s);
+}
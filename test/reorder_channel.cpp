@@ -0,0 +1,126 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/bounded_channel.hpp>
+#include <amz/reorder_channel.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+TEST_CASE("elements are popped in sequence order") {
+  amz::reorder_channel<std::string> channel{8};
+  channel.push(2, "c");
+  channel.push(0, "a");
+  channel.push(3, "d");
+
+  std::string value;
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == "a");
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::empty);
+  REQUIRE(channel.next_sequence() == 1);
+
+  channel.push(1, "b");
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == "b");
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == "c");
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == "d");
+}
+
+TEST_CASE("the first sequence number can be customized") {
+  amz::reorder_channel<int> channel{4, 100};
+  channel.push(101, 2);
+  channel.push(100, 1);
+  int value;
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 1);
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 2);
+}
+
+TEST_CASE("producers running too far ahead block until the ring has room") {
+  amz::reorder_channel<int> channel{2};
+  channel.push(1, 1);
+
+  std::atomic<bool> pushed{false};
+  std::thread producer{[&] {
+    REQUIRE(channel.push(2, 2) == amz::channel_op_status::success);
+    pushed = true;
+  }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  REQUIRE(!pushed);
+
+  channel.push(0, 0);
+  int value;
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 0);
+  producer.join();
+  REQUIRE(pushed);
+}
+
+TEST_CASE("pop() returns closed when the next element is missing and the channel is closed") {
+  amz::reorder_channel<int> channel{4};
+  channel.push(0, 0);
+  channel.push(2, 2);
+  channel.close();
+  REQUIRE(channel.push(1, 1) == amz::channel_op_status::closed);
+
+  int value;
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 0);
+  REQUIRE(channel.pop(value) == amz::channel_op_status::closed);
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::closed);
+}
+
+TEST_CASE("order is restored after processing elements in parallel") {
+  using Item = std::pair<std::uint64_t, int>;
+  int const n = 20000;
+  std::size_t const workers = 4;
+  amz::bounded_channel<Item> input{16};
+  amz::reorder_channel<int> output{64};
+
+  std::vector<std::thread> threads;
+  for (std::size_t w = 0; w != workers; ++w) {
+    threads.emplace_back([&] {
+      Item item;
+      while (input.pop(item) == amz::channel_op_status::success)
+        output.push(item.first, item.second * 2);
+    });
+  }
+  std::thread producer{[&] {
+    for (int i = 0; i != n; ++i)
+      input.push(Item{static_cast<std::uint64_t>(i), i});
+    input.close();
+  }};
+
+  bool in_order = true;
+  for (int i = 0; i != n; ++i) {
+    int value;
+    REQUIRE(output.pop(value) == amz::channel_op_status::success);
+    in_order = in_order && value == i * 2;
+  }
+  producer.join();
+  for (auto& t : threads)
+    t.join();
+  REQUIRE(in_order);
+}
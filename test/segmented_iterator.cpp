@@ -0,0 +1,235 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/segmented_iterator.hpp>
+#include <amz/algorithm/copy_while.hpp>
+#include <amz/algorithm/remove_and_copy_if.hpp>
+#include <amz/algorithm/remove_range_if.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+
+// A minimal segmented sequence made of non-empty chunks, used to make sure the
+// algorithms pick up user-provided specializations of the traits. Increments
+// of the flat iterator are counted, so we can check that the algorithms use
+// the local iterators instead.
+struct chunked_sequence {
+  explicit chunked_sequence(std::vector<std::vector<int>> chunks)
+    : chunks_(std::move(chunks))
+  { }
+
+  struct segment_iterator {
+    std::vector<int>* chunk;
+    std::vector<int>* last_chunk;
+
+    segment_iterator& operator++() { ++chunk; return *this; }
+    friend bool operator==(segment_iterator a, segment_iterator b) { return a.chunk == b.chunk; }
+    friend bool operator!=(segment_iterator a, segment_iterator b) { return !(a == b); }
+  };
+
+  struct iterator {
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = int;
+    using difference_type = std::ptrdiff_t;
+    using pointer = int*;
+    using reference = int&;
+
+    segment_iterator segment;
+    int* current;
+
+    static int increments;
+
+    iterator& operator++() {
+      ++increments;
+      if (++current == segment.chunk->data() + segment.chunk->size() &&
+          segment.chunk != segment.last_chunk) {
+        ++segment;
+        current = segment.chunk->data();
+      }
+      return *this;
+    }
+    iterator operator++(int) { iterator copy = *this; ++*this; return copy; }
+    int& operator*() const { return *current; }
+    friend bool operator==(iterator a, iterator b) { return a.current == b.current; }
+    friend bool operator!=(iterator a, iterator b) { return !(a == b); }
+  };
+
+  iterator begin() {
+    return iterator{segment_iterator{&chunks_.front(), &chunks_.back()}, chunks_.front().data()};
+  }
+  iterator end() {
+    auto& last = chunks_.back();
+    return iterator{segment_iterator{&last, &last}, last.data() + last.size()};
+  }
+
+  std::vector<int> flatten() const {
+    std::vector<int> result;
+    for (auto const& chunk : chunks_)
+      result.insert(result.end(), chunk.begin(), chunk.end());
+    return result;
+  }
+
+private:
+  std::vector<std::vector<int>> chunks_;
+};
+
+int chunked_sequence::iterator::increments = 0;
+
+namespace amz {
+  template <>
+  struct segmented_iterator_traits<chunked_sequence::iterator> {
+    using is_segmented_iterator = std::true_type;
+    using segment_iterator = chunked_sequence::segment_iterator;
+    using local_iterator = int*;
+
+    static segment_iterator segment(chunked_sequence::iterator it) { return it.segment; }
+    static local_iterator local(chunked_sequence::iterator it) { return it.current; }
+    static local_iterator begin(segment_iterator s) { return s.chunk->data(); }
+    static local_iterator end(segment_iterator s) { return s.chunk->data() + s.chunk->size(); }
+    static chunked_sequence::iterator compose(segment_iterator s, local_iterator l) {
+      return chunked_sequence::iterator{s, l};
+    }
+  };
+}
+
+static_assert(!amz::detail::is_segmented_iterator_t<std::vector<int>::iterator>::value, "");
+static_assert(!amz::detail::is_segmented_iterator_t<int*>::value, "");
+#if defined(__GLIBCXX__)
+static_assert(amz::detail::is_segmented_iterator_t<std::deque<int>::iterator>::value, "");
+static_assert(amz::detail::is_segmented_iterator_t<std::deque<int>::const_iterator>::value, "");
+#endif
+
+// Builds a deque spanning many segments, whose first element is not at the
+// beginning of a segment.
+static std::deque<int> make_deque(int n) {
+  std::deque<int> d;
+  for (int i = n / 3; i != n; ++i)
+    d.push_back(i);
+  for (int i = n / 3; i != 0; --i)
+    d.push_front(i - 1);
+  return d;
+}
+
+TEST_CASE("copy_while over deque matches vector") {
+  std::deque<int> const d = make_deque(5000);
+  std::vector<int> const v(d.begin(), d.end());
+
+  for (int bound : {0, 1, 127, 128, 129, 511, 512, 2500, 4999, 5000, 6000}) {
+    auto pred = [=](int x) { return x < bound; };
+    std::vector<int> from_deque, from_vector;
+    auto rd = amz::copy_while(d.begin(), d.end(), std::back_inserter(from_deque), pred);
+    auto rv = amz::copy_while(v.begin(), v.end(), std::back_inserter(from_vector), pred);
+
+    CHECK(from_deque == from_vector);
+    CHECK(std::distance(d.begin(), rd.first) == std::distance(v.begin(), rv.first));
+  }
+}
+
+TEST_CASE("copy_while over a sub-range of a deque") {
+  std::deque<int> const d = make_deque(3000);
+  std::vector<int> const v(d.begin(), d.end());
+
+  for (int offset : {0, 1, 100, 1000}) {
+    for (int length : {0, 1, 200, 1500}) {
+      std::vector<int> from_deque, from_vector;
+      auto pred = [](int x) { return x % 997 != 996; };
+      auto rd = amz::copy_while(d.begin() + offset, d.begin() + offset + length,
+                                std::back_inserter(from_deque), pred);
+      auto rv = amz::copy_while(v.begin() + offset, v.begin() + offset + length,
+                                std::back_inserter(from_vector), pred);
+
+      CHECK(from_deque == from_vector);
+      CHECK(std::distance(d.begin(), rd.first) == std::distance(v.begin(), rv.first));
+    }
+  }
+}
+
+TEST_CASE("remove_and_copy_if over deque matches vector") {
+  for (int modulo : {1, 2, 3, 7, 200, 10000}) {
+    std::deque<int> d = make_deque(5000);
+    std::vector<int> v(d.begin(), d.end());
+
+    auto pred = [=](int x) { return x % modulo == 0; };
+    std::vector<int> removed_deque, removed_vector;
+    auto rd = amz::remove_and_copy_if(d.begin(), d.end(), std::back_inserter(removed_deque), pred);
+    auto rv = amz::remove_and_copy_if(v.begin(), v.end(), std::back_inserter(removed_vector), pred);
+    d.erase(rd.first, d.end());
+    v.erase(rv.first, v.end());
+
+    CHECK(removed_deque == removed_vector);
+    CHECK(std::vector<int>(d.begin(), d.end()) == v);
+  }
+}
+
+TEST_CASE("remove_range_if over deque matches vector") {
+  for (int group : {1, 3, 128, 300}) {
+    std::deque<int> d = make_deque(5000);
+    std::vector<int> v(d.begin(), d.end());
+
+    auto same_group = [=](int a, int b) { return a / group == b / group; };
+    auto odd_group = [=](auto first, auto) { return (*first / group) % 2 == 1; };
+    d.erase(amz::remove_range_if(d.begin(), d.end(), same_group, odd_group), d.end());
+    v.erase(amz::remove_range_if(v.begin(), v.end(), same_group, odd_group), v.end());
+
+    CHECK(std::vector<int>(d.begin(), d.end()) == v);
+  }
+}
+
+TEST_CASE("algorithms use user-provided segmented iterator traits") {
+  chunked_sequence seq{{{0, 1, 2}, {3}, {4, 5, 6, 7}, {8, 9}}};
+  std::vector<int> const expected = seq.flatten();
+
+  SECTION("copy_while") {
+    for (int bound = 0; bound <= 10; ++bound) {
+      chunked_sequence::iterator::increments = 0;
+      std::vector<int> out;
+      auto r = amz::copy_while(seq.begin(), seq.end(), std::back_inserter(out),
+                               [=](int x) { return x < bound; });
+      CHECK(out == std::vector<int>(expected.begin(), expected.begin() + bound));
+      CHECK((r.first == seq.end()) == (bound == 10));
+      if (bound < 10)
+        CHECK(*r.first == bound);
+      CHECK(chunked_sequence::iterator::increments == 0);
+    }
+  }
+
+  SECTION("remove_and_copy_if") {
+    std::vector<int> removed;
+    auto r = amz::remove_and_copy_if(seq.begin(), seq.end(), std::back_inserter(removed),
+                                     [](int x) { return x % 3 == 0; });
+    CHECK(removed == (std::vector<int>{0, 3, 6, 9}));
+
+    std::vector<int> kept;
+    for (auto it = seq.begin(); it != r.first; ++it)
+      kept.push_back(*it);
+    CHECK(kept == (std::vector<int>{1, 2, 4, 5, 7, 8}));
+  }
+
+  SECTION("remove_range_if") {
+    auto it = amz::remove_range_if(seq.begin(), seq.end(),
+      [](int a, int b) { return a / 4 == b / 4; },
+      [](auto first, auto) { return *first / 4 == 1; });
+
+    std::vector<int> kept;
+    for (auto i = seq.begin(); i != it; ++i)
+      kept.push_back(*i);
+    CHECK(kept == (std::vector<int>{0, 1, 2, 3, 8, 9}));
+  }
+}
@@ -0,0 +1,179 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/spilling_channel.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+namespace fs = boost::filesystem;
+
+
+struct spool_directory {
+  spool_directory()
+    : path{fs::temp_directory_path() / fs::unique_path("amz-spill-%%%%-%%%%")}
+  { fs::create_directory(path); }
+
+  ~spool_directory() { fs::remove_all(path); }
+
+  bool empty() const { return fs::directory_iterator{path} == fs::directory_iterator{}; }
+
+  fs::path path;
+};
+
+struct message {
+  int producer;
+  int sequence;
+};
+
+struct string_spill_traits {
+  static std::size_t size(std::string const& s) { return s.size(); }
+  static void serialize(std::string const& s, char* out) { std::memcpy(out, s.data(), s.size()); }
+  static std::string deserialize(char const* in, std::size_t size) { return std::string(in, size); }
+};
+
+TEST_CASE("elements stay in memory while the channel is not full") {
+  spool_directory spool;
+  amz::spilling_channel<int> channel{4, spool.path.string()};
+  for (int i = 0; i != 4; ++i)
+    REQUIRE(channel.push(i) == amz::channel_op_status::success);
+  REQUIRE(channel.spilled() == 0);
+}
+
+TEST_CASE("elements are spilled when the channel is full and popped in FIFO order") {
+  spool_directory spool;
+  amz::spilling_channel<int> channel{4, spool.path.string()};
+  for (int i = 0; i != 100; ++i)
+    REQUIRE(channel.try_push(i) == amz::channel_op_status::success);
+  REQUIRE(channel.spilled() == 96);
+
+  // Pushes keep going to the spool until it has been consumed, even if
+  // there is room in memory.
+  int value;
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 0);
+  REQUIRE(channel.push(100) == amz::channel_op_status::success);
+  REQUIRE(channel.spilled() == 97);
+
+  for (int i = 1; i != 101; ++i) {
+    REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+    REQUIRE(value == i);
+  }
+  REQUIRE(channel.spilled() == 0);
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::empty);
+}
+
+TEST_CASE("segments are rotated and released as they are consumed") {
+  spool_directory spool;
+  std::size_t const segment_size = 4096;
+  amz::spilling_channel<std::size_t> channel{1, spool.path.string(), segment_size};
+  std::size_t const n = 10 * segment_size / sizeof(std::size_t);
+  for (std::size_t i = 0; i != n; ++i)
+    REQUIRE(channel.push(i) == amz::channel_op_status::success);
+
+  std::size_t value;
+  for (std::size_t i = 0; i != n; ++i) {
+    REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+    REQUIRE(value == i);
+  }
+  REQUIRE(spool.empty());
+}
+
+TEST_CASE("producers block when the spool is full") {
+  spool_directory spool;
+  std::size_t const segment_size = 4096;
+  amz::spilling_channel<std::size_t> channel{1, spool.path.string(), segment_size, segment_size};
+  std::size_t pushed = 0;
+  while (channel.try_push(pushed) == amz::channel_op_status::success)
+    ++pushed;
+  REQUIRE(pushed > 1);
+  REQUIRE(channel.try_push(pushed) == amz::channel_op_status::full);
+
+  std::thread producer{[&] {
+    REQUIRE(channel.push(pushed) == amz::channel_op_status::success);
+  }};
+
+  std::size_t value;
+  for (std::size_t i = 0; i != pushed + 1; ++i) {
+    REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+    REQUIRE(value == i);
+  }
+  producer.join();
+}
+
+TEST_CASE("non trivially copyable elements can be spilled with custom traits") {
+  spool_directory spool;
+  amz::spilling_channel<std::string, string_spill_traits> channel{2, spool.path.string()};
+  std::vector<std::string> const input = {"", "a", "hello", std::string(10000, 'x'), "world"};
+  for (auto const& s : input)
+    REQUIRE(channel.push(s) == amz::channel_op_status::success);
+  REQUIRE(channel.spilled() == 3);
+  channel.close();
+
+  std::vector<std::string> output;
+  std::string value;
+  while (channel.pop(value) == amz::channel_op_status::success)
+    output.push_back(value);
+  REQUIRE(output == input);
+}
+
+TEST_CASE("a closed channel can be drained, including its spool") {
+  spool_directory spool;
+  amz::spilling_channel<int> channel{1, spool.path.string()};
+  channel.push(1);
+  channel.push(2);
+  channel.close();
+  REQUIRE(channel.push(3) == amz::channel_op_status::closed);
+
+  int value;
+  REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 1);
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::success);
+  REQUIRE(value == 2);
+  REQUIRE(channel.pop(value) == amz::channel_op_status::closed);
+  REQUIRE(channel.try_pop(value) == amz::channel_op_status::closed);
+}
+
+TEST_CASE("the order of each producer is preserved with concurrent producers and consumers") {
+  spool_directory spool;
+  amz::spilling_channel<message> channel{8, spool.path.string(), 4096};
+  int const producers = 4;
+  int const n = 20000;
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p != producers; ++p) {
+    threads.emplace_back([&, p] {
+      for (int i = 0; i != n; ++i)
+        channel.push(message{p, i});
+    });
+  }
+
+  std::vector<int> next(producers, 0);
+  bool in_order = true;
+  for (int i = 0; i != producers * n; ++i) {
+    message value;
+    REQUIRE(channel.pop(value) == amz::channel_op_status::success);
+    in_order = in_order && value.sequence == next[value.producer];
+    ++next[value.producer];
+  }
+  for (auto& t : threads)
+    t.join();
+  REQUIRE(in_order);
+}
@@ -0,0 +1,156 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/spin_guarded.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+
+namespace {
+  struct order {
+    order() = default;
+    order(std::string id, int quantity) : id{std::move(id)}, quantity{quantity} { }
+    std::string id;
+    int quantity = 0;
+  };
+
+  // Not POD, so its tail padding could be reused, but trivially copyable.
+  class trivial {
+  public:
+    trivial(int a = 0, char b = 0) : a_{a}, b_{b} { }
+    int a() const { return a_; }
+    char b() const { return b_; }
+  private:
+    int a_;
+    char b_;
+  };
+
+  template <typename T>
+  using packed = amz::spin_guarded<T, amz::small_spin_mutex, amz::spin_guarded_layout::packed>;
+}
+
+static_assert(alignof(amz::spin_guarded<int>) == 64,
+  "the default layout is aligned on a cache line");
+static_assert(sizeof(packed<order>) == sizeof(order),
+  "the packed layout places the lock in the tail padding of the data");
+static_assert(sizeof(packed<int>) <= 2 * sizeof(int),
+  "the packed layout is not over-aligned");
+static_assert(!std::is_copy_constructible<amz::spin_guarded<int>>::value, "");
+static_assert(!std::is_copy_constructible<amz::spin_guarded<int>::locked_ptr>::value, "");
+static_assert(std::is_move_constructible<amz::spin_guarded<int>::locked_ptr>::value, "");
+
+TEST_CASE("with_lock() gives access to the data and returns the result") {
+  amz::spin_guarded<std::vector<int>> guarded{3, 1};
+  guarded.with_lock([](std::vector<int>& v) { v.push_back(2); });
+  std::size_t const size = guarded.with_lock([](std::vector<int> const& v) { return v.size(); });
+  REQUIRE(size == 4);
+
+  amz::spin_guarded<std::vector<int>> const& cref = guarded;
+  int const last = cref.with_lock([](std::vector<int> const& v) { return v.back(); });
+  REQUIRE(last == 2);
+}
+
+TEST_CASE("with_lock() can return a reference") {
+  packed<order> guarded{"abc", 3};
+  int& quantity = guarded.with_lock([](order& o) -> int& { return o.quantity; });
+  REQUIRE(&quantity == &guarded.lock()->quantity);
+}
+
+TEST_CASE("with_lock() releases the lock when the function throws") {
+  amz::spin_guarded<int> guarded{0};
+  REQUIRE_THROWS_AS(guarded.with_lock([](int&) { throw std::runtime_error{"boom"}; }), std::runtime_error);
+  REQUIRE(guarded.try_lock());
+}
+
+TEST_CASE("a locked handle holds the lock until it is destroyed") {
+  packed<order> guarded{"abc", 3};
+  {
+    auto locked = guarded.lock();
+    REQUIRE(locked);
+    REQUIRE(locked->id == "abc");
+    (*locked).quantity = 4;
+    REQUIRE(!guarded.try_lock());
+
+    auto moved = std::move(locked);
+    REQUIRE(!locked);
+    REQUIRE(moved->quantity == 4);
+    REQUIRE(!guarded.try_lock());
+  }
+  auto locked = guarded.try_lock();
+  REQUIRE(locked);
+  REQUIRE(locked->quantity == 4);
+  locked.unlock();
+  REQUIRE(!locked);
+  REQUIRE(guarded.try_lock());
+}
+
+TEST_CASE("const access takes the lock too") {
+  amz::spin_guarded<std::string> const guarded{"hello"};
+  auto locked = guarded.lock();
+  static_assert(std::is_same<decltype(*locked), std::string const&>::value, "");
+  REQUIRE(*locked == "hello");
+  REQUIRE(!guarded.try_lock());
+}
+
+TEST_CASE("copying trivially copyable data does not overwrite the lock") {
+  static_assert(sizeof(packed<trivial>) > sizeof(trivial),
+    "the lock must not be in the tail padding of a trivially copyable type");
+  packed<trivial> guarded{1, 'a'};
+  trivial const source{2, 'b'};
+  guarded.with_lock([&](trivial& t) {
+    // std::copy may use memmove, which copies all of sizeof(trivial)
+    std::copy(&source, &source + 1, &t);
+    REQUIRE(!guarded.try_lock());
+  });
+  auto locked = guarded.lock();
+  REQUIRE(locked->a() == 2);
+  REQUIRE(locked->b() == 'b');
+}
+
+TEST_CASE("works with other mutex types") {
+  amz::spin_guarded<int, std::mutex> guarded{1};
+  REQUIRE(guarded.with_lock([](int& i) { return ++i; }) == 2);
+}
+
+TEST_CASE("concurrent increments are not lost") {
+  constexpr int threads = 4;
+  constexpr int increments = 100000;
+  amz::spin_guarded<long> aligned{0};
+  packed<order> compact{};
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t != threads; ++t) {
+    workers.emplace_back([&] {
+      for (int i = 0; i != increments; ++i) {
+        aligned.with_lock([](long& n) { ++n; });
+        compact.lock()->quantity++;
+      }
+    });
+  }
+  for (auto& w : workers)
+    w.join();
+
+  REQUIRE(*aligned.lock() == threads * increments);
+  REQUIRE(compact.lock()->quantity == threads * increments);
+}
@@ -0,0 +1,212 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/timer_wheel.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+
+struct timer : amz::timer_wheel_hook {
+  explicit timer(int id = 0) : id{id} { }
+  int id;
+};
+
+using clock_type = std::chrono::steady_clock;
+using wheel_type = amz::timer_wheel<timer>;
+using std::chrono::milliseconds;
+
+static clock_type::time_point const origin{};
+
+template <typename Wheel>
+static std::vector<int> advance(Wheel& wheel, clock_type::time_point now) {
+  std::vector<int> fired;
+  std::size_t const n = wheel.advance(now, [&](timer& t) {
+    REQUIRE(!t.is_scheduled());
+    fired.push_back(t.id);
+  });
+  REQUIRE(n == fired.size());
+  return fired;
+}
+
+TEST_CASE("timers fire once their deadline is reached, never before") {
+  wheel_type wheel{milliseconds{1}, origin};
+  timer a{1}, b{2}, c{3};
+  wheel.schedule(a, origin + milliseconds{10});
+  wheel.schedule(b, origin + milliseconds{5});
+  wheel.schedule(c, origin + milliseconds{300});
+  REQUIRE(a.is_scheduled());
+
+  REQUIRE(advance(wheel, origin + milliseconds{4}).empty());
+  REQUIRE(advance(wheel, origin + milliseconds{5}) == std::vector<int>{2});
+  REQUIRE(advance(wheel, origin + milliseconds{9}).empty());
+  REQUIRE(advance(wheel, origin + milliseconds{299}) == std::vector<int>{1});
+  REQUIRE(advance(wheel, origin + milliseconds{300}) == std::vector<int>{3});
+  REQUIRE(!a.is_scheduled());
+  REQUIRE(!c.is_scheduled());
+}
+
+TEST_CASE("deadlines are rounded up to the next tick") {
+  wheel_type wheel{milliseconds{10}, origin};
+  timer a{1};
+  wheel.schedule(a, origin + milliseconds{11});
+  REQUIRE(advance(wheel, origin + milliseconds{19}).empty());
+  REQUIRE(advance(wheel, origin + milliseconds{20}) == std::vector<int>{1});
+}
+
+TEST_CASE("timers are fired in order of deadline within a batch") {
+  wheel_type wheel{milliseconds{1}, origin};
+  std::vector<std::unique_ptr<timer>> timers;
+  std::vector<int> delays{700, 3, 70000, 256, 255, 65536, 1, 1000};
+  for (std::size_t i = 0; i != delays.size(); ++i) {
+    timers.push_back(std::make_unique<timer>(delays[i]));
+    wheel.schedule(*timers.back(), origin + milliseconds{delays[i]});
+  }
+
+  std::sort(delays.begin(), delays.end());
+  REQUIRE(advance(wheel, origin + milliseconds{100000}) == delays);
+}
+
+TEST_CASE("timers scheduled in the past fire on the next advance") {
+  wheel_type wheel{milliseconds{1}, origin};
+  REQUIRE(advance(wheel, origin + milliseconds{50}).empty());
+  REQUIRE(wheel.now() == origin + milliseconds{50});
+
+  timer a{1};
+  wheel.schedule(a, origin + milliseconds{10});
+  REQUIRE(static_cast<bool>(wheel.next_expiry()));
+  REQUIRE(*wheel.next_expiry() == wheel.now());
+  REQUIRE(advance(wheel, origin + milliseconds{50}) == std::vector<int>{1});
+}
+
+TEST_CASE("cancelled timers do not fire") {
+  wheel_type wheel{milliseconds{1}, origin};
+  timer a{1}, b{2};
+  wheel.schedule(a, origin + milliseconds{10});
+  wheel.schedule(b, origin + milliseconds{100000});
+  a.cancel();
+  b.cancel();
+  REQUIRE(!a.is_scheduled());
+  a.cancel(); // cancelling twice is fine
+  REQUIRE(advance(wheel, origin + milliseconds{200000}).empty());
+}
+
+TEST_CASE("destroying a scheduled timer cancels it") {
+  wheel_type wheel{milliseconds{1}, origin};
+  {
+    timer a{1};
+    wheel.schedule(a, origin + milliseconds{10});
+  }
+  REQUIRE(advance(wheel, origin + milliseconds{20}).empty());
+}
+
+TEST_CASE("callbacks can reschedule timers and cancel others of the batch") {
+  wheel_type wheel{milliseconds{1}, origin};
+  timer a{1}, b{2};
+  wheel.schedule(a, origin + milliseconds{5});
+  wheel.schedule(b, origin + milliseconds{6});
+
+  int rescheduled = 0;
+  std::vector<int> fired;
+  wheel.advance(origin + milliseconds{10}, [&](timer& t) {
+    fired.push_back(t.id);
+    if (t.id == 1) {
+      b.cancel();
+      wheel.schedule(t, origin + milliseconds{20});
+      ++rescheduled;
+    }
+  });
+  REQUIRE(fired == std::vector<int>{1});
+  REQUIRE(rescheduled == 1);
+  REQUIRE(a.is_scheduled());
+  REQUIRE(advance(wheel, origin + milliseconds{20}) == std::vector<int>{1});
+}
+
+TEST_CASE("schedule_after is relative to the current time of the wheel") {
+  wheel_type wheel{milliseconds{1}, origin};
+  advance(wheel, origin + milliseconds{100});
+  timer a{1};
+  wheel.schedule_after(a, milliseconds{10});
+  REQUIRE(advance(wheel, origin + milliseconds{109}).empty());
+  REQUIRE(advance(wheel, origin + milliseconds{110}) == std::vector<int>{1});
+}
+
+TEST_CASE("next_expiry is a lower bound on the next firing time") {
+  wheel_type wheel{milliseconds{1}, origin};
+  REQUIRE(!wheel.next_expiry());
+
+  timer a{1}, b{2};
+  wheel.schedule(a, origin + milliseconds{3000});
+  wheel.schedule(b, origin + milliseconds{40});
+  REQUIRE(static_cast<bool>(wheel.next_expiry()));
+  REQUIRE(*wheel.next_expiry() == origin + milliseconds{40});
+  REQUIRE(advance(wheel, origin + milliseconds{40}) == std::vector<int>{2});
+
+  auto next = wheel.next_expiry();
+  REQUIRE(static_cast<bool>(next));
+  REQUIRE(*next <= origin + milliseconds{3000});
+  REQUIRE(*next > origin + milliseconds{40});
+}
+
+TEST_CASE("timers beyond the horizon of the wheel go through the overflow list") {
+  wheel_type wheel{std::chrono::nanoseconds{1}, origin};
+  std::uint64_t const horizon = std::uint64_t{1} << 32;
+  timer a{1}, b{2};
+  wheel.schedule(a, origin + std::chrono::nanoseconds{3 * horizon + 17});
+  wheel.schedule(b, origin + std::chrono::nanoseconds{horizon - 1});
+
+  REQUIRE(advance(wheel, origin + std::chrono::nanoseconds{horizon - 2}).empty());
+  REQUIRE(advance(wheel, origin + std::chrono::nanoseconds{horizon}) == std::vector<int>{2});
+  REQUIRE(advance(wheel, origin + std::chrono::nanoseconds{3 * horizon + 16}).empty());
+  REQUIRE(advance(wheel, origin + std::chrono::nanoseconds{3 * horizon + 17}) == std::vector<int>{1});
+}
+
+TEST_CASE("random schedules match a reference implementation") {
+  wheel_type wheel{milliseconds{1}, origin};
+  std::mt19937 gen{42};
+  std::uniform_int_distribution<int> delay{0, 200000};
+  std::uniform_int_distribution<int> step{0, 5000};
+
+  std::vector<std::unique_ptr<timer>> timers;
+  std::vector<clock_type::time_point> deadlines;
+  for (int i = 0; i != 2000; ++i) {
+    timers.push_back(std::make_unique<timer>(i));
+    deadlines.push_back(origin + milliseconds{delay(gen)});
+    wheel.schedule(*timers.back(), deadlines.back());
+  }
+  for (int i = 0; i < 2000; i += 7)
+    timers[i]->cancel();
+
+  clock_type::time_point now = origin;
+  std::vector<bool> fired(timers.size(), false);
+  while (now < origin + milliseconds{210000}) {
+    now += milliseconds{step(gen)};
+    for (int id : advance(wheel, now)) {
+      REQUIRE(id % 7 != 0);
+      REQUIRE(!fired[id]);
+      REQUIRE(deadlines[id] <= now);
+      fired[id] = true;
+    }
+    for (std::size_t i = 0; i != timers.size(); ++i) {
+      if (i % 7 != 0 && deadlines[i] <= now)
+        REQUIRE(fired[i]);
+    }
+  }
+}
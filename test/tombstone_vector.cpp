@@ -0,0 +1,183 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/tombstone_vector.hpp>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+#include <iterator>
+#include <memory>
+#include <random>
+#include <vector>
+
+
+template <typename Vector>
+static std::vector<int> contents(Vector const& v) {
+  return std::vector<int>(v.begin(), v.end());
+}
+
+TEST_CASE("empty vector") {
+  amz::tombstone_vector<int> v;
+  REQUIRE(v.empty());
+  REQUIRE(v.size() == 0);
+  REQUIRE(v.begin() == v.end());
+}
+
+TEST_CASE("push_back and iterate") {
+  amz::tombstone_vector<int> v;
+  for (int i = 0; i != 100; ++i)
+    v.push_back(i);
+
+  REQUIRE(v.size() == 100);
+  std::vector<int> expected;
+  for (int i = 0; i != 100; ++i)
+    expected.push_back(i);
+  REQUIRE(contents(v) == expected);
+}
+
+TEST_CASE("erased elements are skipped during iteration") {
+  amz::tombstone_vector<int> v{1.0}; // never compact automatically
+  for (int i = 0; i != 200; ++i)
+    v.push_back(i);
+
+  // Erase everything that is not a multiple of 3, including whole words of
+  // the bitmap at the same time.
+  std::vector<int> expected;
+  for (auto it = v.begin(); it != v.end(); ) {
+    if (*it % 3 != 0 || (*it >= 64 && *it < 192)) {
+      it = v.erase(it);
+    } else {
+      expected.push_back(*it);
+      ++it;
+    }
+  }
+
+  REQUIRE(v.tombstones() == 200 - expected.size());
+  REQUIRE(v.size() == expected.size());
+  REQUIRE(contents(v) == expected);
+}
+
+TEST_CASE("erase returns an iterator to the next element") {
+  amz::tombstone_vector<int> v{1.0};
+  for (int i = 0; i != 5; ++i)
+    v.push_back(i);
+
+  auto it = v.erase(std::next(v.begin()));
+  REQUIRE(*it == 2);
+  it = v.erase(it);
+  REQUIRE(*it == 3);
+  it = v.erase(std::next(it));
+  REQUIRE(it == v.end());
+  REQUIRE(contents(v) == (std::vector<int>{0, 3}));
+}
+
+TEST_CASE("compaction is triggered past the tombstone ratio") {
+  amz::tombstone_vector<int> v{0.5};
+  for (int i = 0; i != 10; ++i)
+    v.push_back(i);
+
+  auto it = v.begin();
+  for (int i = 0; i != 5; ++i)
+    it = v.erase(it);
+  REQUIRE(v.tombstones() == 5); // 5 / 10 is not above the ratio
+  REQUIRE(*it == 5);
+
+  it = v.erase(it); // 6 / 10 is, so this compacts
+  REQUIRE(v.tombstones() == 0);
+  REQUIRE(*it == 6);
+  REQUIRE(it == v.begin());
+  REQUIRE(contents(v) == (std::vector<int>{6, 7, 8, 9}));
+}
+
+TEST_CASE("iterator returned by a compacting erase points to the right element") {
+  amz::tombstone_vector<int> v{0.25};
+  for (int i = 0; i != 8; ++i)
+    v.push_back(i);
+
+  v.erase(v.begin());                  // {_, 1, 2, 3, 4, 5, 6, 7}
+  v.erase(std::next(v.begin(), 2));    // {_, 1, 2, _, 4, 5, 6, 7}
+  auto it = v.erase(std::next(v.begin(), 3)); // erase 5, compacts
+  REQUIRE(v.tombstones() == 0);
+  REQUIRE(*it == 6);
+  REQUIRE(contents(v) == (std::vector<int>{1, 2, 4, 6, 7}));
+}
+
+TEST_CASE("compact() can move the removed elements out") {
+  amz::tombstone_vector<std::unique_ptr<int>> v{1.0};
+  for (int i = 0; i != 130; ++i)
+    v.push_back(std::make_unique<int>(i));
+
+  for (auto it = v.begin(); it != v.end(); ) {
+    if (**it % 2 == 1 || **it > 100)
+      it = v.erase(it);
+    else
+      ++it;
+  }
+
+  std::vector<std::unique_ptr<int>> removed;
+  v.compact(std::back_inserter(removed));
+  REQUIRE(v.tombstones() == 0);
+
+  std::vector<int> kept_values, removed_values;
+  for (auto const& p : v) kept_values.push_back(*p);
+  for (auto const& p : removed) removed_values.push_back(*p);
+
+  std::vector<int> expected_kept, expected_removed;
+  for (int i = 0; i != 130; ++i)
+    (i % 2 == 1 || i > 100 ? expected_removed : expected_kept).push_back(i);
+  REQUIRE(kept_values == expected_kept);
+  REQUIRE(removed_values == expected_removed);
+}
+
+TEST_CASE("push_back after erasures and compactions") {
+  amz::tombstone_vector<int> v{1.0};
+  for (int i = 0; i != 70; ++i)
+    v.push_back(i);
+  for (auto it = v.begin(); it != v.end(); )
+    it = (*it < 65 ? v.erase(it) : std::next(it));
+
+  v.push_back(70);
+  REQUIRE(contents(v) == (std::vector<int>{65, 66, 67, 68, 69, 70}));
+  v.compact();
+  v.push_back(71);
+  REQUIRE(contents(v) == (std::vector<int>{65, 66, 67, 68, 69, 70, 71}));
+}
+
+TEST_CASE("randomized erasures match std::vector") {
+  std::mt19937 gen{12345};
+  amz::tombstone_vector<int> v{0.3};
+  std::vector<int> reference;
+  for (int i = 0; i != 5000; ++i) {
+    v.push_back(i);
+    reference.push_back(i);
+    if (gen() % 3 == 0 && !reference.empty()) {
+      std::size_t const k = gen() % reference.size();
+      v.erase(std::next(v.begin(), k));
+      reference.erase(reference.begin() + k);
+    }
+  }
+  REQUIRE(v.size() == reference.size());
+  REQUIRE(contents(v) == reference);
+}
+
+TEST_CASE("clear") {
+  amz::tombstone_vector<int> v;
+  for (int i = 0; i != 10; ++i)
+    v.push_back(i);
+  v.erase(v.begin());
+  v.clear();
+  REQUIRE(v.empty());
+  REQUIRE(v.tombstones() == 0);
+  REQUIRE(v.begin() == v.end());
+}
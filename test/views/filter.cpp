@@ -0,0 +1,115 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/views.hpp>
+
+#include <array>
+#include <iterator>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+
+// An iterator that counts the number of dereferences and increments are done
+// on it. Useful in the tests below.
+template <typename Iterator>
+struct counting_iterator : std::iterator_traits<Iterator> {
+  counting_iterator(Iterator it, int& increments, int& dereferences)
+    : iterator(it), increments(&increments), dereferences(&dereferences)
+  { }
+
+  Iterator iterator;
+  int* increments;
+  int* dereferences;
+
+  counting_iterator& operator++() {
+    ++*increments;
+    ++iterator;
+    return *this;
+  }
+
+  counting_iterator operator++(int) {
+    counting_iterator copy = *this;
+    ++(*this);
+    return copy;
+  }
+
+  typename std::iterator_traits<Iterator>::reference operator*() const {
+    ++*dereferences;
+    return *iterator;
+  }
+
+  friend bool operator==(counting_iterator const& a, counting_iterator const& b)
+  { return a.iterator == b.iterator; }
+  friend bool operator!=(counting_iterator const& a, counting_iterator const& b)
+  { return !(a == b); }
+};
+
+static bool is_even(int i) { return i % 2 == 0; }
+
+template <typename Range>
+auto to_vector(Range const& r) {
+  return std::vector<typename Range::iterator::value_type>(r.begin(), r.end());
+}
+
+TEST_CASE("filter over an empty range") {
+  std::vector<int> data;
+  auto view = amz::views::filter(data, is_even);
+  REQUIRE(view.begin() == view.end());
+}
+
+TEST_CASE("filter keeps the elements satisfying the predicate") {
+  std::list<int> data = {1, 2, 3, 4, 5, 6, 7, 8};
+  REQUIRE(to_vector(amz::views::filter(data, is_even)) == (std::vector<int>{2, 4, 6, 8}));
+  REQUIRE(to_vector(amz::views::filter(data, [](int) { return false; })).empty());
+}
+
+TEST_CASE("filter dereferences and tests each element exactly once") {
+  std::array<int, 8> data = {{1, 2, 3, 4, 5, 6, 7, 8}};
+  int increments = 0, dereferences = 0, predicates = 0;
+  counting_iterator<int*> first(data.begin(), increments, dereferences);
+  counting_iterator<int*> last(data.end(), increments, dereferences);
+
+  int sum = 0;
+  auto view = amz::views::filter(first, last, [&](int i) { ++predicates; return is_even(i); });
+  for (auto it = view.begin(); it != view.end(); ++it)
+    sum += *it + *it; // dereference the view iterator more than once
+  REQUIRE(sum == 40);
+  REQUIRE(increments == 8);
+  REQUIRE(dereferences == 8);
+  REQUIRE(predicates == 8);
+}
+
+TEST_CASE("filters and take_while can be chained in a single pass") {
+  std::istringstream stream{"1 2 3 4 5 6 100 8 10"};
+  std::istream_iterator<int> first{stream}, last{};
+  auto small = amz::views::take_while(first, last, [](int i) { return i < 50; });
+  auto even_small = amz::views::filter(small, is_even);
+  auto chained = amz::views::filter(even_small, [](int i) { return i != 4; });
+  REQUIRE(to_vector(chained) == (std::vector<int>{2, 6}));
+}
+
+TEST_CASE("filter over rvalue references") {
+  std::vector<std::string> data = {"a", "bb", "c", "dd"};
+  auto view = amz::views::filter(std::make_move_iterator(data.begin()),
+                                 std::make_move_iterator(data.end()),
+                                 [](std::string const& s) { return s.size() == 2; });
+  std::vector<std::string> actual;
+  for (std::string& s : view)
+    actual.push_back(std::move(s));
+  REQUIRE(actual == (std::vector<std::string>{"bb", "dd"}));
+}
@@ -0,0 +1,126 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/views.hpp>
+
+#include <amz/algorithm/remove_range_if.hpp>
+
+#include <array>
+#include <iterator>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+
+// An iterator that counts the number of dereferences and increments are done
+// on it. Useful in the tests below.
+template <typename Iterator>
+struct counting_iterator : std::iterator_traits<Iterator> {
+  counting_iterator(Iterator it, int& increments, int& dereferences)
+    : iterator(it), increments(&increments), dereferences(&dereferences)
+  { }
+
+  Iterator iterator;
+  int* increments;
+  int* dereferences;
+
+  counting_iterator& operator++() {
+    ++*increments;
+    ++iterator;
+    return *this;
+  }
+
+  counting_iterator operator++(int) {
+    counting_iterator copy = *this;
+    ++(*this);
+    return copy;
+  }
+
+  typename std::iterator_traits<Iterator>::reference operator*() const {
+    ++*dereferences;
+    return *iterator;
+  }
+
+  friend bool operator==(counting_iterator const& a, counting_iterator const& b)
+  { return a.iterator == b.iterator; }
+  friend bool operator!=(counting_iterator const& a, counting_iterator const& b)
+  { return !(a == b); }
+};
+
+template <typename View>
+std::vector<std::vector<int>> groups(View const& view) {
+  std::vector<std::vector<int>> result;
+  for (auto const& group : view)
+    result.emplace_back(group.begin(), group.end());
+  return result;
+}
+
+static bool same_tens(int a, int b) { return a / 10 == b / 10; }
+
+TEST_CASE("group_by over an empty range") {
+  std::vector<int> data;
+  REQUIRE(groups(amz::views::group_by(data, same_tens)).empty());
+}
+
+TEST_CASE("group_by splits the range into sub-ranges of equivalent elements") {
+  std::vector<int> data = {1, 2, 3, 11, 12, 21, 3, 4};
+  std::vector<std::vector<int>> const expected = {{1, 2, 3}, {11, 12}, {21}, {3, 4}};
+  REQUIRE(groups(amz::views::group_by(data, same_tens)) == expected);
+}
+
+TEST_CASE("group_by considers the same sub-ranges as remove_range_if") {
+  std::vector<int> data = {1, 2, 3, 11, 12, 21, 3, 4};
+  auto is_small_group = [](auto first, auto last) { return std::distance(first, last) < 2; };
+
+  std::vector<int> expected = data;
+  expected.erase(amz::remove_range_if(expected.begin(), expected.end(), same_tens, is_small_group),
+                 expected.end());
+
+  std::vector<int> actual;
+  for (auto const& group : amz::views::group_by(data, same_tens)) {
+    if (!is_small_group(group.begin(), group.end()))
+      actual.insert(actual.end(), group.begin(), group.end());
+  }
+  REQUIRE(actual == expected);
+}
+
+TEST_CASE("group_by compares with the first element of the group") {
+  std::vector<int> data = {1, 2, 3, 4, 5};
+  auto close = [](int a, int b) { return b - a <= 1; };
+  std::vector<std::vector<int>> const expected = {{1, 2}, {3, 4}, {5}};
+  REQUIRE(groups(amz::views::group_by(data, close)) == expected);
+}
+
+TEST_CASE("chunk_by compares adjacent elements") {
+  std::vector<int> data = {1, 2, 3, 5, 6, 8};
+  auto consecutive = [](int a, int b) { return b - a == 1; };
+  std::vector<std::vector<int>> const expected = {{1, 2, 3}, {5, 6}, {8}};
+  REQUIRE(groups(amz::views::chunk_by(data, consecutive)) == expected);
+}
+
+TEST_CASE("group_by dereferences each element once") {
+  std::array<int, 8> data = {{1, 2, 3, 11, 12, 21, 3, 4}};
+  int increments = 0, dereferences = 0;
+  counting_iterator<int*> first(data.begin(), increments, dereferences);
+  counting_iterator<int*> last(data.end(), increments, dereferences);
+
+  auto view = amz::views::group_by(first, last, same_tens);
+  REQUIRE(std::distance(view.begin(), view.end()) == 4);
+  REQUIRE(dereferences == 8);
+
+  dereferences = 0;
+  auto chunks = amz::views::chunk_by(first, last, same_tens);
+  REQUIRE(std::distance(chunks.begin(), chunks.end()) == 4);
+  REQUIRE(dereferences == 8);
+}
@@ -0,0 +1,147 @@
+// Copyright 2018 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License").
+// You may not use this file except in compliance with the License.
+// A copy of the License is located at
+//
+//    http://www.apache.org/licenses/LICENSE-2.0
+//
+// or in the "license" file accompanying this file. This file is distributed
+// on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+// express or implied. See the License for the specific language governing
+// permissions and limitations under the License.
+
+#include <amz/views.hpp>
+
+#include <amz/algorithm/copy_while.hpp>
+
+#include <array>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define CATCH_CONFIG_MAIN
+#include <catch.hpp>
+
+
+// An iterator that counts the number of dereferences and increments are done
+// on it. Useful in the tests below.
+template <typename Iterator>
+struct counting_iterator : std::iterator_traits<Iterator> {
+  counting_iterator(Iterator it, int& increments, int& dereferences)
+    : iterator(it), increments(&increments), dereferences(&dereferences)
+  { }
+
+  Iterator iterator;
+  int* increments;
+  int* dereferences;
+
+  counting_iterator& operator++() {
+    ++*increments;
+    ++iterator;
+    return *this;
+  }
+
+  counting_iterator operator++(int) {
+    counting_iterator copy = *this;
+    ++(*this);
+    return copy;
+  }
+
+  typename std::iterator_traits<Iterator>::reference operator*() const {
+    ++*dereferences;
+    return *iterator;
+  }
+
+  friend bool operator==(counting_iterator const& a, counting_iterator const& b)
+  { return a.iterator == b.iterator; }
+  friend bool operator!=(counting_iterator const& a, counting_iterator const& b)
+  { return !(a == b); }
+};
+
+template <typename T>
+auto less_than(T const& t) {
+  return [=](T const& x) { return x < t; };
+}
+
+template <typename Range>
+auto to_vector(Range const& r) {
+  return std::vector<typename Range::iterator::value_type>(r.begin(), r.end());
+}
+
+TEST_CASE("take_while over an empty range") {
+  std::vector<int> data;
+  auto view = amz::views::take_while(data, [](int) { return true; });
+  REQUIRE(view.begin() == view.end());
+}
+
+TEST_CASE("take_while matches copy_while") {
+  std::array<int, 6> data = {{0, 1, 2, 3, 4, 5}};
+  for (int n = 0; n != 8; ++n) {
+    std::vector<int> expected;
+    amz::copy_while(data.begin(), data.end(), std::back_inserter(expected), less_than(n));
+    REQUIRE(to_vector(amz::views::take_while(data.begin(), data.end(), less_than(n))) == expected);
+  }
+}
+
+TEST_CASE("take_while gives access to where it stopped") {
+  std::array<int, 6> data = {{0, 1, 2, 3, 4, 5}};
+  auto view = amz::views::take_while(data, less_than(3));
+  auto it = view.begin();
+  while (it != view.end())
+    ++it;
+  REQUIRE(it.base() == data.begin() + 3);
+}
+
+TEST_CASE("take_while allows modifying the underlying range") {
+  std::vector<int> data = {0, 1, 2, 3, 4, 5};
+  for (int& i : amz::views::take_while(data, less_than(3)))
+    i *= 10;
+  REQUIRE(data == (std::vector<int>{0, 10, 20, 3, 4, 5}));
+}
+
+TEST_CASE("take_while dereferences at most n+1 times") {
+  std::array<int, 6> data = {{0, 1, 2, 3, 4, 5}};
+  int increments = 0, dereferences = 0;
+  counting_iterator<int*> first(data.begin(), increments, dereferences);
+  counting_iterator<int*> last(data.end(), increments, dereferences);
+
+  int sum = 0;
+  for (int i : amz::views::take_while(first, last, less_than(3)))
+    sum += i + i; // use the element more than once
+  REQUIRE(sum == 6);
+  REQUIRE(increments == 3);
+  REQUIRE(dereferences == 4);
+}
+
+TEST_CASE("take_while dereferences n times when the whole range satisfies the predicate") {
+  std::array<int, 6> data = {{0, 1, 2, 3, 4, 5}};
+  int increments = 0, dereferences = 0;
+  counting_iterator<int*> first(data.begin(), increments, dereferences);
+  counting_iterator<int*> last(data.end(), increments, dereferences);
+
+  std::vector<int> actual;
+  for (int i : amz::views::take_while(first, last, less_than(100)))
+    actual.push_back(i);
+  REQUIRE(actual.size() == 6);
+  REQUIRE(increments == 6);
+  REQUIRE(dereferences == 6);
+}
+
+TEST_CASE("take_while over an InputIterator") {
+  std::istringstream stream{"1 2 3 40 5 6"};
+  std::istream_iterator<int> first{stream}, last{};
+  std::vector<int> actual;
+  for (int i : amz::views::take_while(first, last, less_than(10)))
+    actual.push_back(i);
+  REQUIRE(actual == (std::vector<int>{1, 2, 3}));
+}
+
+TEST_CASE("take_while iterators are copy assignable with lambdas") {
+  std::vector<int> data = {0, 1, 2};
+  auto view = amz::views::take_while(data, less_than(2));
+  auto it = view.begin();
+  it = view.end();
+  REQUIRE(it == view.end());
+}